@@ -0,0 +1,305 @@
+/**
+ * @file archive.c
+ * @brief Long-term sample archive: an append-only file of compressed blocks.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "archive.h"
+#include "time_util.h"
+
+static int archive_fd = -1;                   // Archive file, -1 when disabled
+static struct tsblock_encoder encoder;        // Block being filled (sensor thread only)
+static int64_t block_offset_ms;               // Unix time minus CLOCK_MONOTONIC for the open block
+
+static pthread_mutex_t index_lock = PTHREAD_MUTEX_INITIALIZER; // Guards the fields below
+static struct archive_block *blocks;          // Index of the sealed blocks, oldest first
+static size_t block_count, block_cap;
+static int64_t file_size;                     // End of the last sealed block
+static int time_ordered = 1;                  // No block starts before the previous one ended
+
+/**
+ * @brief Adds a sealed block to the index.
+ *
+ * @return 0 on success, -1 on allocation failure.
+ */
+static int index_add(const struct tsblock_header *hdr, int64_t offset) {
+    int ret = 0;
+
+    pthread_mutex_lock(&index_lock);
+    if (block_count == block_cap) {
+        size_t cap = block_cap ? 2 * block_cap : 64;
+        struct archive_block *grown = realloc(blocks, cap * sizeof(*blocks));
+        if (grown == NULL) {
+            ret = -1;
+            goto out;
+        }
+        blocks = grown;
+        block_cap = cap;
+    }
+    if (block_count > 0 && hdr->first_ms < blocks[block_count - 1].last_ms)
+        time_ordered = 0; // Written before archive_append() kept block times in order
+    blocks[block_count++] = (struct archive_block){
+        .offset = offset, .first_seq = hdr->first_seq, .count = hdr->count,
+        .bytes = hdr->bytes, .first_ms = hdr->first_ms, .last_ms = hdr->last_ms,
+    };
+    file_size = offset + (int64_t)(sizeof(*hdr) + hdr->bytes);
+out:
+    pthread_mutex_unlock(&index_lock);
+    return ret;
+}
+
+/**
+ * @brief Opens the archive, rebuilding the index from the file.
+ *
+ * Blocks are verified in order; the first one that is truncated or fails its
+ * checksum ends the archive and is cut off, so appends resume after the last
+ * intact block.
+ *
+ * @param path Archive file path.
+ * @return 0 on success, -1 on error (errno set).
+ */
+int archive_open(const char *path) {
+    static uint8_t data[TSBLOCK_BYTES_MAX];
+    struct tsblock_header hdr;
+    int64_t offset = 0;
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+        return -1;
+
+    while (pread(fd, &hdr, sizeof(hdr), offset) == (ssize_t)sizeof(hdr) &&
+           hdr.bytes <= TSBLOCK_BYTES_MAX &&
+           pread(fd, data, hdr.bytes, offset + (int64_t)sizeof(hdr)) == (ssize_t)hdr.bytes &&
+           tsblock_verify(&hdr, data) == 0) {
+        if (index_add(&hdr, offset) < 0) {
+            close(fd);
+            errno = ENOMEM;
+            return -1;
+        }
+        offset += (int64_t)(sizeof(hdr) + hdr.bytes);
+    }
+    if (ftruncate(fd, offset) < 0 || lseek(fd, offset, SEEK_SET) < 0) { // Drop a torn tail
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    file_size = offset;
+    tsblock_encoder_reset(&encoder);
+    archive_fd = fd;
+    return 0;
+}
+
+/**
+ * @brief Returns the sequence number of the last archived sample, 0 if none.
+ */
+uint64_t archive_last_seq(void) {
+    uint64_t seq = 0;
+
+    pthread_mutex_lock(&index_lock);
+    if (block_count > 0)
+        seq = blocks[block_count - 1].first_seq + blocks[block_count - 1].count - 1;
+    pthread_mutex_unlock(&index_lock);
+    return seq;
+}
+
+/**
+ * @brief Returns the Unix time of the last archived sample, INT64_MIN if none.
+ */
+static int64_t archive_last_ms(void) {
+    int64_t ms = INT64_MIN;
+
+    pthread_mutex_lock(&index_lock);
+    if (block_count > 0)
+        ms = blocks[block_count - 1].last_ms;
+    pthread_mutex_unlock(&index_lock);
+    return ms;
+}
+
+/**
+ * @brief Seals the open block and appends it to the file.
+ */
+static void archive_flush(void) {
+    static uint8_t out[sizeof(struct tsblock_header) + TSBLOCK_BYTES_MAX];
+    size_t len;
+
+    tsblock_seal(&encoder);
+    len = sizeof(encoder.hdr) + encoder.hdr.bytes;
+
+    // Header and payload in one write so a crash leaves at most one torn block
+    memcpy(out, &encoder.hdr, sizeof(encoder.hdr));
+    memcpy(out + sizeof(encoder.hdr), encoder.data, encoder.hdr.bytes);
+
+    if (pwrite(archive_fd, out, len, file_size) == (ssize_t)len)
+        index_add(&encoder.hdr, file_size);
+    else
+        perror("Archive write error"); // The block is dropped; the next one overwrites any partial write
+
+    tsblock_encoder_reset(&encoder);
+}
+
+/**
+ * @brief Adds a published sample to the open block.
+ *
+ * Runs on the sensor thread. Sealing a block costs one write() of at most a
+ * few kilobytes every TSBLOCK_SAMPLES samples.
+ *
+ * @param seq Sequence number.
+ * @param when Sample time (CLOCK_MONOTONIC); converted to Unix time with the
+ *             clock offset of the block's first sample, so clock steps do not
+ *             disturb the timestamps inside a block. A block never starts
+ *             before the previous one ended: while the wall clock is behind
+ *             the archive (a board without RTC restoring its last saved time)
+ *             samples are stamped from the last archived time on.
+ * @param temp Temperature code.
+ * @param hum Humidity code.
+ */
+void archive_append(uint64_t seq, const struct timespec *when, uint16_t temp, uint16_t hum) {
+    int64_t mono_ms = timespec_ms(when);
+
+    if (archive_fd < 0)
+        return;
+
+    if (encoder.hdr.count > 0 && seq != encoder.hdr.first_seq + encoder.hdr.count)
+        archive_flush(); // Samples of a block are consecutive
+    if (encoder.hdr.count == 0) {
+        int64_t last_ms = archive_last_ms();
+        block_offset_ms = clock_offset_ms();
+        if (mono_ms + block_offset_ms < last_ms) // Wall clock behind the archive (fake-hwclock after a reboot)
+            block_offset_ms = last_ms - mono_ms; // Blocks must stay in time order: hold at the last time
+    }
+
+    if (tsblock_encode(&encoder, seq, mono_ms + block_offset_ms, temp, hum) == 0) {
+        archive_flush(); // Timestamp out of range for this block: start a new one
+        archive_append(seq, when, temp, hum);
+        return;
+    }
+    if (encoder.hdr.count == TSBLOCK_SAMPLES)
+        archive_flush();
+}
+
+/**
+ * @brief Finds the first sealed block holding samples at or after `seq`.
+ *
+ * @param seq Sequence number.
+ * @return Block index (the block count if every block is older).
+ */
+size_t archive_find_seq(uint64_t seq) {
+    size_t lo = 0, hi;
+
+    pthread_mutex_lock(&index_lock);
+    hi = block_count;
+    while (lo < hi) { // First block whose last sample is >= seq
+        size_t mid = lo + (hi - lo) / 2;
+        if (blocks[mid].first_seq + blocks[mid].count <= seq)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    pthread_mutex_unlock(&index_lock);
+    return lo;
+}
+
+/**
+ * @brief Finds the first sealed block holding samples at or after a point in time.
+ *
+ * Binary search, or a linear scan of the index if an older file has blocks
+ * out of time order (see archive_time_ordered()).
+ *
+ * @param ms Unix time, ms.
+ * @return Block index (the block count if every block is older).
+ */
+size_t archive_find_time(int64_t ms) {
+    size_t lo = 0, hi;
+
+    pthread_mutex_lock(&index_lock);
+    hi = block_count;
+    if (!time_ordered) {
+        while (lo < hi && blocks[lo].last_ms < ms)
+            lo++;
+        hi = lo;
+    }
+    while (lo < hi) { // First block whose last sample is >= ms
+        size_t mid = lo + (hi - lo) / 2;
+        if (blocks[mid].last_ms < ms)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    pthread_mutex_unlock(&index_lock);
+    return lo;
+}
+
+/**
+ * @brief Tells whether block times never decrease.
+ *
+ * True for every file written since archive_append() holds block times in
+ * order; a file written before that may have blocks that go back in time
+ * after a reboot without RTC, and then only lookups by sequence number can
+ * be trusted to be ordered.
+ *
+ * @return 1 if ordered, 0 otherwise.
+ */
+int archive_time_ordered(void) {
+    int ordered;
+
+    pthread_mutex_lock(&index_lock);
+    ordered = time_ordered;
+    pthread_mutex_unlock(&index_lock);
+    return ordered;
+}
+
+/**
+ * @brief Copies an index entry.
+ *
+ * @return 0 on success, -1 past the last sealed block.
+ */
+int archive_block(size_t i, struct archive_block *blk) {
+    int ret = -1;
+
+    pthread_mutex_lock(&index_lock);
+    if (i < block_count) {
+        *blk = blocks[i];
+        ret = 0;
+    }
+    pthread_mutex_unlock(&index_lock);
+    return ret;
+}
+
+/**
+ * @brief Reads and verifies a sealed block.
+ *
+ * @param blk Index entry.
+ * @param hdr Receives the header.
+ * @param data Receives the payload (TSBLOCK_BYTES_MAX bytes).
+ * @return 0 on success, -1 on error.
+ */
+int archive_read(const struct archive_block *blk, struct tsblock_header *hdr, uint8_t *data) {
+    if (pread(archive_fd, hdr, sizeof(*hdr), blk->offset) != (ssize_t)sizeof(*hdr) ||
+        hdr->bytes != blk->bytes ||
+        pread(archive_fd, data, hdr->bytes, blk->offset + (int64_t)sizeof(*hdr)) != (ssize_t)hdr->bytes)
+        return -1;
+    return tsblock_verify(hdr, data);
+}
+
+/**
+ * @brief Snapshots the archive counters.
+ */
+void archive_get_stats(struct archive_stats *stats) {
+    pthread_mutex_lock(&index_lock);
+    stats->blocks = block_count;
+    stats->samples = 0;
+    if (block_count > 0)
+        stats->samples = (unsigned long)(blocks[block_count - 1].first_seq + blocks[block_count - 1].count -
+                                         blocks[0].first_seq); // Upper bound if runs had gaps
+    stats->bytes = (unsigned long)file_size;
+    pthread_mutex_unlock(&index_lock);
+}
@@ -0,0 +1,72 @@
+/**
+ * @file archive.h
+ * @brief Long-term sample archive: an append-only file of compressed blocks.
+ *
+ * The sensor thread feeds every published sample into an in-memory block
+ * encoder (tsblock.h); when the block is full it is sealed and appended to the
+ * file with a single write(). Sealed blocks never change. An index of the
+ * sealed blocks (offset, sequence and time range) is kept in memory, so a
+ * reader finds the block holding a sample or a point in time by binary search
+ * and then streams it from the file one sample at a time. Block times never
+ * decrease, even when the wall clock steps back.
+ *
+ * On startup the file is scanned and verified block by block; a block torn by
+ * a crash or power loss ends the archive and is truncated away. Samples of the
+ * unsealed block are lost on a crash (at most TSBLOCK_SAMPLES; with a history
+ * file they are still in the recovered ring).
+ */
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "tsblock.h"
+
+// Index entry of a sealed block
+struct archive_block {
+    int64_t offset;     // File offset of the block header
+    uint64_t first_seq; // Sequence number of the first sample
+    uint32_t count;     // Samples in the block
+    uint32_t bytes;     // Payload length
+    int64_t first_ms;   // Unix time of the first sample, ms
+    int64_t last_ms;    // Unix time of the last sample, ms
+};
+
+// Archive counters
+struct archive_stats {
+    unsigned long blocks;  // Sealed blocks
+    unsigned long samples; // Samples in sealed blocks
+    unsigned long bytes;   // File size
+};
+
+// Opens (verifies, repairs or creates) the archive; returns 0 on success, -1 on error
+int archive_open(const char *path);
+
+// Returns the sequence number of the last archived sample, 0 if none
+uint64_t archive_last_seq(void);
+
+// Adds a published sample (sensor thread only); `when` is its CLOCK_MONOTONIC time
+void archive_append(uint64_t seq, const struct timespec *when, uint16_t temp, uint16_t hum);
+
+// Returns the index of the first sealed block holding samples at or after `seq`
+size_t archive_find_seq(uint64_t seq);
+
+// Returns the index of the first sealed block holding samples at or after Unix time `ms`
+size_t archive_find_time(int64_t ms);
+
+// Returns 1 if block times never decrease (always for files written by this version), 0 otherwise
+int archive_time_ordered(void);
+
+// Copies index entry `i`; returns 0, or -1 past the last sealed block
+int archive_block(size_t i, struct archive_block *blk);
+
+// Reads and verifies a sealed block; returns 0 on success, -1 on error
+int archive_read(const struct archive_block *blk, struct tsblock_header *hdr, uint8_t *data);
+
+// Snapshots the archive counters
+void archive_get_stats(struct archive_stats *stats);
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * @file arena.c
+ * @brief Reference-counted bump allocator for HTTP response bodies.
+ */
+
+#include <stdlib.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+/**
+ * @brief Creates an arena.
+ *
+ * @param cap Usable bytes; allocations are rounded up to ARENA_ALIGN.
+ * @return Arena holding one reference, or NULL on allocation failure.
+ */
+struct arena *arena_create(size_t cap) {
+    struct arena *a = malloc(sizeof(*a) + cap);
+
+    if (a == NULL)
+        return NULL;
+    atomic_init(&a->refs, 1);
+    a->cap = cap;
+    a->used = 0;
+    return a;
+}
+
+/**
+ * @brief Bump-allocates from the arena.
+ *
+ * @param a Arena.
+ * @param size Bytes requested.
+ * @return Aligned memory valid until the arena is freed, or NULL when full.
+ */
+void *arena_alloc(struct arena *a, size_t size) {
+    size_t start = (a->used + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    if (start > a->cap || size > a->cap - start)
+        return NULL;
+    a->used = start + size;
+    return a->mem + start;
+}
+
+/**
+ * @brief Takes an additional reference.
+ */
+void arena_retain(struct arena *a) {
+    atomic_fetch_add_explicit(&a->refs, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Drops a reference, freeing the arena with the last one.
+ *
+ * @param a Arena (void * so it can be passed as an MHD free callback).
+ */
+void arena_release(void *a) {
+    struct arena *ar = a;
+
+    if (atomic_fetch_sub_explicit(&ar->refs, 1, memory_order_acq_rel) == 1)
+        free(ar);
+}
@@ -0,0 +1,40 @@
+/**
+ * @file arena.h
+ * @brief Reference-counted bump allocator for HTTP response bodies.
+ *
+ * A response is built entirely inside one arena sized for it up front: scratch
+ * copies of the data and the serialized body are bump allocations, so there is
+ * a single malloc() per body however many values it holds. The arena is handed
+ * to MHD together with the body and released by the response's free callback
+ * once the body has been transmitted.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Worst-case arena space taken by an allocation of n bytes (alignment padding included)
+#define ARENA_SIZE(n) ((n) + _Alignof(max_align_t))
+
+struct arena {
+    atomic_int refs; // Owners: the builder, caches, responses in flight
+    size_t cap;      // Usable bytes in mem[]
+    size_t used;     // Bytes handed out so far
+    _Alignas(max_align_t) char mem[];
+};
+
+// Creates an arena with `cap` usable bytes and one reference
+struct arena *arena_create(size_t cap);
+
+// Returns `size` bytes aligned for any type, or NULL when the arena is full
+void *arena_alloc(struct arena *a, size_t size);
+
+// Takes an additional reference
+void arena_retain(struct arena *a);
+
+// Drops a reference, freeing the arena with the last one (usable as an MHD free callback)
+void arena_release(void *a);
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * @file gzip.c
+ * @brief gzip Content-Encoding of response bodies (zlib).
+ */
+
+#include <string.h>
+#include <strings.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <zlib.h>
+
+#include "gzip.h"
+#include "time_util.h"
+
+#define GZIP_WINDOW_BITS (15 + 16) // 32 KiB window, gzip wrapper instead of zlib's
+
+static atomic_ulong gzip_bodies;
+static _Atomic uint64_t gzip_bytes_in, gzip_bytes_out, gzip_ns;
+
+/**
+ * @brief Compresses a body into a gzip member in one deflate() call.
+ *
+ * @param out Output buffer.
+ * @param cap Size of the output buffer, at least GZIP_BOUND(len).
+ * @param in Body.
+ * @param len Body length.
+ * @param level zlib compression level (1-9).
+ * @return Length of the gzip data, 0 on error.
+ */
+size_t gzip_compress(void *out, size_t cap, const void *in, size_t len, int level) {
+    z_stream zs;
+    struct timespec begin, end;
+    size_t n = 0;
+
+    memset(&zs, 0, sizeof(zs)); // Default allocators
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+    if (deflateInit2(&zs, level, Z_DEFLATED, GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return 0;
+    zs.next_in = (Bytef *)in;
+    zs.avail_in = (uInt)len;
+    zs.next_out = out;
+    zs.avail_out = (uInt)cap;
+    if (deflate(&zs, Z_FINISH) == Z_STREAM_END)
+        n = zs.total_out;
+    deflateEnd(&zs);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+
+    if (n > 0) {
+        atomic_fetch_add_explicit(&gzip_bodies, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&gzip_bytes_in, len, memory_order_relaxed);
+        atomic_fetch_add_explicit(&gzip_bytes_out, n, memory_order_relaxed);
+        atomic_fetch_add_explicit(&gzip_ns, (uint64_t)timespec_diff_ns(&end, &begin), memory_order_relaxed);
+    }
+    return n;
+}
+
+/**
+ * @brief Returns non-zero if a q-value is zero ("0", "0.", "0.000").
+ */
+static int qvalue_zero(const char *q) {
+    if (*q++ != '0')
+        return 0;
+    if (*q == '.')
+        for (q++; *q == '0'; q++)
+            ;
+    return *q < '0' || *q > '9';
+}
+
+/**
+ * @brief Returns non-zero if an Accept-Encoding value allows gzip.
+ *
+ * An explicit "gzip" entry decides; otherwise "*" does. Either is refused
+ * with q=0.
+ *
+ * @param accept_encoding Header value, NULL if absent.
+ */
+int gzip_accepted(const char *accept_encoding) {
+    const char *p = accept_encoding;
+    int gzip = -1, any = -1; // -1: not listed, 0: refused, 1: accepted
+
+    if (p == NULL)
+        return 0;
+    while (*p != '\0') {
+        const char *name;
+        size_t n;
+        int ok = 1;
+
+        while (*p == ' ' || *p == '\t' || *p == ',')
+            p++;
+        name = p;
+        while (*p != '\0' && *p != ',' && *p != ';' && *p != ' ' && *p != '\t')
+            p++;
+        n = (size_t)(p - name);
+        while (*p != '\0' && *p != ',') { // Parameters: only q matters
+            if (*p == ';') {
+                while (*++p == ' ' || *p == '\t')
+                    ;
+                if ((*p == 'q' || *p == 'Q') && p[1] == '=')
+                    ok = !qvalue_zero(p + 2);
+                continue;
+            }
+            p++;
+        }
+        if (n == 4 && strncasecmp(name, "gzip", 4) == 0)
+            gzip = ok;
+        else if (n == 1 && *name == '*')
+            any = ok;
+    }
+    return gzip >= 0 ? gzip : any > 0;
+}
+
+/**
+ * @brief Snapshots the compression totals.
+ */
+void gzip_get_stats(struct gzip_stats *stats) {
+    stats->bodies = atomic_load_explicit(&gzip_bodies, memory_order_relaxed);
+    stats->bytes_in = atomic_load_explicit(&gzip_bytes_in, memory_order_relaxed);
+    stats->bytes_out = atomic_load_explicit(&gzip_bytes_out, memory_order_relaxed);
+    stats->ns = atomic_load_explicit(&gzip_ns, memory_order_relaxed);
+}
@@ -0,0 +1,40 @@
+/**
+ * @file gzip.h
+ * @brief gzip Content-Encoding of response bodies (zlib).
+ *
+ * Bodies are compressed once and then shared: the static dashboard at
+ * startup, cached dynamic bodies once per data version (response_cache.h).
+ * Every compression is counted so /status can report the ratio achieved and
+ * the CPU time it costs.
+ */
+
+#ifndef GZIP_H
+#define GZIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GZIP_LEVEL_STATIC 9  // Compressed once per run: smallest output
+#define GZIP_LEVEL_DYNAMIC 6 // Compressed once per sample: zlib's default trade-off
+
+// Upper bound of the gzip output for n input bytes (zlib's deflateBound plus the gzip wrapper)
+#define GZIP_BOUND(n) ((n) + ((n) >> 12) + ((n) >> 14) + ((n) >> 25) + 13 + 18)
+
+// Totals of every compression since startup
+struct gzip_stats {
+    unsigned long bodies;   // Bodies compressed
+    uint64_t bytes_in;      // Uncompressed bytes
+    uint64_t bytes_out;     // Compressed bytes
+    uint64_t ns;            // CPU time spent compressing (thread CPU clock)
+};
+
+// Compresses `len` bytes into `out` (GZIP_BOUND(len) bytes); returns the output length, 0 on error
+size_t gzip_compress(void *out, size_t cap, const void *in, size_t len, int level);
+
+// Returns non-zero if an Accept-Encoding header value allows gzip
+int gzip_accepted(const char *accept_encoding);
+
+// Snapshots the compression totals
+void gzip_get_stats(struct gzip_stats *stats);
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * @file history_bin.c
+ * @brief Binary columnar encoding of the history ring.
+ *
+ * Values are stored byte by byte in little-endian order, which compilers turn
+ * into plain stores on little-endian hosts (x86, ARM Linux).
+ */
+
+#include <string.h>
+
+#include "history_bin.h"
+#include "sample_codec.h"
+
+static uint8_t *put_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_le32(uint8_t *p, uint32_t v) {
+    p = put_le16(p, (uint16_t)v);
+    return put_le16(p, (uint16_t)(v >> 16));
+}
+
+static uint8_t *put_le64(uint8_t *p, uint64_t v) {
+    p = put_le32(p, (uint32_t)v);
+    return put_le32(p, (uint32_t)(v >> 32));
+}
+
+/**
+ * @brief Encodes ring samples as a binary columnar document.
+ *
+ * Codes are decoded through the sample_codec.h tables straight into the
+ * int16 columns; slots without SAMPLE_VALID become HISTORY_BIN_EMPTY and 0.
+ *
+ * @param out Output buffer of HISTORY_BIN_SIZE(n) bytes.
+ * @param seq Sequence number of the newest sample.
+ * @param temp Temperature codes, oldest first.
+ * @param hum Humidity codes, oldest first.
+ * @param time_ms Unix times in ms, oldest first.
+ * @param n Number of samples (at most 65535).
+ * @return Bytes written: HISTORY_BIN_SIZE(n).
+ */
+size_t history_bin_encode(uint8_t *out, uint64_t seq, const uint16_t *temp, const uint16_t *hum,
+                          const int64_t *time_ms, int n) {
+    uint8_t *p = out;
+    int64_t base_ms = 0;
+    int i;
+
+    for (i = 0; i < n && !(temp[i] & SAMPLE_VALID); i++) // Oldest sample held
+        ;
+    if (i < n)
+        base_ms = time_ms[i];
+
+    memcpy(p, HISTORY_BIN_MAGIC, 4);
+    p = put_le16(p + 4, HISTORY_BIN_VERSION);
+    p = put_le16(p, (uint16_t)n);
+    p = put_le64(p, seq);
+    p = put_le64(p, (uint64_t)base_ms);
+
+    for (i = 0; i < n; i++) // Times are increasing: offsets fit 32 bits for 49 days
+        p = put_le32(p, temp[i] & SAMPLE_VALID ? (uint32_t)(time_ms[i] - base_ms) : HISTORY_BIN_EMPTY);
+    for (i = 0; i < n; i++)
+        p = put_le16(p, (uint16_t)(temp[i] & SAMPLE_VALID ? temp_centi(temp[i]) : 0));
+    for (i = 0; i < n; i++)
+        p = put_le16(p, (uint16_t)(temp[i] & SAMPLE_VALID ? hum_centi(hum[i]) : 0));
+    return (size_t)(p - out);
+}
@@ -0,0 +1,39 @@
+/**
+ * @file history_bin.h
+ * @brief Binary columnar encoding of the history ring (/history?format=bin).
+ *
+ * Same content as the JSON document, without any text formatting: a fixed
+ * header followed by one packed column per field, all little-endian.
+ *
+ *   offset  size  field
+ *        0     4  magic "HTHB"
+ *        4     2  version (HISTORY_BIN_VERSION)
+ *        6     2  count: samples per column
+ *        8     8  seq: sequence number of the newest sample (for ?since=)
+ *       16     8  base_ms: Unix time (ms) of the oldest sample held
+ *       24  4*count  time: ms after base_ms, HISTORY_BIN_EMPTY for slots never written
+ *          2*count  temperature: int16 hundredths of °C (0 for empty slots)
+ *          2*count  humidity: int16 hundredths of %RH (0 for empty slots)
+ *
+ * Every column starts at a multiple of its element size, so a browser can map
+ * it with typed arrays without copying. A 600 sample ring is 4824 bytes,
+ * against about 15 kB of JSON.
+ */
+
+#ifndef HISTORY_BIN_H
+#define HISTORY_BIN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HISTORY_BIN_MAGIC "HTHB"
+#define HISTORY_BIN_VERSION 1
+#define HISTORY_BIN_HEADER 24          // Header bytes, before the time column
+#define HISTORY_BIN_EMPTY 0xFFFFFFFFu  // Time of a slot that never held a sample
+#define HISTORY_BIN_SIZE(n) (HISTORY_BIN_HEADER + (size_t)(n) * (4 + 2 + 2)) // Encoded size of n samples
+
+// Encodes n ring samples (codes and Unix times, oldest first); returns the bytes written
+size_t history_bin_encode(uint8_t *out, uint64_t seq, const uint16_t *temp, const uint16_t *hum,
+                          const int64_t *time_ms, int n);
+
+#endif
@@ -9,11 +9,60 @@
  *
  * Key Features:
  * - `/data`: Returns the latest temperature and humidity readings as a JSON object.
- * - `/history`: Returns historical temperature and humidity data as a JSON object.
+ *   `?after=<seq>` long-polls: the connection is suspended until a sample newer
+ *   than `seq` is published, then gets it with its seq (longpoll.c).
+ * - `/history`: Returns historical temperature and humidity data as a JSON object,
+ *   serialized once per sample and shared by all requests (response_cache.c).
+ *   With `Accept: application/octet-stream` or `?format=bin` the same data
+ *   comes as packed little-endian int16 columns instead (history_bin.h).
+ *   Every sample carries its Unix time (ms) in the `time` array.
+ *   `?since=<seq>` returns only the samples newer than `seq`, or a resync marker
+ *   when `seq` has left the ring. `?resolution=minute|hour` returns the per-minute
+ *   (48 h) or per-hour (1 year) min/max/avg rollups instead of raw samples.
+ *   `?points=<n>` returns at most n points per channel picked by LTTB (lttb.c)
+ *   from the raw ring, or from the rollup averages with `&resolution=`;
+ *   cached per (series, n) until the next sample, in LTTB_CACHE_SLOTS slots
+ *   reused least recently used first. It cannot be combined with `from`/`to`
+ *   (400): a range is streamed row by row and never held for downsampling.
+ *   `?from=<ms>&to=<ms>` streams the samples of a time range, from the archive
+ *   and the ring, as [seq, unix_ms, t, rh] rows (range_stream.c); negative
+ *   bounds are relative to now.
+ * - `/stats`: Min/max/mean/stddev of the last `?window=<n>[s|m|h|d]` (default
+ *   5 min), answered in O(log n) from segment trees over the ring and the
+ *   rollups.
+ * - `/archive`: Streams the compressed long-term archive in the same rows;
+ *   `?since=<seq>` starts after that sample.
+ * - `/stream`: Server-Sent Events stream with one event per new sample (stream.c).
+ *   Idle subscribers are suspended and woken by the sensor thread (waitlist.c).
+ * - `/ws`: WebSocket pushing one 24-byte binary frame per new sample (seq, time,
+ *   raw codes, flags); slow clients lose their oldest frames (websocket.c).
+ * - `/status`: Returns acquisition counters (CRC failures, retries, bus errors) and
+ *   scheduler cadence counters (missed deadlines, jitter histogram), response
+ *   cache hit/miss counters and the number of stream subscribers, pending long
+ *   polls and WebSocket clients (with frames dropped) as JSON.
+ * - `/metrics`: Prometheus text format: the latest reading, the /status counters,
+ *   cache hits and misses, and per-route request counts and latency histograms
+ *   with I2C transaction, conversion wait and body build histograms, recorded
+ *   in per-thread shards (metrics.c). Merged at most once per second.
+ * - `/config`: Returns the measurement resolution; `POST /config?resolution=14|13|12|11`
+ *   changes it (405 on GET). The change is applied between cycles by the sensor
+ *   thread: until then the answer is 202 with the current and pending resolutions.
  * - Default route: Serves an HTML page for unsupported endpoints.
  *
+ * Dynamic bodies are built in a per-response arena (arena.c) that MHD releases
+ * through the response free callback after transmission.
+ *
+ * Clients sending `Accept-Encoding: gzip` get the dashboard compressed once at
+ * startup, and the cached /history bodies (full, binary and downsampled)
+ * compressed at most once per sample and shared like the plain ones (gzip.c).
+ *
+ * Sample-derived responses carry a strong ETag built from the data version and
+ * `Cache-Control: max-age` up to the next measurement cycle; a matching
+ * If-None-Match is answered 304 Not Modified before any body is built.
+ *
  * Functions:
  * - `handler`: Handles incoming HTTP requests and generates appropriate responses.
+ * - `dispatch`: Routes a request and queues its response; `handler` times it.
  * - `main`: Initializes the sensor loop and starts the HTTP server daemon.
  *
  * Dependencies:
@@ -23,104 +72,1664 @@
 
 #include "http_server.h"
 
+static struct response_cache history_cache = RESPONSE_CACHE_INIT; // Serialized /history body
+static struct response_cache history_bin_cache = RESPONSE_CACHE_INIT; // Binary /history body
+static struct response_cache tier_cache[HISTORY_TIERS] = { RESPONSE_CACHE_INIT, RESPONSE_CACHE_INIT }; // Serialized rollup tiers
+
+static struct response_cache lttb_cache[LTTB_CACHE_SLOTS] = {
+    RESPONSE_CACHE_INIT, RESPONSE_CACHE_INIT, RESPONSE_CACHE_INIT, RESPONSE_CACHE_INIT,
+}; // Downsampled series, slot assigned by lttb_slot()
+
+// gzip variants of the cached bodies above, compressed at most once per version
+static struct response_cache history_gz_cache[2] = { RESPONSE_CACHE_INIT, RESPONSE_CACHE_INIT }; // JSON, binary
+static struct response_cache lttb_gz_cache[LTTB_CACHE_SLOTS] = {
+    RESPONSE_CACHE_INIT, RESPONSE_CACHE_INIT, RESPONSE_CACHE_INIT, RESPONSE_CACHE_INIT,
+};
+
+static struct response_cache metrics_cache = RESPONSE_CACHE_INIT; // Scrape body, rebuilt at most once per METRICS_CACHE_MS
+
+static char *html_gz;       // Dashboard compressed at startup (NULL: send it as is)
+static size_t html_gz_len;
+static uint64_t html_hash;  // FNV-1a hash of the dashboard, its ETag
+
+static uint64_t etag_run;   // Start time of this run: sequence numbers restart without a history file
+
+// Validators and freshness of a response that can be answered with 304 Not Modified
+struct validators
+{
+    char etag[ETAG_MAX];
+    char cache_control[32];
+    const char *vary;       // Request headers selecting the representation, NULL if none
+};
+
+static const char *const tier_names[HISTORY_TIERS] = { "minute", "hour" }; // Values of ?resolution=
+
+// Series downsampled by /history?points=: the raw ring, then the rollup tiers
+enum lttb_source { LTTB_RAW, LTTB_MINUTE, LTTB_HOUR };
+
+#define LTTB_KEY(source, points) ((uint32_t)(source) << 16 | (uint32_t)(points)) // Cache key of a downsampled body (never 0)
+
+// Keys held by the lttb_cache/lttb_gz_cache slots, least recently used evicted first
+struct lttb_slots
+{
+    pthread_mutex_t lock;
+    uint32_t key[LTTB_CACHE_SLOTS];  // Key assigned to each slot, 0 if none yet
+    uint64_t used[LTTB_CACHE_SLOTS]; // Tick of the last lookup of each slot
+    uint64_t tick;                   // Lookups so far
+};
+
+static struct lttb_slots lttb_slots = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
 /**
- * @brief HTTP request handler for the server.
+ * @brief Writes the time, temperature and humidity arrays of a history document.
  *
- * Handles different endpoints ("/data", "/history", others) and generates appropriate HTTP responses.
+ * Codes are decoded through the sample_codec.h tables; slots that never held
+ * a sample are written as 0.00 at time 0.
+ *
+ * @param p Output cursor with room for 3 * n values.
+ * @param temp_history Temperature codes, oldest first.
+ * @param hum_history Humidity codes, oldest first.
+ * @param time_history Unix times in ms, oldest first.
+ * @param n Number of samples.
+ * @return Cursor past the closing brace.
+ */
+static char *put_history_arrays(char *p, const uint16_t *temp_history, const uint16_t *hum_history,
+                                const int64_t *time_history, int n)
+{
+    p = json_put_lit(p, "\"time\": [");
+    for (int i = 0; i < n; i++)
+    {
+        if (i > 0)
+            *p++ = ',';
+        p = json_put_u64(p, temp_history[i] & SAMPLE_VALID ? (uint64_t)time_history[i] : 0);
+    }
+
+    p = json_put_lit(p, "],\"temperature\": ["); // Start temperature array
+    for (int i = 0; i < n; i++) // Build temperature JSON array
+    {
+        if (i > 0)
+            *p++ = ','; // Add comma between values
+        p = json_put_centi(p, temp_history[i] & SAMPLE_VALID ? temp_centi(temp_history[i]) : 0); // Format temperature value
+    }
+
+    p = json_put_lit(p, "],\"humidity\": ["); // Start humidity array in JSON response
+    for (int i = 0; i < n; i++) // Build humidity JSON array
+    {
+        if (i > 0)
+            *p++ = ',';
+        p = json_put_centi(p, temp_history[i] & SAMPLE_VALID ? hum_centi(hum_history[i]) : 0); // Format humidity value
+    }
+    return json_put_lit(p, "]}"); // Close JSON response
+}
+
+/**
+ * @brief Serializes the history rings as the /history JSON document.
+ *
+ * The ring snapshot and the body are both allocated from the arena, so the
+ * document needs no stack space or per-value allocation however large
+ * MAX_HISTORY is.
+ *
+ * @param arena Arena of HISTORY_ARENA_SIZE bytes.
+ * @param body Receives the body, its length and its sample sequence number.
+ * @return 0 on success, -1 if the arena is too small.
+ */
+static int build_history_json(struct arena *arena, struct cached_body *body)
+{
+    uint16_t *temp_history = arena_alloc(arena, MAX_HISTORY * sizeof(uint16_t));
+    uint16_t *hum_history = arena_alloc(arena, MAX_HISTORY * sizeof(uint16_t));
+    int64_t *time_history = arena_alloc(arena, MAX_HISTORY * sizeof(int64_t));
+    char *json_response = arena_alloc(arena, HISTORY_JSON_MAX); // Buffer to hold the JSON response
+    char *p = json_response; // Output cursor: the buffer is written once, never rescanned
+
+    if (temp_history == NULL || hum_history == NULL || time_history == NULL || json_response == NULL)
+        return -1;
+
+    body->version = get_history(temp_history, hum_history, time_history); // Retrieve historical temperature and humidity data
+
+    p = json_put_lit(p, "{\"seq\": "); // Sequence number of the newest sample, for ?since=
+    p = json_put_u64(p, body->version);
+    p = json_put_lit(p, ", ");
+    p = put_history_arrays(p, temp_history, hum_history, time_history, MAX_HISTORY);
+
+    body->data = json_response;
+    body->len = (size_t)(p - json_response);
+    return 0;
+}
+
+/**
+ * @brief Encodes the history rings as the binary /history document (history_bin.h).
+ *
+ * @param arena Arena of HISTORY_BIN_ARENA_SIZE bytes.
+ * @param body Receives the body, its length and its sample sequence number.
+ * @return 0 on success, -1 if the arena is too small.
+ */
+static int build_history_bin(struct arena *arena, struct cached_body *body)
+{
+    uint16_t *temp_history = arena_alloc(arena, MAX_HISTORY * sizeof(uint16_t));
+    uint16_t *hum_history = arena_alloc(arena, MAX_HISTORY * sizeof(uint16_t));
+    int64_t *time_history = arena_alloc(arena, MAX_HISTORY * sizeof(int64_t));
+    uint8_t *bin = arena_alloc(arena, HISTORY_BIN_SIZE(MAX_HISTORY));
+
+    if (temp_history == NULL || hum_history == NULL || time_history == NULL || bin == NULL)
+        return -1;
+
+    body->version = get_history(temp_history, hum_history, time_history);
+    body->data = (char *)bin;
+    body->len = history_bin_encode(bin, body->version, temp_history, hum_history, time_history, MAX_HISTORY);
+    return 0;
+}
+
+/**
+ * @brief Serializes the samples newer than `since` (/history?since=).
+ *
+ * Produces {"seq": N, "since": S, "time": [...], "temperature": [...], "humidity": [...]},
+ * or {"seq": N, "resync": true} when `since` is no longer in the ring and the
+ * client has to reload the full history.
+ *
+ * @param arena Arena of HISTORY_ARENA_SIZE bytes.
+ * @param since Last sequence number the client has.
+ * @param len Receives the body length.
+ * @return The body, or NULL if the arena is too small.
+ */
+static char *build_history_delta(struct arena *arena, uint64_t since, size_t *len)
+{
+    uint16_t *temp_history = arena_alloc(arena, MAX_HISTORY * sizeof(uint16_t));
+    uint16_t *hum_history = arena_alloc(arena, MAX_HISTORY * sizeof(uint16_t));
+    int64_t *time_history = arena_alloc(arena, MAX_HISTORY * sizeof(int64_t));
+    char *json_response = arena_alloc(arena, HISTORY_JSON_MAX);
+    char *p = json_response;
+    uint64_t seq;
+    int count;
+
+    if (temp_history == NULL || hum_history == NULL || time_history == NULL || json_response == NULL)
+        return NULL;
+
+    seq = get_history_since(since, temp_history, hum_history, time_history, &count);
+
+    p = json_put_lit(p, "{\"seq\": ");
+    p = json_put_u64(p, seq);
+    if (count < 0) // Fell out of the ring: the client reloads /history
+    {
+        p = json_put_lit(p, ", \"resync\": true}");
+    }
+    else
+    {
+        p = json_put_lit(p, ", \"since\": ");
+        p = json_put_u64(p, since);
+        p = json_put_lit(p, ", ");
+        p = put_history_arrays(p, temp_history, hum_history, time_history, count);
+    }
+
+    *len = (size_t)(p - json_response);
+    return json_response;
+}
+
+// Statistic written by put_rollup_column()
+enum rollup_column { COLUMN_MIN, COLUMN_MAX, COLUMN_AVG };
+
+/**
+ * @brief Writes one statistic of one channel as a JSON array.
+ *
+ * Buckets without samples are written as null.
+ *
+ * @param p Output cursor.
+ * @param buckets Buckets, oldest first.
+ * @param n Number of buckets.
+ * @param channel Channel index (0 temperature, 1 humidity).
+ * @param column Statistic to write.
+ * @return Cursor past the closing bracket.
+ */
+static char *put_rollup_column(char *p, const struct rollup_bucket *buckets, unsigned n,
+                               int channel, enum rollup_column column)
+{
+    *p++ = '[';
+    for (unsigned i = 0; i < n; i++)
+    {
+        const struct rollup_bucket *b = &buckets[i];
+
+        if (i > 0)
+            *p++ = ',';
+        if (b->count == 0)
+            p = json_put_lit(p, "null"); // Sensor down for the whole period
+        else if (column == COLUMN_MIN)
+            p = json_put_centi(p, b->min[channel]);
+        else if (column == COLUMN_MAX)
+            p = json_put_centi(p, b->max[channel]);
+        else
+            p = json_put_centi(p, rollup_avg(b, channel));
+    }
+    *p++ = ']';
+    return p;
+}
+
+/**
+ * @brief Serializes one rollup tier (/history?resolution=minute|hour).
+ *
+ * Bucket numbers count CLOCK_MONOTONIC periods; the oldest one is converted
+ * to a Unix time when the body is built.
+ *
+ * @param arena Arena of ROLLUP_ARENA_SIZE(history_tier_len(tier)) bytes.
+ * @param body Receives the body, its length and its sample sequence number.
+ * @param tier Tier to serialize.
+ * @return 0 on success, -1 if the arena is too small.
+ */
+static int build_rollup_json(struct arena *arena, struct cached_body *body, enum history_tier tier)
+{
+    unsigned len = history_tier_len(tier);
+    struct rollup_bucket *buckets = arena_alloc(arena, len * sizeof(*buckets));
+    char *json_response = arena_alloc(arena, ROLLUP_JSON_MAX(len));
+    char *p = json_response;
+    struct rollup_span span;
+    struct timespec mono, wall;
+    uint64_t start;
+
+    if (buckets == NULL || json_response == NULL)
+        return -1;
+
+    get_rollup(tier, buckets, &span);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &wall);
+    start = (uint64_t)wall.tv_sec - ((uint64_t)mono.tv_sec - span.first * span.period_s);
+    body->version = span.seq;
+
+    p = json_put_lit(p, "{\"resolution\": \"");
+    memcpy(p, tier_names[tier], strlen(tier_names[tier]));
+    p += strlen(tier_names[tier]);
+    p = json_put_lit(p, "\", \"period_s\": ");
+    p = json_put_u64(p, span.period_s);
+    p = json_put_lit(p, ", \"seq\": ");
+    p = json_put_u64(p, span.seq);
+    p = json_put_lit(p, ", \"start\": "); // Unix time of the oldest bucket
+    p = json_put_u64(p, start);
+    p = json_put_lit(p, ", \"count\": [");
+    for (unsigned i = 0; i < span.count; i++)
+    {
+        if (i > 0)
+            *p++ = ',';
+        p = json_put_u64(p, buckets[i].count);
+    }
+    for (int c = 0; c < ROLLUP_CHANNELS; c++) // Same layout for both channels
+    {
+        p = c == 0 ? json_put_lit(p, "], \"temperature\": {\"min\": ")
+                   : json_put_lit(p, "}, \"humidity\": {\"min\": ");
+        p = put_rollup_column(p, buckets, span.count, c, COLUMN_MIN);
+        p = json_put_lit(p, ", \"max\": ");
+        p = put_rollup_column(p, buckets, span.count, c, COLUMN_MAX);
+        p = json_put_lit(p, ", \"avg\": ");
+        p = put_rollup_column(p, buckets, span.count, c, COLUMN_AVG);
+    }
+    p = json_put_lit(p, "}}");
+
+    body->data = json_response;
+    body->len = (size_t)(p - json_response);
+    return 0;
+}
+
+static int build_minute_json(struct arena *arena, struct cached_body *body)
+{
+    return build_rollup_json(arena, body, HISTORY_MINUTE);
+}
+
+static int build_hour_json(struct arena *arena, struct cached_body *body)
+{
+    return build_rollup_json(arena, body, HISTORY_HOUR);
+}
+
+/**
+ * @brief Returns the number of points of a downsampling source.
+ */
+static unsigned lttb_source_len(enum lttb_source source)
+{
+    return source == LTTB_RAW ? MAX_HISTORY : history_tier_len((enum history_tier)(source - LTTB_MINUTE));
+}
+
+/**
+ * @brief Copies a series to downsample: sample times and both channels.
+ *
+ * The raw ring gives its valid samples; a rollup tier gives the average of
+ * each non-empty bucket, timed at the bucket start.
+ *
+ * @param arena Arena for the copy.
+ * @param source Series to copy.
+ * @param x Receives the Unix times (ms).
+ * @param y Receives the temperature and humidity values (hundredths).
+ * @param version Receives the sample sequence number of the copy.
+ * @return Number of points, or -1 if the arena is too small.
+ */
+static int lttb_series(struct arena *arena, enum lttb_source source, int64_t **x, int32_t *y[2],
+                       uint64_t *version)
+{
+    unsigned len = lttb_source_len(source);
+    int n = 0;
+
+    *x = arena_alloc(arena, len * sizeof(int64_t));
+    y[0] = arena_alloc(arena, len * sizeof(int32_t));
+    y[1] = arena_alloc(arena, len * sizeof(int32_t));
+    if (*x == NULL || y[0] == NULL || y[1] == NULL)
+        return -1;
+
+    if (source == LTTB_RAW)
+    {
+        uint16_t *temp_history = arena_alloc(arena, MAX_HISTORY * sizeof(uint16_t));
+        uint16_t *hum_history = arena_alloc(arena, MAX_HISTORY * sizeof(uint16_t));
+        int64_t *time_history = arena_alloc(arena, MAX_HISTORY * sizeof(int64_t));
+
+        if (temp_history == NULL || hum_history == NULL || time_history == NULL)
+            return -1;
+        *version = get_history(temp_history, hum_history, time_history);
+        for (int i = 0; i < MAX_HISTORY; i++)
+        {
+            if (!(temp_history[i] & SAMPLE_VALID))
+                continue; // Never written
+            (*x)[n] = time_history[i];
+            y[0][n] = temp_centi(temp_history[i]);
+            y[1][n] = hum_centi(hum_history[i]);
+            n++;
+        }
+    }
+    else
+    {
+        struct rollup_bucket *buckets = arena_alloc(arena, len * sizeof(*buckets));
+        struct rollup_span span;
+        int64_t start_ms;
+
+        if (buckets == NULL)
+            return -1;
+        get_rollup((enum history_tier)(source - LTTB_MINUTE), buckets, &span);
+        start_ms = (int64_t)(span.first * span.period_s) * 1000 + clock_offset_ms(); // Oldest bucket, Unix time
+        *version = span.seq;
+        for (unsigned i = 0; i < span.count; i++)
+        {
+            if (buckets[i].count == 0)
+                continue; // Sensor down for the whole period
+            (*x)[n] = start_ms + (int64_t)i * span.period_s * 1000;
+            y[0][n] = rollup_avg(&buckets[i], 0);
+            y[1][n] = rollup_avg(&buckets[i], 1);
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Serializes a downsampled series (/history?points=).
+ *
+ * Produces {"seq": N, "resolution": "raw", "points": P,
+ * "temperature": {"time": [...], "value": [...]}, "humidity": {...}}. Each
+ * channel is downsampled on its own, so each keeps its own peaks.
+ *
+ * @param arena Arena of LTTB_ARENA_SIZE(source length, points) bytes.
+ * @param body Receives the body; body->key holds LTTB_KEY(source, points).
+ * @return 0 on success, -1 if the arena is too small.
+ */
+static int build_lttb_json(struct arena *arena, struct cached_body *body)
+{
+    enum lttb_source source = (enum lttb_source)(body->key >> 16);
+    size_t points = body->key & 0xFFFF;
+    uint32_t *index = arena_alloc(arena, points * sizeof(uint32_t));
+    char *json_response = arena_alloc(arena, LTTB_JSON_MAX(points));
+    char *p = json_response;
+    int64_t *x;
+    int32_t *y[2];
+    int n;
+
+    if (index == NULL || json_response == NULL || (n = lttb_series(arena, source, &x, y, &body->version)) < 0)
+        return -1;
+
+    p = json_put_lit(p, "{\"seq\": ");
+    p = json_put_u64(p, body->version);
+    p = json_put_lit(p, ", \"resolution\": \"");
+    if (source == LTTB_RAW)
+        p = json_put_lit(p, "raw");
+    else
+    {
+        memcpy(p, tier_names[source - LTTB_MINUTE], strlen(tier_names[source - LTTB_MINUTE]));
+        p += strlen(tier_names[source - LTTB_MINUTE]);
+    }
+    p = json_put_lit(p, "\", \"points\": ");
+    p = json_put_u64(p, points);
+    for (int c = 0; c < ROLLUP_CHANNELS; c++)
+    {
+        size_t kept = lttb_select(x, y[c], (size_t)n, points, index);
+
+        p = c == 0 ? json_put_lit(p, ", \"temperature\": {\"time\": [")
+                   : json_put_lit(p, "}, \"humidity\": {\"time\": [");
+        for (size_t i = 0; i < kept; i++)
+        {
+            if (i > 0)
+                *p++ = ',';
+            p = json_put_u64(p, (uint64_t)x[index[i]]);
+        }
+        p = json_put_lit(p, "], \"value\": [");
+        for (size_t i = 0; i < kept; i++)
+        {
+            if (i > 0)
+                *p++ = ',';
+            p = json_put_centi(p, y[c][index[i]]);
+        }
+        *p++ = ']';
+    }
+    p = json_put_lit(p, "}}");
+
+    body->data = json_response;
+    body->len = (size_t)(p - json_response);
+    return 0;
+}
+
+/**
+ * @brief Allocates a fresh single-use arena holding one body buffer.
+ *
+ * @param arena Receives the arena (one reference, handed to arena_response()).
+ * @param cap Size of the body buffer.
+ * @return The body buffer, or NULL on allocation failure.
+ */
+static char *arena_body(struct arena **arena, size_t cap)
+{
+    char *buf;
+
+    *arena = arena_create(ARENA_SIZE(cap));
+    if (*arena == NULL)
+        return NULL;
+    buf = arena_alloc(*arena, cap);
+    if (buf == NULL)
+    {
+        arena_release(*arena);
+        *arena = NULL;
+    }
+    return buf;
+}
+
+/**
+ * @brief Returns the lttb_cache/lttb_gz_cache slot of a key.
+ *
+ * A key keeps its slot while it is looked up; a new key takes the slot used
+ * least recently, so a few canvas widths in use at once never evict each
+ * other. A slot reassigned between this call and the cache lookup only costs
+ * a rebuild: the cache checks the key of the body it holds.
+ *
+ * @param key LTTB_KEY(source, points).
+ * @return Slot index.
+ */
+static unsigned lttb_slot(uint32_t key)
+{
+    unsigned slot = 0;
+
+    pthread_mutex_lock(&lttb_slots.lock);
+    for (unsigned i = 0; i < LTTB_CACHE_SLOTS; i++)
+    {
+        if (lttb_slots.key[i] == key)
+        {
+            slot = i;
+            break;
+        }
+        if (lttb_slots.used[i] < lttb_slots.used[slot])
+            slot = i; // Oldest so far (never used slots have tick 0)
+    }
+    lttb_slots.key[slot] = key;
+    lttb_slots.used[slot] = ++lttb_slots.tick;
+    pthread_mutex_unlock(&lttb_slots.lock);
+    return slot;
+}
+
+/**
+ * @brief Returns the cached downsampled body of a key (/history?points=).
+ *
+ * @param key LTTB_KEY(source, points), points clamped to the source length.
+ * @return Referenced body, or NULL on allocation failure.
+ */
+static struct cached_body *lttb_body(uint32_t key)
+{
+    return response_cache_get_keyed(&lttb_cache[lttb_slot(key)], get_sample_seq(), key,
+                                    LTTB_ARENA_SIZE(lttb_source_len((enum lttb_source)(key >> 16)), key & 0xFFFF),
+                                    build_lttb_json);
+}
+
+/**
+ * @brief Compresses a cached body into a gzip variant body.
+ *
+ * @param arena Arena of ARENA_SIZE(GZIP_BOUND(source length bound)) bytes.
+ * @param body Receives the compressed body and the source version.
+ * @param source Referenced identity body, released here; NULL fails.
+ * @return 0 on success, -1 on failure.
+ */
+static int gzip_body(struct arena *arena, struct cached_body *body, struct cached_body *source)
+{
+    char *out;
+
+    if (source == NULL)
+        return -1;
+    out = arena_alloc(arena, GZIP_BOUND(source->len));
+    body->version = source->version;
+    body->len = out != NULL ? gzip_compress(out, GZIP_BOUND(source->len), source->data, source->len,
+                                            GZIP_LEVEL_DYNAMIC) : 0;
+    body->data = out;
+    cached_body_release(source);
+    return body->len > 0 ? 0 : -1;
+}
+
+static int build_history_json_gz(struct arena *arena, struct cached_body *body)
+{
+    return gzip_body(arena, body, response_cache_get(&history_cache, get_sample_seq(),
+                                                     HISTORY_ARENA_SIZE, build_history_json));
+}
+
+static int build_history_bin_gz(struct arena *arena, struct cached_body *body)
+{
+    return gzip_body(arena, body, response_cache_get(&history_bin_cache, get_sample_seq(),
+                                                     HISTORY_BIN_ARENA_SIZE, build_history_bin));
+}
+
+static int build_lttb_gz(struct arena *arena, struct cached_body *body)
+{
+    return gzip_body(arena, body, lttb_body(body->key));
+}
+
+/**
+ * @brief Hashes the dashboard and compresses it once, before the server starts.
+ *
+ * On compression failure the dashboard is simply sent uncompressed.
+ */
+static void prepare_dashboard(void)
+{
+    size_t len = strlen(html_page);
+    char *out = malloc(GZIP_BOUND(len));
+
+    html_hash = 0xcbf29ce484222325ULL; // FNV-1a 64
+    for (size_t i = 0; i < len; i++)
+        html_hash = (html_hash ^ (unsigned char)html_page[i]) * 0x100000001b3ULL;
+
+    if (out == NULL)
+        return;
+    html_gz_len = gzip_compress(out, GZIP_BOUND(len), html_page, len, GZIP_LEVEL_STATIC);
+    if (html_gz_len == 0)
+    {
+        free(out);
+        return;
+    }
+    html_gz = out;
+}
+
+/**
+ * @brief Creates a response over an arena-backed body.
+ *
+ * MHD sends the body in place and calls arena_release() once it is done, so
+ * the memory outlives the handler exactly as long as needed.
+ *
+ * @param arena Arena owning the body (its reference is transferred).
+ * @param body Body inside the arena.
+ * @param len Body length.
+ * @return The response, or NULL on failure (the arena is released).
+ */
+static struct MHD_Response *arena_response(struct arena *arena, const char *body, size_t len)
+{
+    struct MHD_Response *response =
+        MHD_create_response_from_buffer_with_free_callback_cls(len, body, &arena_release, arena);
+    if (response == NULL)
+        arena_release(arena);
+    return response;
+}
+
+/**
+ * @brief Formats the /status JSON document.
+ *
+ * Every snprintf() is checked: a document that does not fit is reported as a
+ * failure rather than sent cut off into invalid JSON. STATUS_BODY_MAX holds
+ * every counter at full width, so this only fires if a field is added
+ * without updating STATUS_NUMBERS.
+ *
+ * @param buf Output buffer.
+ * @param len Size of the output buffer.
+ * @return Length of the document, or 0 if it did not fit.
+ */
+static size_t format_status(char *buf, size_t len)
+{
+    struct sensor_stats st;
+    struct scheduler_stats sc;
+    struct archive_stats ar;
+    struct gzip_stats gz;
+    unsigned long lttb_hits = 0, lttb_misses = 0;
+    size_t n;
+    int ret;
+
+    get_sensor_stats(&st);    // Snapshot the acquisition counters
+    get_scheduler_stats(&sc); // Snapshot the cadence counters
+    archive_get_stats(&ar);
+    gzip_get_stats(&gz);
+    for (int i = 0; i < LTTB_CACHE_SLOTS; i++)
+    {
+        lttb_hits += atomic_load_explicit(&lttb_cache[i].hits, memory_order_relaxed);
+        lttb_misses += atomic_load_explicit(&lttb_cache[i].misses, memory_order_relaxed);
+    }
+
+    ret = snprintf(buf, len,
+                 "{\"sensor\": {\"samples\": %lu, \"read_errors\": %lu, \"crc_errors\": %lu, "
+                 "\"crc_retries\": %lu, \"nacks\": %lu, \"timeouts\": %lu, \"bus_errors\": %lu}, "
+                 "\"scheduler\": {\"interval_ms\": %ld, \"cycles\": %lu, \"missed\": %lu, "
+                 "\"overruns\": %lu, \"max_jitter_us\": %ld, \"jitter_us\": {",
+                 st.samples, st.read_errors, st.crc_errors, st.crc_retries,
+                 st.nacks, st.timeouts, st.bus_errors,
+                 sc.interval_ms, sc.cycles, sc.missed, sc.overruns, sc.max_jitter_us);
+    if (ret < 0)
+        return 0;
+    n = (size_t)ret;
+
+    for (int i = 0; i < JITTER_BUCKETS && n < len; i++) // Histogram buckets keyed by upper bound
+    {
+        ret = snprintf(buf + n, len - n, "\"le_%ld\": %lu, ", jitter_bounds_us[i], sc.jitter[i]);
+        if (ret < 0)
+            return 0;
+        n += (size_t)ret;
+    }
+    if (n >= len) // snprintf() returns the length it wanted: past the buffer means cut off
+        return 0;
+    ret = snprintf(buf + n, len - n, "\"inf\": %lu}}, "
+                 "\"cache\": {\"history_hits\": %lu, \"history_misses\": %lu, "
+                 "\"lttb_hits\": %lu, \"lttb_misses\": %lu}, "
+                 "\"stream\": {\"clients\": %lu, \"long_polls\": %lu, \"ws_clients\": %lu, \"ws_dropped\": %lu}, "
+                 "\"archive\": {\"blocks\": %lu, \"samples\": %lu, \"bytes\": %lu}, "
+                 "\"gzip\": {\"bodies\": %lu, \"bytes_in\": %llu, \"bytes_out\": %llu, \"cpu_us\": %llu}}",
+                 sc.jitter[JITTER_BUCKETS],
+                 atomic_load_explicit(&history_cache.hits, memory_order_relaxed) +
+                     atomic_load_explicit(&history_bin_cache.hits, memory_order_relaxed), // Both formats
+                 atomic_load_explicit(&history_cache.misses, memory_order_relaxed) +
+                     atomic_load_explicit(&history_bin_cache.misses, memory_order_relaxed),
+                 lttb_hits, lttb_misses,
+                 stream_clients(), longpoll_waiting(), ws_clients(), ws_dropped(), ar.blocks, ar.samples, ar.bytes,
+                 gz.bodies, (unsigned long long)gz.bytes_in, (unsigned long long)gz.bytes_out,
+                 (unsigned long long)(gz.ns / 1000));
+    if (ret < 0 || (size_t)ret >= len - n)
+        return 0;
+    return n + (size_t)ret;
+}
+
+/**
+ * @brief Returns the current /metrics period: scrapes within one share a body.
+ */
+static uint64_t metrics_period(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(timespec_ms(&now) / METRICS_CACHE_MS);
+}
+
+/**
+ * @brief Formats the /metrics document (Prometheus text format 0.0.4).
+ *
+ * The latest reading, the counters /status reports (as counters and gauges)
+ * and the cache hit/miss counters, then the request counters and latency
+ * histograms merged from the per-thread shards (metrics.c).
+ *
+ * @param b Scrape output.
+ */
+static void format_metrics(struct metrics_buf *b)
+{
+    static const struct
+    {
+        const char *name;
+        struct response_cache *caches;
+        int n;
+    } caches[] = {
+        { "history", &history_cache, 1 },
+        { "history_bin", &history_bin_cache, 1 },
+        { "minute", &tier_cache[HISTORY_MINUTE], 1 },
+        { "hour", &tier_cache[HISTORY_HOUR], 1 },
+        { "lttb", lttb_cache, LTTB_CACHE_SLOTS },
+        { "history_gz", &history_gz_cache[0], 1 },
+        { "history_bin_gz", &history_gz_cache[1], 1 },
+        { "lttb_gz", lttb_gz_cache, LTTB_CACHE_SLOTS },
+        { "metrics", &metrics_cache, 1 },
+    };
+    struct sensor_stats st;
+    struct scheduler_stats sc;
+    struct archive_stats ar;
+    struct gzip_stats gz;
+    struct sensor_sample sample;
+
+    get_sensor_stats(&st);
+    get_scheduler_stats(&sc);
+    archive_get_stats(&ar);
+    gzip_get_stats(&gz);
+
+    const struct
+    {
+        const char *name, *type, *help;
+        unsigned long long value;
+    } values[] = {
+        { "htu21d_samples_total", "counter", "Measurement cycles published.", st.samples },
+        { "htu21d_read_errors_total", "counter", "Measurement cycles that failed.", st.read_errors },
+        { "htu21d_crc_errors_total", "counter", "Frames rejected by the CRC check.", st.crc_errors },
+        { "htu21d_crc_retries_total", "counter", "Conversions repeated after a CRC mismatch.", st.crc_retries },
+        { "htu21d_nacks_total", "counter", "Reads NACKed while the chip was converting.", st.nacks },
+        { "htu21d_timeouts_total", "counter", "Conversions that never completed.", st.timeouts },
+        { "htu21d_bus_errors_total", "counter", "Other I2C failures.", st.bus_errors },
+        { "htu21d_cycles_total", "counter", "Measurement cycles started.", sc.cycles },
+        { "htu21d_missed_periods_total", "counter", "Sampling periods skipped because a cycle overran.", sc.missed },
+        { "htu21d_overruns_total", "counter", "Cycles that finished after the next start was due.", sc.overruns },
+        { "htu21d_archive_blocks", "gauge", "Compressed blocks in the archive.", ar.blocks },
+        { "htu21d_archive_bytes", "gauge", "Size of the archive file.", ar.bytes },
+        { "http_stream_clients", "gauge", "Server-Sent Events subscribers.", stream_clients() },
+        { "http_long_polls", "gauge", "Pending /data?after= long polls.", longpoll_waiting() },
+        { "http_ws_clients", "gauge", "Connected WebSocket clients.", ws_clients() },
+        { "http_ws_dropped_frames_total", "counter", "Frames dropped from the queues of slow WebSocket clients.", ws_dropped() },
+        { "http_gzip_bodies_total", "counter", "Response bodies gzip-compressed.", gz.bodies },
+        { "http_gzip_in_bytes_total", "counter", "Bytes before gzip compression.", gz.bytes_in },
+        { "http_gzip_out_bytes_total", "counter", "Bytes after gzip compression.", gz.bytes_out },
+    };
+
+    if (get_sample(get_sample_seq(), &sample) == 0) // No reading before the first sample
+    {
+        metrics_family(b, "htu21d_temperature_celsius", "gauge", "Latest temperature reading.");
+        metrics_printf(b, "htu21d_temperature_celsius %.2f\n", sample.temperature / 100.0);
+        metrics_family(b, "htu21d_humidity_percent", "gauge", "Latest relative humidity reading.");
+        metrics_printf(b, "htu21d_humidity_percent %.2f\n", sample.humidity / 100.0);
+        metrics_family(b, "htu21d_sample_timestamp_seconds", "gauge", "Unix time of the latest reading.");
+        metrics_printf(b, "htu21d_sample_timestamp_seconds %lld.%03lld\n",
+                       (long long)(sample.time_ms / 1000), (long long)(sample.time_ms % 1000));
+        metrics_family(b, "htu21d_sample_seq", "gauge", "Sequence number of the latest reading.");
+        metrics_printf(b, "htu21d_sample_seq %llu\n", (unsigned long long)sample.seq);
+    }
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    {
+        metrics_family(b, values[i].name, values[i].type, values[i].help);
+        metrics_printf(b, "%s %llu\n", values[i].name, values[i].value);
+    }
+    metrics_family(b, "htu21d_max_start_delay_seconds", "gauge", "Worst lateness of a cycle start.");
+    metrics_printf(b, "htu21d_max_start_delay_seconds %ld.%06ld\n", sc.max_jitter_us / 1000000, sc.max_jitter_us % 1000000);
+    metrics_family(b, "http_gzip_cpu_seconds_total", "counter", "CPU time spent compressing.");
+    metrics_printf(b, "http_gzip_cpu_seconds_total %llu.%09llu\n",
+                   (unsigned long long)(gz.ns / NSEC_PER_SEC), (unsigned long long)(gz.ns % NSEC_PER_SEC));
+
+    metrics_family(b, "http_cache_hits_total", "counter", "Requests served from a cached body.");
+    for (size_t i = 0; i < sizeof(caches) / sizeof(caches[0]); i++)
+    {
+        unsigned long hits = 0;
+
+        for (int j = 0; j < caches[i].n; j++)
+            hits += atomic_load_explicit(&caches[i].caches[j].hits, memory_order_relaxed);
+        metrics_printf(b, "http_cache_hits_total{cache=\"%s\"} %lu\n", caches[i].name, hits);
+    }
+    metrics_family(b, "http_cache_misses_total", "counter", "Requests that rebuilt a cached body.");
+    for (size_t i = 0; i < sizeof(caches) / sizeof(caches[0]); i++)
+    {
+        unsigned long misses = 0;
+
+        for (int j = 0; j < caches[i].n; j++)
+            misses += atomic_load_explicit(&caches[i].caches[j].misses, memory_order_relaxed);
+        metrics_printf(b, "http_cache_misses_total{cache=\"%s\"} %lu\n", caches[i].name, misses);
+    }
+
+    metrics_format(b);
+}
+
+/**
+ * @brief Builds the /metrics body of the current period.
+ *
+ * Scrapes in the same METRICS_CACHE_MS period share it, so however often
+ * Prometheus (or anyone) scrapes, the shards are merged at most once per
+ * period, into a body of at most METRICS_BODY_MAX bytes.
+ *
+ * @param arena Arena of METRICS_ARENA_SIZE bytes.
+ * @param body Receives the body, its length and its period.
+ * @return 0 on success, -1 if the arena is too small.
+ */
+static int build_metrics(struct arena *arena, struct cached_body *body)
+{
+    struct metrics_buf b = { .data = arena_alloc(arena, METRICS_BODY_MAX), .len = 0,
+                             .cap = METRICS_BODY_MAX, .truncated = 0 };
+
+    if (b.data == NULL)
+        return -1;
+    body->version = metrics_period();
+    format_metrics(&b);
+    if (b.truncated)
+        return -1; // METRICS_BODY_MAX too small for the fixed series set
+    body->data = b.data;
+    body->len = b.len;
+    return 0;
+}
+
+/**
+ * @brief Parses a time range bound of /history?from=&to=.
+ *
+ * @param arg Argument value, NULL if absent (the bound is left open).
+ * @param now_ms Current Unix time in ms.
+ * @param out Receives the bound as Unix time in ms; negative values are relative to now.
+ * @return 0 on success, -1 if the value is not a decimal integer.
+ */
+static int parse_time_bound(const char *arg, int64_t now_ms, int64_t *out)
+{
+    char *end;
+    long long v;
+
+    if (arg == NULL)
+        return 0;
+    v = strtoll(arg, &end, 10);
+    if (end == arg || *end != '\0' || (*arg != '-' && (*arg < '0' || *arg > '9')))
+        return -1;
+    *out = v < 0 ? now_ms + v : v;
+    return 0;
+}
+
+/**
+ * @brief Parses the window length of /stats?window=.
+ *
+ * @param arg Argument value: a positive integer with an optional s, m, h or d
+ *            unit (seconds by default); NULL selects STATS_WINDOW_DEFAULT_S.
+ * @param out Receives the window length in ms.
+ * @return 0 on success, -1 if the value is malformed or longer than the hour tier.
+ */
+static int parse_window(const char *arg, int64_t *out)
+{
+    static const struct { char unit; long scale; } units[] = { { 's', 1 }, { 'm', 60 }, { 'h', 3600 }, { 'd', 86400 } };
+    unsigned long long v;
+    long scale = 1;
+    char *end;
+
+    if (arg == NULL)
+    {
+        *out = STATS_WINDOW_DEFAULT_S * 1000LL;
+        return 0;
+    }
+    v = strtoull(arg, &end, 10);
+    if (end == arg || *arg < '0' || *arg > '9' || v == 0)
+        return -1;
+    if (*end != '\0')
+    {
+        size_t u = 0;
+        while (u < sizeof(units) / sizeof(units[0]) && units[u].unit != *end)
+            u++;
+        if (u == sizeof(units) / sizeof(units[0]) || end[1] != '\0')
+            return -1;
+        scale = units[u].scale;
+    }
+    if (v > (unsigned long long)ROLLUP_HOUR_BUCKETS * ROLLUP_HOUR_S / scale) // Nothing retained beyond
+        return -1;
+    *out = (int64_t)v * scale * 1000;
+    return 0;
+}
+
+/**
+ * @brief Formats the /stats JSON document.
+ *
+ * @param buf Output buffer of at least SMALL_BODY_MAX bytes.
+ * @param window_ms Window length in ms.
+ * @return Length of the document.
+ */
+static size_t format_window_stats(char *buf, int64_t window_ms)
+{
+    static const char *const sources[1 + HISTORY_TIERS] = { "raw", "minute", "hour" };
+    struct window_stats ws;
+    char *p = buf;
+
+    get_window_stats(window_ms, &ws);
+
+    p = json_put_lit(p, "{\"window_s\": ");
+    p = json_put_u64(p, (uint64_t)(window_ms / 1000));
+    p = json_put_lit(p, ", \"source\": \"");
+    memcpy(p, sources[ws.tier + 1], strlen(sources[ws.tier + 1]));
+    p += strlen(sources[ws.tier + 1]);
+    p = json_put_lit(p, "\", \"seq\": ");
+    p = json_put_u64(p, ws.seq);
+    p = json_put_lit(p, ", \"from\": "); // Unix time (ms) of the first sample or bucket covered
+    p = json_put_u64(p, ws.from_ms > 0 ? (uint64_t)ws.from_ms : 0);
+    p = json_put_lit(p, ", \"count\": ");
+    p = json_put_u64(p, ws.agg.count);
+    for (int c = 0; c < ROLLUP_CHANNELS; c++)
+    {
+        p = c == 0 ? json_put_lit(p, ", \"temperature\": ") : json_put_lit(p, ", \"humidity\": ");
+        if (ws.agg.count == 0) // Nothing sampled in the window
+        {
+            p = json_put_lit(p, "null");
+            continue;
+        }
+        p = json_put_lit(p, "{\"min\": ");
+        p = json_put_centi(p, ws.agg.min[c]);
+        p = json_put_lit(p, ", \"max\": ");
+        p = json_put_centi(p, ws.agg.max[c]);
+        p = json_put_lit(p, ", \"mean\": ");
+        p = json_put_centi(p, rollup_avg(&ws.agg, c));
+        p = json_put_lit(p, ", \"stddev\": ");
+        p = json_put_centi(p, rollup_stddev(&ws.agg, c));
+        *p++ = '}';
+    }
+    *p++ = '}';
+    return (size_t)(p - buf);
+}
+
+/**
+ * @brief Picks the representation of the plain /history document.
+ *
+ * `?format=` decides; without it, an Accept header listing
+ * application/octet-stream selects the binary columns.
+ *
+ * @param connection The MHD connection object.
+ * @return 1 for binary, 0 for JSON, -1 for an unknown format.
+ */
+static int history_format(struct MHD_Connection *connection)
+{
+    const char *format = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "format");
+    const char *accept = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Accept");
+
+    if (format == NULL)
+        return accept != NULL && strstr(accept, "application/octet-stream") != NULL;
+    if (strcmp(format, "bin") == 0)
+        return 1;
+    return strcmp(format, "json") == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Computes the validators of a request, before any body is built.
+ *
+ * Sample-derived routes change only when the data version does (a sample or
+ * an error is published), so their strong ETag is that version, tagged with
+ * the run and the negotiated representation. They stay fresh until the next
+ * measurement cycle starts. The dashboard is tagged by its hash and always
+ * revalidated. Routes that depend on the clock (/stats, /history with
+ * relative bounds), on counters (/status, /metrics) or wait for data
+ * (/data?after=) have none.
  *
- * @param cls Unused user-defined pointer.
  * @param connection The MHD connection object.
  * @param url The requested URL.
- * @param method The HTTP method (e.g., "GET").
- * @param version The HTTP version.
- * @param upload_data Data uploaded by the client (unused).
- * @param upload_data_size Size of the uploaded data (unused).
- * @param con_cls Connection-specific pointer (unused).
+ * @param version Data version, read before building the body.
+ * @param gzip Non-zero if the body is gzip-encoded.
+ * @param v Receives the validators.
+ * @return Non-zero if the response has validators.
+ */
+static int get_validators(struct MHD_Connection *connection, const char *url, uint64_t version, int gzip,
+                          struct validators *v)
+{
+    const char *variant = "";
+    struct timespec now;
+    int64_t fresh_ms;
+
+    v->vary = NULL;
+    if (strcmp(url, "/history") == 0)
+    {
+        const char *from = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "from");
+        const char *to = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "to");
+        const char *res = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "resolution");
+
+        if ((from != NULL && *from == '-') || (to != NULL && *to == '-'))
+            return 0; // The range moves with the clock
+        if (from != NULL || to != NULL ||
+            MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "since") != NULL)
+            ; // Identity JSON only
+        else if (MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "points") != NULL)
+        {
+            variant = gzip ? "-gz" : "";
+            v->vary = "Accept-Encoding";
+        }
+        else if (res == NULL || strcmp(res, "raw") == 0)
+        {
+            int binary = history_format(connection);
+            if (binary < 0)
+                return 0; // Answered 400
+            variant = binary ? (gzip ? "-bin-gz" : "-bin") : (gzip ? "-gz" : "");
+            v->vary = "Accept, Accept-Encoding";
+        }
+    }
+    else if ((strcmp(url, "/data") == 0 &&
+              MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "after") != NULL) || // Long poll
+             strcmp(url, "/stats") == 0 || strcmp(url, "/stream") == 0 || strcmp(url, "/ws") == 0 ||
+             strcmp(url, "/status") == 0 || strcmp(url, "/config") == 0 || strcmp(url, "/metrics") == 0)
+        return 0;
+    else if (strcmp(url, "/data") != 0 && strcmp(url, "/archive") != 0) // Dashboard
+    {
+        snprintf(v->etag, sizeof(v->etag), "\"%016llx%s\"", (unsigned long long)html_hash,
+                 gzip && html_gz != NULL ? "-gz" : "");
+        snprintf(v->cache_control, sizeof(v->cache_control), "no-cache");
+        v->vary = "Accept-Encoding";
+        return 1;
+    }
+
+    snprintf(v->etag, sizeof(v->etag), "\"%llx-%llx%s\"", (unsigned long long)etag_run,
+             (unsigned long long)version, variant);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    fresh_ms = get_next_cycle_ms() - timespec_ms(&now);
+    snprintf(v->cache_control, sizeof(v->cache_control), "max-age=%lld",
+             fresh_ms > 0 ? (long long)(fresh_ms / 1000) : 0LL); // Whole seconds, rounded down
+    return 1;
+}
+
+/**
+ * @brief Returns non-zero if an If-None-Match header value matches an ETag.
+ *
+ * Uses the weak comparison required for If-None-Match: W/ prefixes are ignored.
+ *
+ * @param if_none_match Header value, NULL if absent.
+ * @param etag ETag of the current representation, quotes included.
+ */
+static int etag_match(const char *if_none_match, const char *etag)
+{
+    const char *p = if_none_match;
+    size_t n = strlen(etag);
+
+    if (p == NULL)
+        return 0;
+    while (*p != '\0')
+    {
+        while (*p == ' ' || *p == '\t' || *p == ',')
+            p++;
+        if (*p == '*')
+            return 1;
+        if (p[0] == 'W' && p[1] == '/')
+            p += 2;
+        if (strncmp(p, etag, n) == 0 && (p[n] == '\0' || p[n] == ',' || p[n] == ' ' || p[n] == '\t'))
+            return 1;
+        if (*p == '"') // Skip the tag: commas are allowed inside quotes
+            for (p++; *p != '\0' && *p != '"'; p++)
+                ;
+        while (*p != '\0' && *p != ',')
+            p++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Adds the validator and caching headers to a 200 or 304 response.
+ */
+static void add_validators(struct MHD_Response *response, const struct validators *v)
+{
+    MHD_add_response_header(response, "ETag", v->etag);
+    MHD_add_response_header(response, "Cache-Control", v->cache_control);
+    if (v->vary != NULL)
+        MHD_add_response_header(response, "Vary", v->vary);
+}
+
+/**
+ * @brief Routes a request and queues its response.
+ *
+ * @param connection The MHD connection object.
+ * @param url The requested URL.
+ * @param method The HTTP method: only POST or PUT may change /config.
+ * @param upload_data_size Size of the uploaded data, discarded (parameters come from the query string).
+ * @param con_cls Connection-specific pointer (long poll state).
+ * @param queued Receives the status of the queued response; left 0 if none was queued.
  * @return MHD result code.
  */
-int handler(void *cls, struct MHD_Connection *connection,
-            const char *url, const char *method,
-            const char *version, const char *upload_data,
-            size_t *upload_data_size, void **con_cls)
+static int dispatch(struct MHD_Connection *connection, const char *url, const char *method,
+                    size_t *upload_data_size, void **con_cls, unsigned int *queued)
 {
     const char *response_data;
     struct MHD_Response *response;
+    struct arena *arena;      // Per-request arena of dynamic bodies
+    char *json_response;      // Body buffer inside the arena
+    const char *arg;          // Query string argument
+    int gzip = gzip_accepted(MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Accept-Encoding"));
+    uint64_t data_version = get_data_version(); // Read before building the body: never newer than it
+    struct validators v;
+    unsigned int status = MHD_HTTP_OK;
     int ret;
 
-    if (strcmp(url, "/data") == 0) // Handle /data endpoint
+    if (*upload_data_size != 0) // A request body is never used: drop it, answer on the next call
+    {
+        *upload_data_size = 0;
+        return MHD_YES;
+    }
+
+    // Revalidation of an unchanged representation: answer before any serialization
+    if (get_validators(connection, url, data_version, gzip, &v) &&
+        etag_match(MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "If-None-Match"), v.etag))
+    {
+        response = MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+        add_validators(response, &v);
+        ret = MHD_queue_response(connection, MHD_HTTP_NOT_MODIFIED, response);
+        MHD_destroy_response(response);
+        *queued = MHD_HTTP_NOT_MODIFIED;
+        return ret;
+    }
+
+    if (strcmp(url, "/data") == 0 &&
+        (arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "after")) != NULL) // Handle /data?after=
+    {
+        char *end;
+        uint64_t after = strtoull(arg, &end, 10);
+
+        if (*arg < '0' || *arg > '9' || *end != '\0') // Same rule as /history?since=
+        {
+            static const char bad_after[] = "{\"error\": \"after must be a sample sequence number\"}";
+            status = MHD_HTTP_BAD_REQUEST;
+            response = MHD_create_response_from_buffer(sizeof(bad_after) - 1, (void *)bad_after,
+                                                       MHD_RESPMEM_PERSISTENT);
+        }
+        else
+        {
+            ret = longpoll_poll(connection, after, con_cls, &response);
+            if (ret <= 0)
+                return ret == 0 ? MHD_YES : MHD_NO; // Suspended: called again once resumed
+            status = (unsigned int)ret;
+            MHD_add_response_header(response, "Cache-Control", "no-store");
+        }
+        MHD_add_response_header(response, "Content-Type", "application/json");
+    }
+    else if (strcmp(url, "/data") == 0) // Handle /data endpoint
+    {
+        if ((json_response = arena_body(&arena, SMALL_BODY_MAX)) == NULL)
+            return MHD_NO; // Out of memory: drop the connection
+        size_t len = get_latest_sensor_data(json_response, SMALL_BODY_MAX); // Get latest sensor data as a JSON string
+        response = arena_response(arena, json_response, len);                // Create HTTP response
+        MHD_add_response_header(response, "Content-Type", "application/json"); // Set response content type to JSON
+    }
+    else if (strcmp(url, "/history") == 0 &&
+             (MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "from") != NULL ||
+              MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "to") != NULL)) // Handle /history?from=&to=
+    {
+        struct range_query q = { .since = 0, .from_ms = INT64_MIN, .to_ms = INT64_MAX, .ring = 1 };
+        struct timespec now;
+        int64_t now_ms;
+
+        clock_gettime(CLOCK_REALTIME, &now);
+        now_ms = timespec_ms(&now);
+        if (MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "points") != NULL) // Rows are streamed, never held
+        {
+            static const char bad_points[] = "{\"error\": \"points cannot be combined with from and to\"}";
+            status = MHD_HTTP_BAD_REQUEST;
+            response = MHD_create_response_from_buffer(sizeof(bad_points) - 1, (void *)bad_points,
+                                                       MHD_RESPMEM_PERSISTENT);
+        }
+        else if (parse_time_bound(MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "from"), now_ms, &q.from_ms) < 0 ||
+            parse_time_bound(MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "to"), now_ms, &q.to_ms) < 0)
+        {
+            static const char bad_range[] = "{\"error\": \"from and to must be Unix times in ms, or negative ms relative to now\"}";
+            status = MHD_HTTP_BAD_REQUEST;
+            response = MHD_create_response_from_buffer(sizeof(bad_range) - 1, (void *)bad_range,
+                                                       MHD_RESPMEM_PERSISTENT);
+        }
+        else if ((response = range_create_response(&q)) == NULL) // Binary search, then k rows
+            return MHD_NO;
+        MHD_add_response_header(response, "Content-Type", "application/json");
+    }
+    else if (strcmp(url, "/history") == 0 &&
+             (arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "since")) != NULL) // Handle /history?since=
+    {
+        char *end;
+        uint64_t since = strtoull(arg, &end, 10);
+        size_t len;
+
+        if (*arg < '0' || *arg > '9' || *end != '\0') // Reject anything but a decimal sequence number
+        {
+            static const char bad_since[] = "{\"error\": \"since must be a sample sequence number\"}";
+            status = MHD_HTTP_BAD_REQUEST;
+            response = MHD_create_response_from_buffer(sizeof(bad_since) - 1, (void *)bad_since,
+                                                       MHD_RESPMEM_PERSISTENT);
+        }
+        else
+        {
+            if ((arena = arena_create(HISTORY_ARENA_SIZE)) == NULL)
+                return MHD_NO;
+            if ((json_response = build_history_delta(arena, since, &len)) == NULL)
+            {
+                arena_release(arena);
+                return MHD_NO;
+            }
+            response = arena_response(arena, json_response, len);
+        }
+        MHD_add_response_header(response, "Content-Type", "application/json");
+    }
+    else if (strcmp(url, "/history") == 0 &&
+             (arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "points")) != NULL) // Handle /history?points=
     {
-        response_data = get_latest_sensor_data(); // Get latest sensor data as a JSON string
-        response = MHD_create_response_from_buffer(strlen(response_data),
-                                                   (void *)response_data, MHD_RESPMEM_PERSISTENT); // Create HTTP response
-        MHD_add_response_header(response, "Content-Type", "application/json");                     // Set response content type to JSON
+        const char *res = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "resolution");
+        enum lttb_source source = LTTB_RAW;
+        char *end;
+        unsigned long points = strtoul(arg, &end, 10);
+
+        if (res != NULL && strcmp(res, "raw") != 0)
+        {
+            source = LTTB_MINUTE;
+            while (source <= LTTB_HOUR && strcmp(res, tier_names[source - LTTB_MINUTE]) != 0)
+                source++;
+        }
+        if (*arg < '0' || *arg > '9' || *end != '\0' || points < LTTB_POINTS_MIN || source > LTTB_HOUR)
+        {
+            static const char bad_points[] = "{\"error\": \"points must be at least 3, resolution raw, minute or hour\"}";
+            status = MHD_HTTP_BAD_REQUEST;
+            response = MHD_create_response_from_buffer(sizeof(bad_points) - 1, (void *)bad_points,
+                                                       MHD_RESPMEM_PERSISTENT);
+        }
+        else
+        {
+            unsigned len = lttb_source_len(source);
+            uint32_t key;
+            struct cached_body *body;
+
+            if (points > len)
+                points = len; // Same body as the whole series
+            key = LTTB_KEY(source, points);
+            if (gzip && (body = response_cache_get_keyed(&lttb_gz_cache[lttb_slot(key)], get_sample_seq(), key,
+                                                         ARENA_SIZE(GZIP_BOUND(LTTB_JSON_MAX(points))),
+                                                         build_lttb_gz)) == NULL)
+                gzip = 0; // Could not compress: send it as is
+            if (!gzip && (body = lttb_body(key)) == NULL)
+                return MHD_NO;
+            response = MHD_create_response_from_buffer_with_free_callback_cls(body->len, body->data,
+                                                                              cached_body_release, body);
+            if (gzip)
+                MHD_add_response_header(response, "Content-Encoding", "gzip");
+        }
+        MHD_add_response_header(response, "Content-Type", "application/json");
+    }
+    else if (strcmp(url, "/history") == 0 &&
+             (arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "resolution")) != NULL &&
+             strcmp(arg, "raw") != 0) // Handle /history?resolution=minute|hour
+    {
+        static const cache_build_fn builders[HISTORY_TIERS] = { build_minute_json, build_hour_json };
+        static const char bad_tier[] = "{\"error\": \"resolution must be raw, minute or hour\"}";
+        int tier = 0;
+
+        while (tier < HISTORY_TIERS && strcmp(arg, tier_names[tier]) != 0)
+            tier++;
+        if (tier == HISTORY_TIERS)
+        {
+            status = MHD_HTTP_BAD_REQUEST;
+            response = MHD_create_response_from_buffer(sizeof(bad_tier) - 1, (void *)bad_tier,
+                                                       MHD_RESPMEM_PERSISTENT);
+        }
+        else
+        {
+            // Rebuilt at most once per sample, like the raw history
+            struct cached_body *body = response_cache_get(&tier_cache[tier], get_sample_seq(),
+                                                          ROLLUP_ARENA_SIZE(history_tier_len(tier)), builders[tier]);
+            if (body == NULL)
+                return MHD_NO;
+            response = MHD_create_response_from_buffer_with_free_callback_cls(body->len, body->data,
+                                                                              cached_body_release, body);
+        }
+        MHD_add_response_header(response, "Content-Type", "application/json");
     }
     else if (strcmp(url, "/history") == 0) // Handle /history endpoint
     {
-        float temp_history[MAX_HISTORY], hum_history[MAX_HISTORY];
-        get_history(temp_history, hum_history); // Retrieve historical temperature and humidity data
+        int binary = history_format(connection);
+
+        if (binary < 0)
+        {
+            static const char bad_format[] = "{\"error\": \"format must be json or bin\"}";
+            status = MHD_HTTP_BAD_REQUEST;
+            response = MHD_create_response_from_buffer(sizeof(bad_format) - 1, (void *)bad_format,
+                                                       MHD_RESPMEM_PERSISTENT);
+            MHD_add_response_header(response, "Content-Type", "application/json");
+        }
+        else
+        {
+            // Rebuilt (and compressed) at most once per sample and format, shared by all requests until the next one
+            struct cached_body *body = NULL;
 
-        char json_response[8192];                     // Buffer to hold the JSON response
-        strcpy(json_response, "{\"temperature\": ["); // Start JSON response with temperature array
+            if (gzip && (body = binary ? response_cache_get(&history_gz_cache[1], get_sample_seq(),
+                                                            HISTORY_BIN_GZ_ARENA_SIZE, build_history_bin_gz)
+                                       : response_cache_get(&history_gz_cache[0], get_sample_seq(),
+                                                            HISTORY_GZ_ARENA_SIZE, build_history_json_gz)) == NULL)
+                gzip = 0; // Could not compress: send it as is
+            if (!gzip)
+                body = binary ? response_cache_get(&history_bin_cache, get_sample_seq(),
+                                                   HISTORY_BIN_ARENA_SIZE, build_history_bin)
+                              : response_cache_get(&history_cache, get_sample_seq(),
+                                                   HISTORY_ARENA_SIZE, build_history_json);
+            if (body == NULL)
+                return MHD_NO; // Out of memory: drop the connection
 
-        for (int i = 0; i < MAX_HISTORY; i++) // Build temperature JSON array
+            response = MHD_create_response_from_buffer_with_free_callback_cls(body->len, body->data,
+                                                                              cached_body_release, body); // Reference dropped after sending
+            MHD_add_response_header(response, "Content-Type", binary ? "application/octet-stream" : "application/json");
+            if (gzip)
+                MHD_add_response_header(response, "Content-Encoding", "gzip");
+        }
+    }
+    else if (strcmp(url, "/stats") == 0) // Handle /stats endpoint
+    {
+        int64_t window_ms;
+
+        arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "window");
+        if (parse_window(arg, &window_ms) < 0)
+        {
+            static const char bad_window[] = "{\"error\": \"window must be a positive count of s, m, h or d, up to the hour tier\"}";
+            status = MHD_HTTP_BAD_REQUEST;
+            response = MHD_create_response_from_buffer(sizeof(bad_window) - 1, (void *)bad_window,
+                                                       MHD_RESPMEM_PERSISTENT);
+        }
+        else
         {
-            char num[32];
-            snprintf(num, sizeof(num), "%.2f", temp_history[i]); // Format temperature value
-            strcat(json_response, num);                          // Append value to JSON response
-            if (i < MAX_HISTORY - 1)
-                strcat(json_response, ","); // Add comma between values
+            if ((json_response = arena_body(&arena, SMALL_BODY_MAX)) == NULL)
+                return MHD_NO;
+            size_t len = format_window_stats(json_response, window_ms); // Binary search + segment tree query
+            response = arena_response(arena, json_response, len);
         }
-        strcat(json_response, "],\"humidity\": ["); // Start humidity array in JSON response
+        MHD_add_response_header(response, "Content-Type", "application/json");
+    }
+    else if (strcmp(url, "/archive") == 0) // Handle /archive endpoint
+    {
+        char *end = NULL;
+        uint64_t since = 0;
 
-        for (int i = 0; i < MAX_HISTORY; i++) // Build humidity JSON array
+        arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "since");
+        if (arg != NULL)
+            since = strtoull(arg, &end, 10);
+        if (arg != NULL && (*arg < '0' || *arg > '9' || *end != '\0')) // Same rule as /history?since=
         {
-            char num[32];
-            snprintf(num, sizeof(num), "%.2f", hum_history[i]); // Format humidity value
-            strcat(json_response, num);                         // Append value to JSON response
-            if (i < MAX_HISTORY - 1)
-                strcat(json_response, ","); // Add comma between values
+            static const char bad_since[] = "{\"error\": \"since must be a sample sequence number\"}";
+            status = MHD_HTTP_BAD_REQUEST;
+            response = MHD_create_response_from_buffer(sizeof(bad_since) - 1, (void *)bad_since,
+                                                       MHD_RESPMEM_PERSISTENT);
         }
-        strcat(json_response, "]}"); // Close JSON response
+        else
+        {
+            struct range_query q = { .since = since, .from_ms = INT64_MIN, .to_ms = INT64_MAX, .ring = 0 };
+            if ((response = range_create_response(&q)) == NULL) // Decoded block by block while sending
+                return MHD_NO;
+        }
+        MHD_add_response_header(response, "Content-Type", "application/json");
+    }
+    else if (strcmp(url, "/stream") == 0) // Handle /stream endpoint
+    {
+        response = stream_create_response(connection); // Body produced sample by sample
+        if (response == NULL)
+            return MHD_NO;
+        MHD_add_response_header(response, "Content-Type", "text/event-stream");
+        MHD_add_response_header(response, "Cache-Control", "no-cache");
+    }
+    else if (strcmp(url, "/ws") == 0) // Handle /ws endpoint
+    {
+        if (!ws_is_handshake(connection))
+        {
+            static const char bad_ws[] = "{\"error\": \"WebSocket version 13 handshake expected\"}";
+            status = MHD_HTTP_UPGRADE_REQUIRED;
+            response = MHD_create_response_from_buffer(sizeof(bad_ws) - 1, (void *)bad_ws,
+                                                       MHD_RESPMEM_PERSISTENT);
+            MHD_add_response_header(response, "Content-Type", "application/json");
+            MHD_add_response_header(response, "Sec-WebSocket-Version", "13");
+        }
+        else
+        {
+            if ((response = ws_create_response(connection)) == NULL) // Socket handed to the WebSocket thread
+                return MHD_NO;
+            status = MHD_HTTP_SWITCHING_PROTOCOLS;
+        }
+    }
+    else if (strcmp(url, "/status") == 0) // Handle /status endpoint
+    {
+        if ((json_response = arena_body(&arena, STATUS_BODY_MAX)) == NULL)
+            return MHD_NO;
+        size_t len = format_status(json_response, STATUS_BODY_MAX);
+        if (len == 0) // Never send a cut-off document
+        {
+            len = (size_t)snprintf(json_response, STATUS_BODY_MAX, "{\"error\": \"status too large\"}");
+            status = MHD_HTTP_INTERNAL_SERVER_ERROR;
+        }
+        response = arena_response(arena, json_response, len);
+        MHD_add_response_header(response, "Content-Type", "application/json");
+    }
+    else if (strcmp(url, "/metrics") == 0) // Handle /metrics endpoint
+    {
+        // Merged at most once per METRICS_CACHE_MS, shared by the scrapes in between
+        struct cached_body *body = response_cache_get(&metrics_cache, metrics_period(),
+                                                      METRICS_ARENA_SIZE, build_metrics);
+        if (body == NULL)
+            return MHD_NO;
+        response = MHD_create_response_from_buffer_with_free_callback_cls(body->len, body->data,
+                                                                          cached_body_release, body);
+        MHD_add_response_header(response, "Content-Type", "text/plain; version=0.0.4");
+    }
+    else if (strcmp(url, "/config") == 0) // Handle /config endpoint
+    {
+        enum htu21d_resolution res = get_sensor_resolution();
+        int change = strcmp(method, MHD_HTTP_METHOD_POST) == 0 || strcmp(method, MHD_HTTP_METHOD_PUT) == 0;
+
+        arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "resolution");
 
-        response = MHD_create_response_from_buffer(strlen(json_response),
-                                                   (void *)json_response, MHD_RESPMEM_PERSISTENT); // Create HTTP response
-        MHD_add_response_header(response, "Content-Type", "application/json");                     // Set response content type to JSON
+        if ((json_response = arena_body(&arena, SMALL_BODY_MAX)) == NULL)
+            return MHD_NO;
+        if (arg != NULL && !change) // GET stays safe: a prefetch or an <img> must not retune the sensor
+        {
+            status = MHD_HTTP_METHOD_NOT_ALLOWED;
+            snprintf(json_response, SMALL_BODY_MAX,
+                     "{\"error\": \"use POST to change the resolution\"}");
+        }
+        else if (arg != NULL && htu21d_parse_resolution(arg, &res) < 0) // Reject unknown resolutions
+        {
+            status = MHD_HTTP_BAD_REQUEST;
+            snprintf(json_response, SMALL_BODY_MAX,
+                     "{\"error\": \"resolution must be 14, 13, 12 or 11\"}");
+        }
+        else
+        {
+            enum htu21d_resolution current;
+
+            if (arg != NULL)
+                set_sensor_resolution(res); // Applied by the sensor thread before the next cycle
+            current = get_sensor_resolution(); // What the chip is programmed with, not what was asked
+            if (arg != NULL && res != current)
+            {
+                status = MHD_HTTP_ACCEPTED;
+                snprintf(json_response, SMALL_BODY_MAX,
+                         "{\"resolution\": {\"temperature_bits\": %d, \"humidity_bits\": %d}, "
+                         "\"pending\": {\"temperature_bits\": %d, \"humidity_bits\": %d}}",
+                         htu21d_temp_bits(current), htu21d_hum_bits(current),
+                         htu21d_temp_bits(res), htu21d_hum_bits(res));
+            }
+            else
+                snprintf(json_response, SMALL_BODY_MAX,
+                         "{\"resolution\": {\"temperature_bits\": %d, \"humidity_bits\": %d}}",
+                         htu21d_temp_bits(current), htu21d_hum_bits(current));
+        }
+
+        response = arena_response(arena, json_response, strlen(json_response));
+        MHD_add_response_header(response, "Content-Type", "application/json");
+        if (status == MHD_HTTP_METHOD_NOT_ALLOWED)
+            MHD_add_response_header(response, "Allow", "GET, POST, PUT");
     }
     else // Handle unsupported routes
     {
-        response_data = html_page; // Serve default HTML page for unsupported routes
-        response = MHD_create_response_from_buffer(strlen(response_data),
-                                                   (void *)response_data, MHD_RESPMEM_PERSISTENT); // Create HTTP response
-        MHD_add_response_header(response, "Content-Type", "text/html");                            // Set response content type to HTML
+        if (gzip && html_gz != NULL) // Compressed once at startup
+        {
+            response = MHD_create_response_from_buffer(html_gz_len, html_gz, MHD_RESPMEM_PERSISTENT);
+            MHD_add_response_header(response, "Content-Encoding", "gzip");
+        }
+        else
+        {
+            response_data = html_page; // Serve default HTML page for unsupported routes
+            response = MHD_create_response_from_buffer(strlen(response_data),
+                                                       (void *)response_data, MHD_RESPMEM_PERSISTENT); // Create HTTP response
+        }
+        MHD_add_response_header(response, "Content-Type", "text/html"); // Set response content type to HTML
     }
 
-    ret = MHD_queue_response(connection, MHD_HTTP_OK, response); // Send the HTTP response to the client
+    // gzip may have been dropped: tag the representation actually sent
+    if (status == MHD_HTTP_OK && get_validators(connection, url, data_version, gzip, &v))
+        add_validators(response, &v);
+
+    ret = MHD_queue_response(connection, status, response); // Send the HTTP response to the client
     MHD_destroy_response(response);                              // Clean up the response object
+    *queued = status;
     return ret;                                                  // Return the status of the response queuing
 }
 
+/**
+ * @brief HTTP request handler for the server.
+ *
+ * Handles different endpoints ("/data", "/history", "/stats", "/archive", "/stream", "/ws", "/status", "/metrics", "/config", others) and generates appropriate HTTP responses.
+ * Each request that gets a response is counted by route and status class,
+ * with the time spent here (metrics.h).
+ *
+ * @param cls Unused user-defined pointer.
+ * @param connection The MHD connection object.
+ * @param url The requested URL.
+ * @param method The HTTP method (e.g., "GET").
+ * @param version The HTTP version.
+ * @param upload_data Data uploaded by the client (unused).
+ * @param upload_data_size Size of the uploaded data (discarded).
+ * @param con_cls Connection-specific pointer (long poll state).
+ * @return MHD result code.
+ */
+int handler(void *cls, struct MHD_Connection *connection,
+            const char *url, const char *method,
+            const char *version, const char *upload_data,
+            size_t *upload_data_size, void **con_cls)
+{
+    struct timespec begin;
+    unsigned int status = 0; // Stays 0 for a suspended long poll or a dropped connection
+    int ret;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    ret = dispatch(connection, url, method, upload_data_size, con_cls, &status);
+    if (status != 0)
+    {
+        struct timespec end;
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        metrics_request(metrics_route_of(url), status, timespec_diff_ns(&end, &begin));
+    }
+    return ret;
+}
+
+/**
+ * @brief MHD completion callback: releases the long poll state of a request.
+ *
+ * @param cls Unused.
+ * @param connection Unused.
+ * @param con_cls Connection-specific pointer set by the handler.
+ * @param toe Unused.
+ */
+static void request_completed(void *cls, struct MHD_Connection *connection,
+                              void **con_cls, enum MHD_RequestTerminationCode toe)
+{
+    (void)cls;
+    (void)connection;
+    (void)toe;
+    longpoll_release(con_cls);
+}
+
 /**
  * @brief Entry point of the HTTP server application.
  *
- * Initializes the sensor loop and starts the HTTP server daemon
- * using the MHD library. The server runs indefinitely, handling
- * incoming requests on the specified port.
+ * Parses the command line, initializes the sensor loop and starts the
+ * HTTP server daemon using the MHD library. The server runs indefinitely,
+ * handling incoming requests on the specified port.
+ *
+ * Options:
+ * - `-d <path>`: I2C bus device (default I2C_DEV).
+ * - `-s`: Use the in-process simulated sensor instead of the I2C bus.
+ * - `-H`: Use hold master measurements (one combined I2C transaction each).
+ * - `-r <bits>`: Temperature resolution 14, 13, 12 or 11 (RH 12, 10, 8 or 11 bits).
+ * - `-i <ms>`: Sampling period in milliseconds (default SAMPLE_INTERVAL_MS).
+ * - `-f <path>`: Keep the history in a memory-mapped ring file, recovered on restart.
+ * - `-S <samples>`: Samples between msync() of the history file (default
+ *   HISTORY_SYNC_SAMPLES, 0 leaves write-back to the kernel).
+ * - `-a <path>`: Append every sample to a compressed long-term archive file.
+ * - `-b <samples>`: Run the acquisition and codec benchmarks and exit.
+ * - `-c`: Run the self-checks and exit (status 1 if one fails).
+ * - `-p <port>`: TCP port to listen on (default PORT).
  *
- * @return Returns 0 on successful execution, or 1 if the server
- *         daemon fails to start.
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @return Returns 0 on successful execution, 1 if the server
+ *         daemon or the stream notifier fails to start or a self-check fails,
+ *         or 2 on invalid arguments.
  */
-int main(void)
+int main(int argc, char **argv)
 {
-    start_sensor_loop(); // Start the sensor data acquisition loop in a separate thread or process
+    struct sensor_config cfg = { .i2c_dev = I2C_DEV, .simulate = 0, .hold = 0,
+                                 .resolution = HTU21D_RES_RH12_T14, .interval_ms = SAMPLE_INTERVAL_MS,
+                                 .history_file = NULL, .sync_every = HISTORY_SYNC_SAMPLES,
+                                 .archive_file = NULL };
+    int bench_samples = 0;
+    int check = 0;
+    long port = PORT;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:sHr:i:f:S:a:b:cp:")) != -1) // Parse command line options
+    {
+        switch (opt)
+        {
+        case 'd':
+            cfg.i2c_dev = optarg;
+            break;
+        case 's':
+            cfg.simulate = 1;
+            break;
+        case 'H':
+            cfg.hold = 1;
+            break;
+        case 'r':
+            if (htu21d_parse_resolution(optarg, &cfg.resolution) < 0)
+            {
+                fprintf(stderr, "Invalid resolution '%s' (use 14, 13, 12 or 11)\n", optarg);
+                return 2;
+            }
+            break;
+        case 'i':
+            cfg.interval_ms = atol(optarg);
+            if (cfg.interval_ms < SAMPLE_INTERVAL_MIN_MS || cfg.interval_ms > SAMPLE_INTERVAL_MAX_MS)
+            {
+                fprintf(stderr, "Sampling period must be %d..%d ms\n",
+                        SAMPLE_INTERVAL_MIN_MS, SAMPLE_INTERVAL_MAX_MS);
+                return 2;
+            }
+            break;
+        case 'f':
+            cfg.history_file = optarg;
+            break;
+        case 'S':
+            cfg.sync_every = atol(optarg);
+            if (cfg.sync_every < 0)
+            {
+                fprintf(stderr, "History sync interval must be >= 0 samples\n");
+                return 2;
+            }
+            break;
+        case 'a':
+            cfg.archive_file = optarg;
+            break;
+        case 'c':
+            check = 1;
+            break;
+        case 'p':
+            port = atol(optarg);
+            if (port < 1 || port > 65535)
+            {
+                fprintf(stderr, "Port must be 1..65535\n");
+                return 2;
+            }
+            break;
+        case 'b':
+            bench_samples = atoi(optarg);
+            if (bench_samples > 0)
+                break;
+            /* fall through */
+        default:
+            fprintf(stderr, "Usage: %s [-d i2c-device] [-s] [-H] [-r bits] [-i ms] [-f history-file] [-S samples] [-a archive-file] [-b samples] [-c] [-p port]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (check) // Check mode: verify the kernels, recovery and metrics, then exit
+        return sensor_check();
+    if (bench_samples > 0) // Benchmark mode: measure acquisition cost and exit
+        return sensor_benchmark(&cfg, bench_samples);
+
+    if (waitlist_start() < 0) // Resumes suspended stream and long poll connections
+        return 1;
+    add_sample_listener(waitlist_notify, NULL);
+    if (ws_start() < 0) // Pushes samples to WebSocket clients
+        return 1;
+    add_sample_listener(ws_notify, NULL);
+
+    start_sensor_loop(&cfg); // Start the sensor data acquisition loop in a separate thread
+    prepare_dashboard();
+    etag_run = (uint64_t)time(NULL);
 
-    // Start the HTTP server daemon on the specified port
-    struct MHD_Daemon *daemon = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD,
-                                                 PORT, NULL, NULL,
-                                                 &handler, NULL, MHD_OPTION_END);
+    // Start the HTTP server daemon on the specified port; streams and long polls suspend idle connections,
+    // /ws takes over its socket
+    struct MHD_Daemon *daemon = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD | MHD_ALLOW_SUSPEND_RESUME |
+                                                 MHD_ALLOW_UPGRADE,
+                                                 (uint16_t)port, NULL, NULL,
+                                                 &handler, NULL,
+                                                 MHD_OPTION_NOTIFY_COMPLETED, &request_completed, NULL,
+                                                 MHD_OPTION_END);
     if (NULL == daemon) // Check if the server failed to start
         return 1;
 
-    printf("HTTP server started on port %d\n", PORT); // Log that the server has started successfully
+    printf("HTTP server started on port %ld\n", port); // Log that the server has started successfully
 
     while (1)
     {
@@ -22,8 +22,47 @@
 #include <time.h>
 
 #include "sensor_reader.h" // Custom header for reading sensor data
+#include "sensor_bench.h"  // Acquisition benchmark (-b)
+#include "arena.h"          // Per-response bump allocator
+#include "response_cache.h" // Versioned, shared response bodies
+#include "json_writer.h"    // Cursor-based JSON number formatting
+#include "sample_codec.h"   // Lookup-table decoding of the history codes
+#include "waitlist.h"       // Suspended connections woken by new samples
+#include "stream.h"         // Server-Sent Events sample stream
+#include "longpoll.h"       // Long-poll for the next sample
+#include "websocket.h"      // WebSocket binary sample push
+#include "archive.h"        // Compressed long-term sample archive
+#include "range_stream.h"   // Streamed sample ranges from the archive and ring
+#include "lttb.h"           // Largest-Triangle-Three-Buckets downsampling
+#include "history_bin.h"    // Binary columnar /history
+#include "gzip.h"           // gzip Content-Encoding
+#include "metrics.h"        // Prometheus /metrics counters and histograms
 
 #define PORT 80 // Port number for the HTTP server
+#define HISTORY_JSON_MAX (128 + MAX_HISTORY * (2 * (JSON_CENTI_MAX + 1) + JSON_U64_MAX + 1)) // Upper bound of the serialized /history body
+#define HISTORY_ARENA_SIZE (2 * ARENA_SIZE(MAX_HISTORY * sizeof(uint16_t)) + ARENA_SIZE(MAX_HISTORY * sizeof(int64_t)) + \
+                            ARENA_SIZE(HISTORY_JSON_MAX)) // /history scratch + body
+#define HISTORY_BIN_ARENA_SIZE (2 * ARENA_SIZE(MAX_HISTORY * sizeof(uint16_t)) + ARENA_SIZE(MAX_HISTORY * sizeof(int64_t)) + \
+                                ARENA_SIZE(HISTORY_BIN_SIZE(MAX_HISTORY))) // Binary /history scratch + body
+#define HISTORY_GZ_ARENA_SIZE ARENA_SIZE(GZIP_BOUND(HISTORY_JSON_MAX))                  // gzipped /history body
+#define HISTORY_BIN_GZ_ARENA_SIZE ARENA_SIZE(GZIP_BOUND(HISTORY_BIN_SIZE(MAX_HISTORY))) // gzipped binary /history body
+#define ROLLUP_JSON_MAX(n) (256 + (n) * (JSON_U64_MAX + 1 + 6 * (JSON_CENTI_MAX + 1))) // Upper bound of a tier body
+#define ROLLUP_ARENA_SIZE(n) (ARENA_SIZE((n) * sizeof(struct rollup_bucket)) + ARENA_SIZE(ROLLUP_JSON_MAX(n))) // Tier scratch + body
+#define LTTB_CACHE_SLOTS 4 // Downsampled bodies kept, keyed by (series, points)
+#define LTTB_SOURCE_MAX ROLLUP_HOUR_BUCKETS // Longest series downsampled (the hour tier)
+#define LTTB_JSON_MAX(p) (256 + 2 * (p) * (JSON_U64_MAX + JSON_CENTI_MAX + 2)) // Upper bound of a downsampled body
+#define LTTB_ARENA_SIZE(n, p) (ARENA_SIZE((n) * sizeof(struct rollup_bucket)) /* also fits the raw ring copy */ + \
+                               ARENA_SIZE((n) * sizeof(int64_t)) + 2 * ARENA_SIZE((n) * sizeof(int32_t)) + \
+                               ARENA_SIZE((p) * sizeof(uint32_t)) + ARENA_SIZE(LTTB_JSON_MAX(p))) // Series + indices + body
+#define METRICS_ARENA_SIZE ARENA_SIZE(METRICS_BODY_MAX) // /metrics body
+#define SMALL_BODY_MAX 1024 // Arena size of the /data, /stats and /config bodies
+#define STATUS_NUMBERS (27 + 2 * JITTER_BUCKETS + 1) // Numbers in the /status body, jitter bounds and counts included
+#define STATUS_BODY_MAX (1024 + STATUS_NUMBERS * JSON_U64_MAX) // Keys and punctuation + every counter at full width
+#define STATS_WINDOW_DEFAULT_S 300 // /stats window without ?window=
+#define ETAG_MAX 48 // Longest ETag, quotes included
+
+#define HTML_STR(x) #x
+#define HTML_NUM(x) HTML_STR(x) // Expands a numeric macro into the page source
 
 // HTML content served by the HTTP server
 static const char *html_page =
@@ -56,21 +95,78 @@ static const char *html_page =
 "    <canvas id='humidityChart' width='800' height='300'></canvas>" // Humidity chart
 "  </div>"
 "  <script>"
+"    const HISTORY = " HTML_NUM(MAX_HISTORY) ";" // Points per chart: the server's history length
 "    let tempChart, humidityChart;"
-"    function fetchData() {" // Fetch current sensor data
-"      fetch('/data').then(r => r.json()).then(d => {"
-"        document.getElementById('data').innerText = "
-"          `Temperature: ${d.temperature} °C\\nHumidity: ${d.humidity} %`;"
+"    let lastSeq = 0;" // Sequence number of the newest charted sample
+"    let syncing = false;" // A /history?since= request is in flight
+"    let windowMs = 0;" // Time span of a full history (0: not full yet, trim by count)
+"    function showData(d) {" // Display the latest sample
+"      document.getElementById('data').innerText = "
+"        `Temperature: ${d.temperature} °C\\nHumidity: ${d.humidity} %`;"
+"    }"
+"    function points(time, values) {" // Chart points at the sample times, skipping empty slots
+"      return values.map((v, i) => ({ x: time[i], y: v })).filter(pt => pt.x > 0);"
+"    }"
+"    function appendSample(chart, point) {" // Scroll one sample into a chart
+"      const data = chart.data.datasets[0].data;"
+"      data.push(point);"
+"      while (data.length > 1 && (data.length > HISTORY || (windowMs > 0 && data[0].x < point.x - windowMs))) data.shift();"
+"    }"
+"    function appendSamples(time, temperature, humidity, seq) {" // Append new samples, then redraw once
+"      points(time, temperature).forEach(pt => appendSample(tempChart, pt));"
+"      points(time, humidity).forEach(pt => appendSample(humidityChart, pt));"
+"      tempChart.update();"
+"      humidityChart.update();"
+"      lastSeq = seq;"
+"    }"
+"    function fetchSince() {" // Fetch only the samples missed since lastSeq
+"      return fetch('/history?since=' + lastSeq).then(r => r.json()).then(d => {"
+"        if (d.resync) return fetchHistory();" // Too far behind: reload everything
+"        if (d.since != lastSeq || d.temperature.length == 0) return;"
+"        appendSamples(d.time, d.temperature, d.humidity, d.seq);"
+"        showData({ temperature: d.temperature.at(-1), humidity: d.humidity.at(-1) });"
 "      });"
 "    }"
-"    function fetchHistory() {" // Fetch historical data for charts
-"      fetch('/history').then(r => r.json()).then(d => {"
+"    function startStream() {" // New samples are pushed by the server (Server-Sent Events)
+"      const source = new EventSource('/stream');"
+"      source.onmessage = e => {"
+"        const d = JSON.parse(e.data);"
+"        if (syncing || d.seq <= lastSeq) return;" // Already charted, or being fetched
+"        if (d.seq > lastSeq + 1) {" // Gap: fill it from the history
+"          syncing = true;"
+"          fetchSince().finally(() => { syncing = false; });"
+"          return;"
+"        }"
+"        showData(d);"
+"        appendSamples([d.time], [d.temperature], [d.humidity], d.seq);"
+"      };"
+"    }"
+"    function decodeHistory(buf) {" // Binary /history (history_bin.h): header, then columns
+"      const v = new DataView(buf), n = v.getUint16(6, true);"
+"      const base = v.getUint32(16, true) + v.getUint32(20, true) * 4294967296;"
+"      const t = new Uint32Array(buf, 24, n);" // Typed arrays read host order: little-endian in practice
+"      const temperature = new Int16Array(buf, 24 + 4 * n, n), humidity = new Int16Array(buf, 24 + 6 * n, n);"
+"      const time = Array.from(t, x => x == 0xFFFFFFFF ? 0 : base + x);"
+"      return { seq: v.getUint32(8, true) + v.getUint32(12, true) * 4294967296,"
+"               temperature: { time, value: Array.from(temperature, x => x / 100) },"
+"               humidity: { time, value: Array.from(humidity, x => x / 100) } };"
+"    }"
+"    function fetchHistory() {" // Fetch the history downsampled to one point per canvas pixel
+"      const width = Math.max(3, Math.round(tempChart.canvas.clientWidth));"
+"      const request = width >= HISTORY" // Nothing to drop: the whole ring, in binary
+"        ? fetch('/history?format=bin').then(r => r.arrayBuffer()).then(decodeHistory)"
+"        : fetch('/history?points=' + width).then(r => r.json());"
+"      return request.then(d => {"
 "        updateCharts(d.temperature, d.humidity);"
+"        const time = d.temperature.time;"
+"        windowMs = d.seq >= HISTORY && time.length > 1 ? time.at(-1) - time[0] : 0;"
+"        showData({ temperature: d.temperature.value.at(-1), humidity: d.humidity.value.at(-1) });"
+"        lastSeq = d.seq;"
 "      });"
 "    }"
 "    function updateCharts(temperature, humidity) {" // Update chart data
-"      tempChart.data.datasets[0].data = temperature;"
-"      humidityChart.data.datasets[0].data = humidity;"
+"      tempChart.data.datasets[0].data = points(temperature.time, temperature.value);"
+"      humidityChart.data.datasets[0].data = points(humidity.time, humidity.value);"
 "      tempChart.update();"
 "      humidityChart.update();"
 "    }"
@@ -78,14 +174,13 @@ static const char *html_page =
 "      const now = new Date();"
 "      document.getElementById('time').innerText = now.toLocaleTimeString();"
 "    }"
+"    const timeAxis = { type: 'linear', ticks: { maxTicksLimit: 8, callback: v => new Date(v).toLocaleTimeString() } };" // X-axis: sample times
 "    function initCharts() {" // Initialize the charts
-"      const labels = Array.from({length: 300}, (_, i) => i + 1);" // X-axis labels
 "      const ctx1 = document.getElementById('tempChart').getContext('2d');"
 "      const ctx2 = document.getElementById('humidityChart').getContext('2d');"
 "      tempChart = new Chart(ctx1, {"
 "        type: 'line',"
 "        data: {"
-"          labels: labels,"
 "          datasets: [{"
 "            label: 'Temperature (°C)',"
 "            borderColor: 'red',"
@@ -97,14 +192,13 @@ static const char *html_page =
 "          }]"
 "        },"
 "        options: {"
-"          scales: { x: { type: 'linear', min: 0, max: 300, ticks: { stepSize: 5 } }, y: { beginAtZero: true, min: 0, max: 40  } },"
+"          scales: { x: timeAxis, y: { beginAtZero: true, min: 0, max: 40  } },"
 "          animation: false"
 "        }"
 "      });"
 "      humidityChart = new Chart(ctx2, {"
 "        type: 'line',"
 "        data: {"
-"          labels: labels,"
 "          datasets: [{"
 "            label: 'Humidity (%)',"
 "            borderColor: 'blue',"
@@ -116,14 +210,13 @@ static const char *html_page =
 "          }]"
 "        },"
 "        options: {"
-"          scales: { x: { type: 'linear', min: 0, max: 300, ticks: { stepSize: 5 } }, y: { beginAtZero: true, min: 0, max: 100 } },"
+"          scales: { x: timeAxis, y: { beginAtZero: true, min: 0, max: 100 } },"
 "          animation: false"
 "        }"
 "      });"
 "    }"
 "    initCharts();" // Initialize charts on page load
-"    setInterval(fetchData, 1000);" // Fetch data every second
-"    setInterval(fetchHistory, 1000);" // Fetch history every second
+"    fetchHistory().then(startStream);" // Load the history, then follow the sample stream
 "    setInterval(updateTime, 1000);" // Update time every second
 "  </script>"
 "</body>"
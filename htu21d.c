@@ -0,0 +1,336 @@
+/**
+ * @file htu21d.c
+ * @brief Non-blocking HTU21D acquisition state machine.
+ *
+ * Each call issues at most one I2C transaction and never sleeps in user space,
+ * so a single thread can drive the sensor from an event loop and do other work
+ * while the chip converts. See htu21d.h for the state diagram and hold mode.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "htu21d.h"
+
+/**
+ * @brief Binds the state machine to a transport.
+ *
+ * @param dev State machine to initialize.
+ * @param bus Transport to the chip.
+ * @param mode Hold or no-hold master measurements.
+ */
+void htu21d_init(struct htu21d *dev, struct i2c_transport *bus, enum htu21d_mode mode) {
+    dev->bus = bus;
+    dev->mode = mode;
+    dev->res = HTU21D_RES_RH12_T14; // Power-on default until htu21d_set_resolution()
+    dev->state = HTU21D_IDLE;
+    dev->deadline.tv_sec = 0;
+    dev->deadline.tv_nsec = 0;
+    dev->give_up = dev->deadline;
+    dev->raw_temp = 0;
+    dev->raw_hum = 0;
+    dev->polls = 0;
+    dev->retries = 0;
+    dev->latched = 0;
+    memset(&dev->stats, 0, sizeof(dev->stats));
+}
+
+/* CRC-8 lookup table, generated by the preprocessor at compile time. One step
+ * shifts in a zero bit and folds the polynomial back in when the MSB falls out. */
+#define CRC8_STEP(c) ((((c) << 1) ^ (((c) >> 7) * 0x31)) & 0xFF)
+#define CRC8_BYTE(b) CRC8_STEP(CRC8_STEP(CRC8_STEP(CRC8_STEP( \
+                     CRC8_STEP(CRC8_STEP(CRC8_STEP(CRC8_STEP(b))))))))
+#define CRC8_R4(n)   CRC8_BYTE(n), CRC8_BYTE((n) + 1), CRC8_BYTE((n) + 2), CRC8_BYTE((n) + 3)
+#define CRC8_R16(n)  CRC8_R4(n), CRC8_R4((n) + 4), CRC8_R4((n) + 8), CRC8_R4((n) + 12)
+#define CRC8_R64(n)  CRC8_R16(n), CRC8_R16((n) + 16), CRC8_R16((n) + 32), CRC8_R16((n) + 48)
+
+static const uint8_t crc8_table[256] = {
+    CRC8_R64(0), CRC8_R64(64), CRC8_R64(128), CRC8_R64(192)
+};
+
+/**
+ * @brief Computes the HTU21D CRC-8 (polynomial 0x131, init 0).
+ *
+ * @param data Bytes to check (MSB first, as sent by the chip).
+ * @param len Number of bytes.
+ * @return CRC of the data; appending it to the data yields a CRC of 0.
+ */
+uint8_t htu21d_crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++)
+        crc = crc8_table[crc ^ data[i]];
+    return crc;
+}
+
+// Command set and datasheet timing of one conversion
+struct htu21d_conv {
+    uint8_t cmd;      // No-hold command
+    uint8_t hold_cmd; // Hold master command
+    long typ_ns;      // Typical conversion time
+    long max_ns;      // Maximum conversion time
+};
+
+// Conversion timings per resolution (datasheet, ns)
+struct htu21d_timing {
+    enum htu21d_resolution res;
+    int temp_bits, hum_bits;
+    struct htu21d_conv temp, hum;
+};
+
+static const struct htu21d_timing timings[] = {
+    { HTU21D_RES_RH12_T14, 14, 12,
+      { HTU21D_CMD_TEMP_NOHOLD, HTU21D_CMD_TEMP_HOLD, 44000000L, 50000000L },
+      { HTU21D_CMD_HUM_NOHOLD, HTU21D_CMD_HUM_HOLD, 14000000L, 16000000L } },
+    { HTU21D_RES_RH10_T13, 13, 10,
+      { HTU21D_CMD_TEMP_NOHOLD, HTU21D_CMD_TEMP_HOLD, 22000000L, 25000000L },
+      { HTU21D_CMD_HUM_NOHOLD, HTU21D_CMD_HUM_HOLD, 4000000L, 5000000L } },
+    { HTU21D_RES_RH8_T12, 12, 8,
+      { HTU21D_CMD_TEMP_NOHOLD, HTU21D_CMD_TEMP_HOLD, 11000000L, 13000000L },
+      { HTU21D_CMD_HUM_NOHOLD, HTU21D_CMD_HUM_HOLD, 2000000L, 3000000L } },
+    { HTU21D_RES_RH11_T11, 11, 11,
+      { HTU21D_CMD_TEMP_NOHOLD, HTU21D_CMD_TEMP_HOLD, 6000000L, 7000000L },
+      { HTU21D_CMD_HUM_NOHOLD, HTU21D_CMD_HUM_HOLD, 7000000L, 8000000L } },
+};
+
+/**
+ * @brief Looks up the timing entry of a resolution (defaults to RH12/T14).
+ */
+static const struct htu21d_timing *htu21d_timing(enum htu21d_resolution res) {
+    for (size_t i = 0; i < sizeof(timings) / sizeof(timings[0]); i++)
+        if (timings[i].res == res)
+            return &timings[i];
+    return &timings[0];
+}
+
+/**
+ * @brief Starts a conversion and schedules the next step.
+ *
+ * In no-hold mode this only sends the command and schedules the first read at
+ * the typical conversion time. In hold mode the command and the readback are one
+ * combined transaction; the frame is latched and the next step is due at once.
+ *
+ * @return 0 on success, -1 on bus error (errno set).
+ */
+static int htu21d_trigger(struct htu21d *dev, const struct htu21d_conv *conv,
+                          const struct timespec *now) {
+    dev->polls = 0;
+    dev->latched = 0;
+
+    if (dev->mode == HTU21D_HOLD) {
+        if (i2c_transfer(dev->bus, &conv->hold_cmd, 1, dev->frame, sizeof(dev->frame)) < 0) {
+            dev->stats.bus_errors++;
+            return -1;
+        }
+        dev->latched = 1;
+        dev->deadline = *now;
+        dev->give_up = *now;
+        return 0;
+    }
+
+    if (i2c_write(dev->bus, &conv->cmd, 1) < 0) {
+        dev->stats.bus_errors++;
+        return -1;
+    }
+
+    dev->deadline = *now;
+    timespec_add_ns(&dev->deadline, conv->typ_ns);
+    dev->give_up = *now;
+    timespec_add_ns(&dev->give_up, conv->max_ns + HTU21D_POLL_SLACK_NS);
+    return 0;
+}
+
+/**
+ * @brief Tries to fetch and validate a finished conversion.
+ *
+ * A frame failing the CRC check is never handed out: the same conversion is
+ * started again, at most HTU21D_CRC_RETRIES times, before giving up.
+ *
+ * @param dev State machine.
+ * @param conv Conversion being fetched (used for retries).
+ * @param raw Where to store the 16-bit code with status bits masked.
+ * @param now Current CLOCK_MONOTONIC time.
+ * @return HTU21D_DONE when valid data was read, HTU21D_BUSY when the caller
+ *         should come back at dev->deadline, -1 on error (errno set).
+ */
+static int htu21d_fetch(struct htu21d *dev, const struct htu21d_conv *conv, uint16_t *raw,
+                        const struct timespec *now) {
+    if (!dev->latched && i2c_read(dev->bus, dev->frame, sizeof(dev->frame)) < 0) {
+        if (!I2C_IS_NACK(errno)) {
+            dev->stats.bus_errors++;
+            return -1;
+        }
+        if (timespec_cmp(now, &dev->give_up) >= 0) { // Should have finished long ago
+            dev->stats.timeouts++;
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        dev->stats.nacks++;
+        dev->polls++;
+        dev->deadline = *now;
+        timespec_add_ns(&dev->deadline, HTU21D_POLL_NS);
+        return HTU21D_BUSY;
+    }
+    dev->latched = 0;
+
+    if (htu21d_crc8(dev->frame, sizeof(dev->frame)) != 0) { // CRC over MSB, LSB, CRC is 0 when intact
+        dev->stats.crc_errors++;
+        if (dev->retries >= HTU21D_CRC_RETRIES) {
+            errno = EBADMSG;
+            return -1;
+        }
+        dev->retries++;
+        dev->stats.crc_retries++;
+        return htu21d_trigger(dev, conv, now) < 0 ? -1 : HTU21D_BUSY;
+    }
+
+    *raw = (uint16_t)(((dev->frame[0] << 8) | dev->frame[1]) & 0xFFFC); // Mask the status bits
+    return HTU21D_DONE;
+}
+
+/**
+ * @brief Starts a measurement cycle with the temperature conversion.
+ *
+ * @param dev State machine (IDLE or READY).
+ * @param now Current CLOCK_MONOTONIC time.
+ * @return 0 on success, -1 on bus error (errno set).
+ */
+int htu21d_start(struct htu21d *dev, const struct timespec *now) {
+    if (dev->state == HTU21D_T_CONVERTING || dev->state == HTU21D_RH_CONVERTING) {
+        errno = EBUSY;
+        return -1;
+    }
+    dev->retries = 0;
+    if (htu21d_trigger(dev, &htu21d_timing(dev->res)->temp, now) < 0) {
+        dev->state = HTU21D_IDLE;
+        return -1;
+    }
+    dev->state = HTU21D_T_CONVERTING;
+    return 0;
+}
+
+/**
+ * @brief Advances the state machine once dev->deadline has passed.
+ *
+ * @param dev State machine.
+ * @param now Current CLOCK_MONOTONIC time.
+ * @return HTU21D_DONE when both values are ready, HTU21D_BUSY when the caller
+ *         should come back at dev->deadline, -1 on error (errno set, state IDLE).
+ */
+int htu21d_step(struct htu21d *dev, const struct timespec *now) {
+    int ret;
+
+    switch (dev->state) {
+    case HTU21D_T_CONVERTING:
+        ret = htu21d_fetch(dev, &htu21d_timing(dev->res)->temp, &dev->raw_temp, now);
+        if (ret != HTU21D_DONE)
+            break;
+        dev->retries = 0;
+        if (htu21d_trigger(dev, &htu21d_timing(dev->res)->hum, now) < 0) {
+            ret = -1;
+            break;
+        }
+        dev->state = HTU21D_RH_CONVERTING;
+        return HTU21D_BUSY;
+
+    case HTU21D_RH_CONVERTING:
+        ret = htu21d_fetch(dev, &htu21d_timing(dev->res)->hum, &dev->raw_hum, now);
+        if (ret != HTU21D_DONE)
+            break;
+        dev->state = HTU21D_READY;
+        return HTU21D_DONE;
+
+    case HTU21D_READY:
+        return HTU21D_DONE;
+
+    default:
+        errno = EINVAL; // Nothing started
+        return -1;
+    }
+
+    if (ret < 0)
+        dev->state = HTU21D_IDLE;
+    return ret;
+}
+
+/**
+ * @brief Drops any measurement in progress.
+ *
+ * The chip finishes the running conversion on its own; the result is simply
+ * never read and is discarded by the next command.
+ */
+void htu21d_abort(struct htu21d *dev) {
+    dev->state = HTU21D_IDLE;
+    dev->polls = 0;
+    dev->latched = 0;
+}
+
+/**
+ * @brief Programs the measurement resolution.
+ *
+ * Read-modify-writes the user register so the reserved, heater and OTP bits are
+ * preserved. Conversion deadlines follow the new resolution from the next cycle.
+ *
+ * @param dev State machine (IDLE or READY).
+ * @param res Resolution to program.
+ * @return 0 on success, -1 on error (errno set).
+ */
+int htu21d_set_resolution(struct htu21d *dev, enum htu21d_resolution res) {
+    uint8_t cmd = HTU21D_CMD_READ_USER;
+    uint8_t reg;
+    uint8_t wr[2];
+
+    if (dev->state == HTU21D_T_CONVERTING || dev->state == HTU21D_RH_CONVERTING) {
+        errno = EBUSY;
+        return -1;
+    }
+    if (i2c_transfer(dev->bus, &cmd, 1, &reg, 1) < 0) {
+        dev->stats.bus_errors++;
+        return -1;
+    }
+
+    wr[0] = HTU21D_CMD_WRITE_USER;
+    wr[1] = (uint8_t)((reg & ~HTU21D_USER_RES_MASK) | res);
+    if (i2c_write(dev->bus, wr, sizeof(wr)) < 0) {
+        dev->stats.bus_errors++;
+        return -1;
+    }
+
+    dev->res = res;
+    return 0;
+}
+
+/**
+ * @brief Parses a resolution given by its temperature bit count.
+ *
+ * @param str "14" (RH12/T14), "13" (RH10/T13), "12" (RH8/T12) or "11" (RH11/T11).
+ * @param res Where to store the resolution.
+ * @return 0 on success, -1 if the string is not a supported resolution.
+ */
+int htu21d_parse_resolution(const char *str, enum htu21d_resolution *res) {
+    char *end;
+    long bits = strtol(str, &end, 10);
+
+    if (end == str || *end != '\0')
+        return -1;
+    for (size_t i = 0; i < sizeof(timings) / sizeof(timings[0]); i++) {
+        if (timings[i].temp_bits == bits) {
+            *res = timings[i].res;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Returns the temperature resolution in bits.
+ */
+int htu21d_temp_bits(enum htu21d_resolution res) {
+    return htu21d_timing(res)->temp_bits;
+}
+
+/**
+ * @brief Returns the humidity resolution in bits.
+ */
+int htu21d_hum_bits(enum htu21d_resolution res) {
+    return htu21d_timing(res)->hum_bits;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file htu21d.h
+ * @brief Non-blocking HTU21D acquisition state machine.
+ *
+ * A measurement cycle walks IDLE -> T_CONVERTING -> RH_CONVERTING -> READY.
+ * Nothing in here sleeps: every call performs at most one bus transaction and
+ * records in `deadline` when the caller should come back (typically by arming a
+ * timerfd). While a conversion is running the chip NACKs reads, so the first
+ * read is attempted at the datasheet's typical conversion time and repeated every
+ * HTU21D_POLL_NS until the datasheet maximum has passed.
+ *
+ * In HTU21D_HOLD mode each conversion is a single combined write/read transaction
+ * (hold master command, the chip stretches SCL until done). That is the cheapest
+ * option in syscalls but blocks the calling thread inside the kernel for the whole
+ * conversion; note that the BCM2835 I2C controller on older Pis mishandles clock
+ * stretching, so no-hold polling remains the default.
+ */
+
+#ifndef HTU21D_H
+#define HTU21D_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "i2c_transport.h"
+#include "time_util.h"
+
+#define HTU21D_CMD_TEMP_NOHOLD 0xF3 // Trigger temperature measurement, no hold master
+#define HTU21D_CMD_HUM_NOHOLD 0xF5  // Trigger humidity measurement, no hold master
+#define HTU21D_CMD_TEMP_HOLD 0xE3   // Trigger temperature measurement, hold master
+#define HTU21D_CMD_HUM_HOLD 0xE5    // Trigger humidity measurement, hold master
+#define HTU21D_CMD_WRITE_USER 0xE6  // Write user register
+#define HTU21D_CMD_READ_USER 0xE7   // Read user register
+#define HTU21D_CMD_SOFT_RESET 0xFE  // Soft reset
+
+#define HTU21D_USER_RES_MASK 0x81   // Resolution bits (7 and 0) of the user register
+
+#define HTU21D_POLL_NS 1000000L     // Retry interval while the chip NACKs
+#define HTU21D_POLL_SLACK_NS 5000000L // Tolerance past the datasheet maximum
+#define HTU21D_CRC_RETRIES 2          // Immediate re-measurements after a CRC mismatch
+
+// Measurement resolution, encoded as the user register bits 7 and 0
+enum htu21d_resolution {
+    HTU21D_RES_RH12_T14 = 0x00, // Power-on default
+    HTU21D_RES_RH8_T12 = 0x01,
+    HTU21D_RES_RH10_T13 = 0x80,
+    HTU21D_RES_RH11_T11 = 0x81,
+};
+
+enum htu21d_state {
+    HTU21D_IDLE,          // No measurement in progress
+    HTU21D_T_CONVERTING,  // Temperature conversion running
+    HTU21D_RH_CONVERTING, // Humidity conversion running
+    HTU21D_READY,         // Both raw values available
+};
+
+enum htu21d_mode {
+    HTU21D_NO_HOLD, // Trigger, then poll with reads until the chip ACKs
+    HTU21D_HOLD,    // One combined transaction, clock stretched by the chip
+};
+
+// Return values of htu21d_step()
+#define HTU21D_BUSY 0  // Come back at dev->deadline
+#define HTU21D_DONE 1  // dev->raw_temp and dev->raw_hum are valid
+
+// Error counters, only ever incremented by the owning thread
+struct htu21d_stats {
+    unsigned long crc_errors;  // Frames rejected by the CRC check
+    unsigned long crc_retries; // Conversions repeated because of a CRC mismatch
+    unsigned long nacks;       // Reads NACKed while the chip was converting
+    unsigned long timeouts;    // Conversions that never completed
+    unsigned long bus_errors;  // Other transport failures
+};
+
+struct htu21d {
+    struct i2c_transport *bus;  // Transport to the chip
+    enum htu21d_mode mode;      // Hold or no-hold master measurements
+    enum htu21d_resolution res; // Resolution programmed into the chip
+    enum htu21d_state state;    // Current acquisition state
+    struct timespec deadline;   // Next time htu21d_step() should run (CLOCK_MONOTONIC)
+    struct timespec give_up;    // Latest acceptable completion of the current conversion
+    uint16_t raw_temp;          // Last temperature code, status bits masked
+    uint16_t raw_hum;           // Last humidity code, status bits masked
+    unsigned polls;             // NACKed reads in the current conversion
+    unsigned retries;           // CRC retries used by the current conversion
+    struct htu21d_stats stats;  // Error counters
+    int latched;                // Hold mode: frame already read with the command
+    uint8_t frame[3];           // Last frame read: MSB, LSB (with status bits), CRC
+};
+
+// Binds the state machine to a transport
+void htu21d_init(struct htu21d *dev, struct i2c_transport *bus, enum htu21d_mode mode);
+
+// Starts a measurement cycle (IDLE/READY -> T_CONVERTING)
+int htu21d_start(struct htu21d *dev, const struct timespec *now);
+
+// Advances the state machine once dev->deadline has passed
+int htu21d_step(struct htu21d *dev, const struct timespec *now);
+
+// Drops any measurement in progress (after an error)
+void htu21d_abort(struct htu21d *dev);
+
+// Programs the measurement resolution (IDLE/READY only)
+int htu21d_set_resolution(struct htu21d *dev, enum htu21d_resolution res);
+
+// Parses "14", "13", "12" or "11" (temperature bits) into a resolution
+int htu21d_parse_resolution(const char *str, enum htu21d_resolution *res);
+
+// Returns the temperature/humidity bit counts of a resolution
+int htu21d_temp_bits(enum htu21d_resolution res);
+int htu21d_hum_bits(enum htu21d_resolution res);
+
+// Computes the HTU21D CRC-8 (polynomial 0x131, init 0)
+uint8_t htu21d_crc8(const uint8_t *data, size_t len);
+
+#endif
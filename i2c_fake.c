@@ -0,0 +1,204 @@
+/**
+ * @file i2c_fake.c
+ * @brief In-process simulated HTU21D behind the I2C transport interface.
+ *
+ * The fake behaves like the real chip on the wire: a no-hold measurement command
+ * starts a conversion, reads are NACKed until the conversion time has elapsed, and
+ * the result is returned as MSB, LSB (with status bits) and CRC. Hold master
+ * commands sent through `transfer` block for the conversion time, the way the
+ * kernel blocks in I2C_RDWR while the chip stretches the clock. Readings follow a
+ * slow triangle wave so charts have something to show.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "i2c_transport.h"
+#include "time_util.h"
+
+#define FAKE_WAVE_PERIOD_S 600    // Period of the simulated climate
+#define FAKE_USER_DEFAULT 0x02    // User register after power-on (datasheet)
+
+#define FAKE_T_BASE 25678  // Raw code for ~22.0 °C
+#define FAKE_T_SWING 600   // ~1.6 °C peak deviation
+#define FAKE_RH_BASE 26739 // Raw code for ~45 %RH
+#define FAKE_RH_SWING 1500 // ~2.9 %RH peak deviation
+
+struct fake_htu21d {
+    int pending;              // Pending reply: 0 none, 'T', 'H' or 'U' (user register)
+    struct timespec ready_at; // When the pending conversion completes
+    uint16_t result;          // Raw code latched at command time
+    uint8_t user_reg;         // User register (resolution in bits 7 and 0)
+};
+
+// Typical conversion times (datasheet, ns) and result bits, by resolution bits 7/0
+static const struct {
+    long t_ns, rh_ns;
+    int t_bits, rh_bits;
+} fake_timing[4] = {
+    { 44000000L, 14000000L, 14, 12 }, // 00: RH12/T14
+    { 11000000L, 2000000L, 12, 8 },   // 01: RH8/T12
+    { 22000000L, 4000000L, 13, 10 },  // 10: RH10/T13
+    { 6000000L, 7000000L, 11, 11 },   // 11: RH11/T11
+};
+
+/**
+ * @brief Returns the timing index for the resolution in the user register.
+ */
+static int fake_res(const struct fake_htu21d *dev) {
+    return ((dev->user_reg >> 6) & 0x2) | (dev->user_reg & 0x1);
+}
+
+/**
+ * @brief Keeps the top `bits` bits of a 16-bit code, like a lower resolution conversion.
+ */
+static uint16_t fake_truncate(int code, int bits) {
+    return (uint16_t)(code & (0xFFFF << (16 - bits)));
+}
+
+/**
+ * @brief Bitwise HTU21D CRC-8 (x^8 + x^5 + x^4 + 1), as computed by the chip.
+ */
+static uint8_t fake_crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+/**
+ * @brief Returns a triangle wave in [-swing, swing] over FAKE_WAVE_PERIOD_S.
+ */
+static int fake_wave(const struct timespec *now, int swing, int phase_s) {
+    long t = (now->tv_sec + phase_s) % FAKE_WAVE_PERIOD_S;
+    long half = FAKE_WAVE_PERIOD_S / 2;
+    long tri = t < half ? t : FAKE_WAVE_PERIOD_S - t; // 0..half..0
+    return (int)((tri * 2 - half) * swing / half);
+}
+
+static int fake_write(struct i2c_transport *t, const uint8_t *buf, size_t len) {
+    struct fake_htu21d *dev = t->priv;
+    struct timespec now;
+
+    if (len == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (dev->pending) { // The chip does not acknowledge while converting
+        errno = ENXIO;
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    dev->ready_at = now;
+
+    switch (buf[0]) {
+    case 0xE3: // Temperature, hold master
+    case 0xF3: // Temperature, no hold master
+        dev->pending = 'T';
+        dev->result = fake_truncate(FAKE_T_BASE + fake_wave(&now, FAKE_T_SWING, 0),
+                                    fake_timing[fake_res(dev)].t_bits);
+        timespec_add_ns(&dev->ready_at, fake_timing[fake_res(dev)].t_ns);
+        return 0;
+    case 0xE5: // Humidity, hold master
+    case 0xF5: // Humidity, no hold master
+        dev->pending = 'H';
+        dev->result = fake_truncate(FAKE_RH_BASE + fake_wave(&now, FAKE_RH_SWING, 150),
+                                    fake_timing[fake_res(dev)].rh_bits) | 0x2; // Status bit 1: humidity
+        timespec_add_ns(&dev->ready_at, fake_timing[fake_res(dev)].rh_ns);
+        return 0;
+    case 0xE6: // Write user register; reserved bits 3..5 are read-only
+        if (len < 2) {
+            errno = EREMOTEIO;
+            return -1;
+        }
+        dev->user_reg = (uint8_t)((dev->user_reg & 0x38) | (buf[1] & ~0x38));
+        return 0;
+    case 0xE7: // Read user register
+        dev->pending = 'U';
+        return 0;
+    case 0xFE: // Soft reset: back to the power-on resolution
+        dev->user_reg = FAKE_USER_DEFAULT;
+        return 0;
+    default:
+        errno = EREMOTEIO;
+        return -1;
+    }
+}
+
+static int fake_read(struct i2c_transport *t, uint8_t *buf, size_t len) {
+    struct fake_htu21d *dev = t->priv;
+    struct timespec now;
+    uint8_t frame[3];
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!dev->pending || timespec_cmp(&now, &dev->ready_at) < 0) {
+        errno = ENXIO; // Nothing to read yet: NACK the address
+        return -1;
+    }
+
+    if (dev->pending == 'U') { // User register: a single byte, no CRC
+        buf[0] = dev->user_reg;
+        for (size_t i = 1; i < len; i++)
+            buf[i] = 0xFF;
+        dev->pending = 0;
+        return 0;
+    }
+
+    frame[0] = (uint8_t)(dev->result >> 8);
+    frame[1] = (uint8_t)(dev->result & 0xFF);
+    frame[2] = fake_crc8(frame, 2);
+    dev->pending = 0;
+
+    for (size_t i = 0; i < len; i++)
+        buf[i] = i < sizeof(frame) ? frame[i] : 0xFF;
+    return 0;
+}
+
+static int fake_transfer(struct i2c_transport *t, const uint8_t *wbuf, size_t wlen,
+                         uint8_t *rbuf, size_t rlen) {
+    struct fake_htu21d *dev = t->priv;
+
+    if (fake_write(t, wbuf, wlen) < 0)
+        return -1;
+    if (wbuf[0] == 0xE3 || wbuf[0] == 0xE5) // Hold master: SCL stretched until done
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &dev->ready_at, NULL) == EINTR)
+            ;
+    return fake_read(t, rbuf, rlen);
+}
+
+static void fake_close(struct i2c_transport *t) {
+    free(t->priv);
+    t->priv = NULL;
+}
+
+static const struct i2c_transport_ops fake_ops = {
+    .write = fake_write,
+    .read = fake_read,
+    .transfer = fake_transfer,
+    .close = fake_close,
+};
+
+/**
+ * @brief Opens an in-process simulated HTU21D.
+ *
+ * @param t Transport to initialize.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int i2c_fake_open(struct i2c_transport *t) {
+    t->ops = NULL;
+    t->fd = -1;
+    t->addr = 0x40;
+    t->transactions = 0;
+    t->on_transaction = NULL;
+    t->priv = calloc(1, sizeof(struct fake_htu21d));
+    if (t->priv == NULL)
+        return -1;
+    ((struct fake_htu21d *)t->priv)->user_reg = FAKE_USER_DEFAULT;
+
+    t->ops = &fake_ops;
+    return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file i2c_transport.c
+ * @brief i2c-dev backed implementation of the I2C transport.
+ *
+ * Every operation is a single I2C_RDWR ioctl carrying one or two struct i2c_msg,
+ * so a command plus its readback is one kernel round trip with a repeated start
+ * in between (required by the HTU21D "hold master" commands, during which the
+ * chip stretches SCL until the conversion is done).
+ */
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "i2c_transport.h"
+#include "time_util.h"
+
+/**
+ * @brief Issues one I2C_RDWR transaction.
+ *
+ * @return 0 on success, -1 on error (errno set).
+ */
+static int i2c_dev_rdwr(struct i2c_transport *t, struct i2c_msg *msgs, unsigned nmsgs) {
+    struct i2c_rdwr_ioctl_data xfer = { .msgs = msgs, .nmsgs = nmsgs };
+    int n = ioctl(t->fd, I2C_RDWR, &xfer);
+
+    if (n < 0)
+        return -1;
+    if ((unsigned)n != nmsgs) { // Partial transaction: the device stopped acknowledging
+        errno = EREMOTEIO;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes a single message to the slave.
+ */
+static int i2c_dev_write(struct i2c_transport *t, const uint8_t *buf, size_t len) {
+    struct i2c_msg msg = { .addr = t->addr, .flags = 0, .len = (uint16_t)len, .buf = (uint8_t *)buf };
+    return i2c_dev_rdwr(t, &msg, 1);
+}
+
+/**
+ * @brief Reads a single message from the slave.
+ */
+static int i2c_dev_read(struct i2c_transport *t, uint8_t *buf, size_t len) {
+    struct i2c_msg msg = { .addr = t->addr, .flags = I2C_M_RD, .len = (uint16_t)len, .buf = buf };
+    return i2c_dev_rdwr(t, &msg, 1);
+}
+
+/**
+ * @brief Writes a command and reads the reply after a repeated start.
+ */
+static int i2c_dev_transfer(struct i2c_transport *t, const uint8_t *wbuf, size_t wlen,
+                            uint8_t *rbuf, size_t rlen) {
+    struct i2c_msg msgs[2] = {
+        { .addr = t->addr, .flags = 0, .len = (uint16_t)wlen, .buf = (uint8_t *)wbuf },
+        { .addr = t->addr, .flags = I2C_M_RD, .len = (uint16_t)rlen, .buf = rbuf },
+    };
+    return i2c_dev_rdwr(t, msgs, 2);
+}
+
+static void i2c_dev_close(struct i2c_transport *t) {
+    if (t->fd >= 0)
+        close(t->fd);
+    t->fd = -1;
+}
+
+static const struct i2c_transport_ops i2c_dev_ops = {
+    .write = i2c_dev_write,
+    .read = i2c_dev_read,
+    .transfer = i2c_dev_transfer,
+    .close = i2c_dev_close,
+};
+
+/**
+ * @brief Opens an i2c-dev bus for combined transactions with one slave.
+ *
+ * @param t Transport to initialize.
+ * @param path Bus device path (e.g. "/dev/i2c-1").
+ * @param addr 7-bit slave address.
+ * @return 0 on success, -1 on error (errno set).
+ */
+int i2c_dev_open(struct i2c_transport *t, const char *path, uint8_t addr) {
+    unsigned long funcs = 0;
+
+    t->ops = NULL;
+    t->priv = NULL;
+    t->addr = addr;
+    t->transactions = 0;
+    t->on_transaction = NULL;
+    t->fd = open(path, O_RDWR | O_CLOEXEC);
+    if (t->fd < 0)
+        return -1;
+
+    // The adapter must support plain I2C messages for I2C_RDWR
+    if (ioctl(t->fd, I2C_FUNCS, &funcs) < 0 || !(funcs & I2C_FUNC_I2C)) {
+        int err = (funcs & I2C_FUNC_I2C) ? errno : EOPNOTSUPP;
+        close(t->fd);
+        t->fd = -1;
+        errno = err;
+        return -1;
+    }
+
+    t->ops = &i2c_dev_ops;
+    return 0;
+}
+
+/**
+ * @brief Reports the time elapsed since `begin` to the transport's timing hook.
+ *
+ * errno is preserved: callers check it for NACKs after a failed transaction.
+ */
+static void i2c_report_since(struct i2c_transport *t, const struct timespec *begin) {
+    struct timespec end;
+    int err = errno;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    t->on_transaction(timespec_diff_ns(&end, begin));
+    errno = err;
+}
+
+/**
+ * @brief Issues a write and reports its duration through t->on_transaction.
+ */
+int i2c_timed_write(struct i2c_transport *t, const uint8_t *buf, size_t len) {
+    struct timespec begin;
+    int ret;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    ret = t->ops->write(t, buf, len);
+    i2c_report_since(t, &begin);
+    return ret;
+}
+
+/**
+ * @brief Issues a read and reports its duration through t->on_transaction.
+ */
+int i2c_timed_read(struct i2c_transport *t, uint8_t *buf, size_t len) {
+    struct timespec begin;
+    int ret;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    ret = t->ops->read(t, buf, len);
+    i2c_report_since(t, &begin);
+    return ret;
+}
+
+/**
+ * @brief Issues a combined write/read and reports its duration through t->on_transaction.
+ */
+int i2c_timed_transfer(struct i2c_transport *t, const uint8_t *wbuf, size_t wlen, uint8_t *rbuf, size_t rlen) {
+    struct timespec begin;
+    int ret;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    ret = t->ops->transfer(t, wbuf, wlen, rbuf, rlen);
+    i2c_report_since(t, &begin);
+    return ret;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file i2c_transport.h
+ * @brief Swappable I2C transport used by the HTU21D driver.
+ *
+ * The driver never touches the i2c-dev file descriptor directly; it goes through
+ * a small table of operations so the same code can run against the real bus or
+ * against an in-process simulated sensor (no Raspberry Pi required).
+ *
+ * Every operation is exactly one bus transaction. On i2c-dev each one is a single
+ * I2C_RDWR ioctl, so a command followed by a repeated-start read (`transfer`)
+ * costs one kernel round trip and lets the chip stretch the clock.
+ *
+ * All operations return 0 on success and -1 with errno set on failure. A NACK
+ * from the device is reported as ENXIO or EREMOTEIO, like i2c-dev does.
+ *
+ * A user can have every transaction timed by setting the `on_transaction`
+ * hook; without one the wrappers read no clock.
+ */
+
+#ifndef I2C_TRANSPORT_H
+#define I2C_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+
+struct i2c_transport;
+
+// Receives the duration of one transaction in ns
+typedef void (*i2c_timing_fn)(long long ns);
+
+// Operations implemented by every transport
+struct i2c_transport_ops {
+    int (*write)(struct i2c_transport *t, const uint8_t *buf, size_t len); // Single write message
+    int (*read)(struct i2c_transport *t, uint8_t *buf, size_t len);        // Single read message
+    int (*transfer)(struct i2c_transport *t, const uint8_t *wbuf, size_t wlen,
+                    uint8_t *rbuf, size_t rlen);                           // Write, repeated start, read
+    void (*close)(struct i2c_transport *t);                                // Release the transport
+};
+
+struct i2c_transport {
+    const struct i2c_transport_ops *ops; // Transport implementation
+    int fd;                              // i2c-dev file descriptor (-1 for the simulated bus)
+    uint8_t addr;                        // 7-bit slave address
+    void *priv;                          // Implementation private state
+    unsigned long transactions;          // Transactions issued (one syscall each on i2c-dev)
+    i2c_timing_fn on_transaction;        // Called with the duration of every transaction, or NULL
+};
+
+// Returns non-zero if errno describes a NACK from the addressed device
+#define I2C_IS_NACK(err) ((err) == ENXIO || (err) == EREMOTEIO)
+
+// Opens an i2c-dev bus and selects the slave address
+int i2c_dev_open(struct i2c_transport *t, const char *path, uint8_t addr);
+
+// Opens an in-process simulated HTU21D
+int i2c_fake_open(struct i2c_transport *t);
+
+// Same as the wrappers below, reporting the duration to t->on_transaction (must be set)
+int i2c_timed_write(struct i2c_transport *t, const uint8_t *buf, size_t len);
+int i2c_timed_read(struct i2c_transport *t, uint8_t *buf, size_t len);
+int i2c_timed_transfer(struct i2c_transport *t, const uint8_t *wbuf, size_t wlen, uint8_t *rbuf, size_t rlen);
+
+static inline int i2c_write(struct i2c_transport *t, const uint8_t *buf, size_t len) {
+    t->transactions++;
+    if (t->on_transaction != NULL)
+        return i2c_timed_write(t, buf, len);
+    return t->ops->write(t, buf, len);
+}
+
+static inline int i2c_read(struct i2c_transport *t, uint8_t *buf, size_t len) {
+    t->transactions++;
+    if (t->on_transaction != NULL)
+        return i2c_timed_read(t, buf, len);
+    return t->ops->read(t, buf, len);
+}
+
+static inline int i2c_transfer(struct i2c_transport *t, const uint8_t *wbuf, size_t wlen,
+                               uint8_t *rbuf, size_t rlen) {
+    t->transactions++;
+    if (t->on_transaction != NULL)
+        return i2c_timed_transfer(t, wbuf, wlen, rbuf, rlen);
+    return t->ops->transfer(t, wbuf, wlen, rbuf, rlen);
+}
+
+static inline void i2c_close(struct i2c_transport *t) {
+    if (t->ops)
+        t->ops->close(t);
+}
+
+#endif
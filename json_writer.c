@@ -0,0 +1,80 @@
+/**
+ * @file json_writer.c
+ * @brief Allocation-free JSON fragment writer for the hot serializers.
+ *
+ * Numbers are produced two digits at a time from a 200-byte table of all pairs
+ * "00".."99", using only integer division by 100.
+ */
+
+#include "json_writer.h"
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * @brief Appends an unsigned integer in decimal.
+ *
+ * @param p Output cursor (needs JSON_U64_MAX bytes).
+ * @param v Value.
+ * @return Advanced cursor.
+ */
+char *json_put_u64(char *p, uint64_t v) {
+    char tmp[JSON_U64_MAX];
+    char *t = tmp + sizeof(tmp);
+
+    while (v >= 100) { // Fill from the right, two digits per step
+        unsigned pair = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--t = digit_pairs[pair + 1];
+        *--t = digit_pairs[pair];
+    }
+    if (v >= 10) {
+        *--t = digit_pairs[v * 2 + 1];
+        *--t = digit_pairs[v * 2];
+    } else {
+        *--t = (char)('0' + v);
+    }
+
+    size_t n = (size_t)(tmp + sizeof(tmp) - t);
+    memcpy(p, t, n);
+    return p + n;
+}
+
+/**
+ * @brief Appends a fixed-point value with two decimals.
+ *
+ * The text is exact for every int32_t: the integer is split at the hundredths
+ * with no rounding. Callers converting from a raw code or a float choose the
+ * rounding (json_centi() rounds half away from zero, which "%.2f" on the same
+ * float does not always match).
+ *
+ * @param p Output cursor (needs JSON_CENTI_MAX bytes).
+ * @param centi Value in hundredths (2150 -> "21.50").
+ * @return Advanced cursor.
+ */
+char *json_put_centi(char *p, int32_t centi) {
+    uint32_t u;
+
+    if (centi < 0) {
+        *p++ = '-';
+        u = (uint32_t)0 - (uint32_t)centi;
+    } else {
+        u = (uint32_t)centi;
+    }
+
+    p = json_put_u64(p, u / 100); // Integer part
+    unsigned frac = (u % 100) * 2;
+    p[0] = '.';
+    p[1] = digit_pairs[frac];
+    p[2] = digit_pairs[frac + 1];
+    return p + 3;
+}
@@ -0,0 +1,34 @@
+/**
+ * @file json_writer.h
+ * @brief Allocation-free JSON fragment writer for the hot serializers.
+ *
+ * Every function appends to an output cursor and returns the advanced cursor,
+ * so a serializer walks its buffer exactly once: no snprintf() parsing of a
+ * format string per value and no strcat() rescans of the text written so far.
+ * The caller sizes the buffer; JSON_CENTI_MAX bounds one formatted number.
+ */
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define JSON_CENTI_MAX 12 // Longest json_put_centi() output: "-21474836.48"
+#define JSON_U64_MAX 20   // Longest json_put_u64() output
+
+// Appends an integer number of hundredths exactly, as "[-]I.FF" (rounding to hundredths is the caller's)
+char *json_put_centi(char *p, int32_t centi);
+
+// Appends an unsigned integer in decimal
+char *json_put_u64(char *p, uint64_t v);
+
+// Converts a float to hundredths, rounding half away from zero
+static inline int32_t json_centi(float v) {
+    return (int32_t)(v * 100.0f + (v < 0 ? -0.5f : 0.5f));
+}
+
+// Appends a string literal (length known at compile time)
+#define json_put_lit(p, lit) (memcpy((p), (lit), sizeof(lit) - 1), (p) + sizeof(lit) - 1)
+
+#endif
@@ -0,0 +1,116 @@
+/**
+ * @file longpoll.c
+ * @brief Long-poll for the next sample (/data?after=<seq>).
+ *
+ * MHD calls the access handler again for a connection suspended from it once
+ * the connection is resumed, with the same con_cls. The waiter lives there from
+ * the first call until a response is queued or the request ends.
+ */
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "longpoll.h"
+#include "waitlist.h"
+#include "sensor_reader.h"
+#include "time_util.h"
+
+struct longpoll {
+    struct waiter waiter;   // Waitlist entry while suspended
+    uint64_t after;         // Last sample seen by the client, as of the first call
+    int64_t deadline_ms;    // CLOCK_MONOTONIC time at which the poll times out
+    int suspended;          // On the waitlist (counted in `waiting`)
+};
+
+static atomic_ulong waiting = 0; // Suspended long polls
+
+/**
+ * @brief Answers or suspends a long poll.
+ *
+ * The answer is the newest sample, as {"seq", "time", "temperature",
+ * "humidity"}: the client passes its seq as `after` in the next request. A
+ * seq from before a restart (above the newest) waits for the next sample.
+ *
+ * @param connection The MHD connection object.
+ * @param after Last sample seen by the client.
+ * @param con_cls Connection-specific pointer of the access handler.
+ * @param response Receives the response to queue.
+ * @return MHD_HTTP_OK or MHD_HTTP_NO_CONTENT with *response set, 0 if the
+ *         connection was suspended, -1 on allocation failure.
+ */
+int longpoll_poll(struct MHD_Connection *connection, uint64_t after, void **con_cls,
+                  struct MHD_Response **response) {
+    struct longpoll *lp = *con_cls;
+    uint64_t latest = get_sample_seq();
+    struct sensor_sample s;
+    struct timespec now;
+    char body[LONGPOLL_BODY_MAX], *p = body;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (lp != NULL && lp->suspended) { // Resumed
+        lp->suspended = 0;
+        atomic_fetch_sub_explicit(&waiting, 1, memory_order_relaxed);
+    }
+    if (lp != NULL)
+        after = lp->after; // Not clamped again: samples published since are news
+    else if (after > latest)
+        after = latest;
+
+    if (latest > after && get_sample(latest, &s) == 0) {
+        p = json_put_lit(p, "{\"seq\": ");
+        p = json_put_u64(p, s.seq);
+        p = json_put_lit(p, ", \"time\": ");
+        p = json_put_u64(p, (uint64_t)s.time_ms);
+        p = json_put_lit(p, ", \"temperature\": ");
+        p = json_put_centi(p, s.temperature);
+        p = json_put_lit(p, ", \"humidity\": ");
+        p = json_put_centi(p, s.humidity);
+        p = json_put_lit(p, "}");
+    } else if (lp == NULL || timespec_ms(&now) < lp->deadline_ms) {
+        if (lp == NULL) { // First call: set up the waiter
+            if ((lp = malloc(sizeof(*lp))) == NULL)
+                return -1;
+            lp->waiter.conn = connection;
+            lp->after = after;
+            lp->suspended = 0;
+            lp->deadline_ms = timespec_ms(&now) + LONGPOLL_TIMEOUT_MS;
+            *con_cls = lp;
+        }
+        lp->suspended = 1;
+        atomic_fetch_add_explicit(&waiting, 1, memory_order_relaxed);
+        waitlist_suspend(&lp->waiter, latest + 1); // Resumed by the next sample or tick
+        return 0;
+    }
+
+    longpoll_release(con_cls);
+    *response = MHD_create_response_from_buffer((size_t)(p - body), body, MHD_RESPMEM_MUST_COPY);
+    if (*response == NULL)
+        return -1;
+    return p != body ? MHD_HTTP_OK : MHD_HTTP_NO_CONTENT;
+}
+
+/**
+ * @brief Releases the state of a long poll.
+ *
+ * Called once the response is queued, and when a request ends: a client that
+ * disconnects while suspended is noticed only after its connection is resumed,
+ * so the waiter is off the waitlist by then.
+ *
+ * @param con_cls Connection-specific pointer of the access handler (may hold NULL).
+ */
+void longpoll_release(void **con_cls) {
+    struct longpoll *lp = *con_cls;
+
+    if (lp != NULL && lp->suspended)
+        atomic_fetch_sub_explicit(&waiting, 1, memory_order_relaxed);
+    free(lp);
+    *con_cls = NULL;
+}
+
+/**
+ * @brief Returns the number of suspended long polls.
+ */
+unsigned long longpoll_waiting(void) {
+    return atomic_load_explicit(&waiting, memory_order_relaxed);
+}
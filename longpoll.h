@@ -0,0 +1,34 @@
+/**
+ * @file longpoll.h
+ * @brief Long-poll for the next sample (/data?after=<seq>).
+ *
+ * A request naming the last sample it has seen is answered as soon as a newer
+ * one is published. Until then its connection is suspended on the waitlist
+ * (waitlist.h), so neither the client nor the server polls, and the sensor
+ * thread only ever signals an eventfd. A request still waiting after
+ * LONGPOLL_TIMEOUT_MS is answered 204 No Content and the client asks again.
+ */
+
+#ifndef LONGPOLL_H
+#define LONGPOLL_H
+
+#include <stdint.h>
+#include <microhttpd.h>
+
+#include "json_writer.h"
+
+#define LONGPOLL_TIMEOUT_MS 25000 // Checked on each wakeup, so it may run up to WAITLIST_TICK_MS late
+#define LONGPOLL_BODY_MAX (2 * JSON_U64_MAX + 2 * JSON_CENTI_MAX + 64) // Upper bound of the body
+
+// Answers or suspends a long poll for a sample after `after`; *con_cls holds its state between calls.
+// Returns the HTTP status with *response set, 0 if the connection was suspended, -1 on allocation failure
+int longpoll_poll(struct MHD_Connection *connection, uint64_t after, void **con_cls,
+                  struct MHD_Response **response);
+
+// Releases the state of a long poll that ended while suspended (client gone); *con_cls may be NULL
+void longpoll_release(void **con_cls);
+
+// Returns the number of suspended long polls
+unsigned long longpoll_waiting(void);
+
+#endif
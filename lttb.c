@@ -0,0 +1,72 @@
+/**
+ * @file lttb.c
+ * @brief Largest-Triangle-Three-Buckets downsampling of a time series.
+ */
+
+#include "lttb.h"
+
+/**
+ * @brief Returns the first index of bucket `b`.
+ *
+ * Points 1 .. n-2 are split into `buckets` ranges by integer arithmetic, so
+ * the bounds are exact for any n and never overlap.
+ */
+static size_t lttb_bucket_start(size_t b, size_t n, size_t buckets) {
+    return 1 + b * (n - 2) / buckets;
+}
+
+/**
+ * @brief Selects the indices of the points to plot.
+ *
+ * x must be increasing. Areas are computed relative to x[0] in double
+ * precision, which is exact for millisecond timestamps spanning centuries.
+ *
+ * @param x Sample times.
+ * @param y Sample values.
+ * @param n Number of samples.
+ * @param points Number of points wanted (at least LTTB_POINTS_MIN).
+ * @param out Receives min(n, points) indices, increasing.
+ * @return Number of indices written.
+ */
+size_t lttb_select(const int64_t *x, const int32_t *y, size_t n, size_t points, uint32_t *out) {
+    size_t buckets, kept = 0, a = 0;
+
+    if (points >= n || points < LTTB_POINTS_MIN) { // Nothing to drop
+        for (size_t i = 0; i < n; i++)
+            out[i] = (uint32_t)i;
+        return n;
+    }
+
+    buckets = points - 2;
+    out[kept++] = 0;
+    for (size_t b = 0; b < buckets; b++) {
+        size_t start = lttb_bucket_start(b, n, buckets);
+        size_t end = lttb_bucket_start(b + 1, n, buckets);
+        size_t next_end = b + 1 < buckets ? lttb_bucket_start(b + 2, n, buckets) : n;
+        double ax = (double)(x[a] - x[0]), ay = y[a];
+        double cx = 0, cy = 0, best = -1;
+        size_t pick = start;
+
+        // Third vertex: average of the next bucket (the last point for the last bucket)
+        for (size_t i = end; i < next_end; i++) {
+            cx += (double)(x[i] - x[0]);
+            cy += y[i];
+        }
+        cx /= (double)(next_end - end);
+        cy /= (double)(next_end - end);
+
+        for (size_t i = start; i < end; i++) {
+            double area = (ax - cx) * (y[i] - ay) - (ax - (double)(x[i] - x[0])) * (cy - ay);
+            if (area < 0)
+                area = -area;
+            if (area > best) {
+                best = area;
+                pick = i;
+            }
+        }
+        out[kept++] = (uint32_t)pick;
+        a = pick;
+    }
+    out[kept++] = (uint32_t)(n - 1);
+    return kept;
+}
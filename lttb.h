@@ -0,0 +1,23 @@
+/**
+ * @file lttb.h
+ * @brief Largest-Triangle-Three-Buckets downsampling of a time series.
+ *
+ * Keeps the first and last points and splits the others into `points - 2`
+ * equal buckets. From each bucket it keeps the point forming the largest
+ * triangle with the point kept from the previous bucket and the average of the
+ * next bucket, so peaks and dips survive where plain decimation or averaging
+ * would flatten them. One pass over the data, no allocation.
+ */
+
+#ifndef LTTB_H
+#define LTTB_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LTTB_POINTS_MIN 3 // First, last and at least one bucket
+
+// Selects min(n, points) indices of (x, y) to plot; returns their count
+size_t lttb_select(const int64_t *x, const int32_t *y, size_t n, size_t points, uint32_t *out);
+
+#endif
@@ -0,0 +1,365 @@
+/**
+ * @file metrics.c
+ * @brief Hot-path counters and latency histograms for /metrics (Prometheus text format).
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "metrics.h"
+
+#define METRICS_LINE 64 // Cache line: shards never share one
+
+// Buckets of one histogram; the count is the sum of the buckets
+struct metrics_cells {
+    _Atomic uint64_t buckets[METRICS_BUCKETS + 1]; // Last: above every bound
+    _Atomic uint64_t sum_ns;                       // Sum of the observations
+};
+
+// Everything one thread records
+struct metrics_shard {
+    _Atomic uint64_t requests[METRICS_ROUTES][METRICS_CLASSES]; // By route and status class
+    struct metrics_cells route[METRICS_ROUTES];                 // Handler time by route
+    struct metrics_cells hist[METRICS_HISTS];
+} __attribute__((aligned(METRICS_LINE)));
+
+// Histogram family exported for each metrics_hist
+struct metrics_hist_info {
+    const char *name;
+    const char *help;
+};
+
+const long metrics_bounds_us[METRICS_BUCKETS] = {
+    10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000,
+};
+
+static const char *const route_paths[METRICS_ROUTES] = {
+    "/data", "/history", "/stats", "/archive", "/stream", "/ws", "/status", "/config", "/metrics", "other",
+};
+
+static const struct metrics_hist_info hist_info[METRICS_HISTS] = {
+    { "htu21d_i2c_transaction_duration_seconds", "Duration of one I2C bus transaction." },
+    { "htu21d_conversion_wait_seconds", "Time from the measurement command to the last result read, both channels." },
+    { "http_body_build_duration_seconds", "Time spent serializing a cached response body." },
+};
+
+static struct metrics_shard shards[METRICS_SHARDS]; // The last one is shared by late threads
+static atomic_uint shards_claimed;
+static _Thread_local struct metrics_shard *my_shard; // Shard of the calling thread, NULL until its first observation
+static _Thread_local int my_shard_owned;             // Non-zero if no other thread writes my_shard
+
+/**
+ * @brief Returns the shard of the calling thread, claiming one on first use.
+ */
+static struct metrics_shard *thread_shard(void) {
+    if (my_shard == NULL) {
+        unsigned i = atomic_fetch_add_explicit(&shards_claimed, 1, memory_order_relaxed);
+        my_shard_owned = i < METRICS_SHARDS - 1;
+        my_shard = &shards[my_shard_owned ? i : METRICS_SHARDS - 1];
+    }
+    return my_shard;
+}
+
+/**
+ * @brief Adds to a counter of the calling thread's shard.
+ *
+ * A shard with a single writer needs no locked read-modify-write: a relaxed
+ * load and store keep readers tear-free at the cost of a plain increment.
+ *
+ * @param c Counter.
+ * @param v Amount to add.
+ * @param owned Non-zero if the calling thread is the only writer of the shard.
+ */
+static inline void counter_add(_Atomic uint64_t *c, uint64_t v, int owned) {
+    if (owned)
+        atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v, memory_order_relaxed);
+    else
+        atomic_fetch_add_explicit(c, v, memory_order_relaxed);
+}
+
+/**
+ * @brief Adds one observation to histogram cells.
+ *
+ * @param c Cells of the calling thread's shard.
+ * @param ns Observed duration in nanoseconds.
+ * @param owned Non-zero if the calling thread is the only writer of the cells.
+ */
+static void cells_add(struct metrics_cells *c, long long ns, int owned) {
+    int b = 0;
+
+    if (ns < 0)
+        ns = 0; // Clock stepped backwards
+    while (b < METRICS_BUCKETS && ns > metrics_bounds_us[b] * 1000LL) // le is inclusive: 10.5 us is above 10
+        b++;
+    counter_add(&c->buckets[b], 1, owned);
+    counter_add(&c->sum_ns, (uint64_t)ns, owned);
+}
+
+/**
+ * @brief Returns the route counted for a request path.
+ *
+ * @param url Request path, without the query string.
+ */
+enum metrics_route metrics_route_of(const char *url) {
+    int r = 0;
+
+    while (r < METRICS_ROUTE_OTHER && strcmp(url, route_paths[r]) != 0)
+        r++;
+    return (enum metrics_route)r;
+}
+
+/**
+ * @brief Counts a request and records the time the handler spent on it.
+ *
+ * @param route Route of the request.
+ * @param status HTTP status queued (100-599).
+ * @param ns Time in the handler, in nanoseconds.
+ */
+void metrics_request(enum metrics_route route, unsigned int status, long long ns) {
+    struct metrics_shard *s = thread_shard();
+    unsigned cls = status / 100 - 1;
+
+    if (cls >= METRICS_CLASSES)
+        cls = METRICS_CLASSES - 1; // Not a valid status: count it as a server error
+    counter_add(&s->requests[route][cls], 1, my_shard_owned);
+    cells_add(&s->route[route], ns, my_shard_owned);
+}
+
+/**
+ * @brief Adds one observation to a histogram.
+ *
+ * @param hist Histogram.
+ * @param ns Observed duration in nanoseconds.
+ */
+void metrics_observe(enum metrics_hist hist, long long ns) {
+    struct metrics_shard *s = thread_shard();
+
+    cells_add(&s->hist[hist], ns, my_shard_owned);
+}
+
+/**
+ * @brief Appends formatted text to a scrape.
+ *
+ * Output that does not fit is dropped and the buffer flagged as truncated.
+ */
+void metrics_printf(struct metrics_buf *b, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    if (b->truncated)
+        return;
+    va_start(ap, fmt);
+    n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= b->cap - b->len)
+        b->truncated = 1;
+    else
+        b->len += (size_t)n;
+}
+
+/**
+ * @brief Appends the # HELP and # TYPE lines of a metric family.
+ *
+ * @param b Scrape output.
+ * @param name Metric name.
+ * @param type "counter", "gauge" or "histogram".
+ * @param help One-line description.
+ */
+void metrics_family(struct metrics_buf *b, const char *name, const char *type, const char *help) {
+    metrics_printf(b, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/**
+ * @brief Sums the cells of every shard.
+ *
+ * @param offset Offset of the cells inside struct metrics_shard.
+ * @param buckets Receives the bucket counts.
+ * @param sum_ns Receives the sum of the observations.
+ */
+static void merge_cells(size_t offset, uint64_t buckets[METRICS_BUCKETS + 1], uint64_t *sum_ns) {
+    memset(buckets, 0, (METRICS_BUCKETS + 1) * sizeof(buckets[0]));
+    *sum_ns = 0;
+    for (int s = 0; s < METRICS_SHARDS; s++) {
+        struct metrics_cells *c = (struct metrics_cells *)((char *)&shards[s] + offset);
+
+        for (int i = 0; i <= METRICS_BUCKETS; i++)
+            buckets[i] += atomic_load_explicit(&c->buckets[i], memory_order_relaxed);
+        *sum_ns += atomic_load_explicit(&c->sum_ns, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Appends the series of one histogram, merged over the shards.
+ *
+ * @param b Scrape output.
+ * @param name Family name.
+ * @param label Label pair without braces ("route=\"/data\""), or "" for none.
+ * @param offset Offset of the cells inside struct metrics_shard.
+ */
+static void put_histogram(struct metrics_buf *b, const char *name, const char *label, size_t offset) {
+    uint64_t buckets[METRICS_BUCKETS + 1], sum_ns, count = 0;
+    const char *sep = *label != '\0' ? "," : "";
+
+    merge_cells(offset, buckets, &sum_ns);
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        long us = metrics_bounds_us[i];
+        char le[16];
+        int n = snprintf(le, sizeof(le), "%ld.%06ld", us / 1000000, us % 1000000);
+
+        while (le[n - 1] == '0') // 0.000250 -> 0.00025, 1.000000 -> 1.
+            n--;
+        if (le[n - 1] == '.')
+            n--;
+        le[n] = '\0';
+        count += buckets[i];
+        metrics_printf(b, "%s_bucket{%s%sle=\"%s\"} %llu\n", name, label, sep, le, (unsigned long long)count);
+    }
+    count += buckets[METRICS_BUCKETS];
+    metrics_printf(b, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, label, sep, (unsigned long long)count);
+    metrics_printf(b, "%s_sum%s%s%s %llu.%09llu\n", name, *label ? "{" : "", label, *label ? "}" : "",
+                   (unsigned long long)(sum_ns / NSEC_PER_SEC), (unsigned long long)(sum_ns % NSEC_PER_SEC));
+    metrics_printf(b, "%s_count%s%s%s %llu\n", name, *label ? "{" : "", label, *label ? "}" : "",
+                   (unsigned long long)count);
+}
+
+/**
+ * @brief Appends the request counters and every histogram, merged over the shards.
+ *
+ * @param b Scrape output.
+ */
+void metrics_format(struct metrics_buf *b) {
+    char label[32];
+
+    metrics_family(b, "http_requests_total", "counter", "Requests answered, by route and status class.");
+    for (int r = 0; r < METRICS_ROUTES; r++)
+        for (int c = 0; c < METRICS_CLASSES; c++) {
+            uint64_t n = 0;
+
+            for (int s = 0; s < METRICS_SHARDS; s++)
+                n += atomic_load_explicit(&shards[s].requests[r][c], memory_order_relaxed);
+            metrics_printf(b, "http_requests_total{route=\"%s\",code=\"%dxx\"} %llu\n",
+                           route_paths[r], c + 1, (unsigned long long)n);
+        }
+
+    metrics_family(b, "http_request_duration_seconds", "histogram",
+                   "Time spent in the handler, by route (streamed bodies excluded).");
+    for (int r = 0; r < METRICS_ROUTES; r++) {
+        snprintf(label, sizeof(label), "route=\"%s\"", route_paths[r]);
+        put_histogram(b, "http_request_duration_seconds", label,
+                      offsetof(struct metrics_shard, route) + r * sizeof(struct metrics_cells));
+    }
+
+    for (int h = 0; h < METRICS_HISTS; h++) {
+        metrics_family(b, hist_info[h].name, "histogram", hist_info[h].help);
+        put_histogram(b, hist_info[h].name, "",
+                      offsetof(struct metrics_shard, hist) + h * sizeof(struct metrics_cells));
+    }
+}
+
+// Histogram shared by every thread: what the shards avoid
+static struct metrics_cells bench_shared;
+
+struct bench_arg {
+    long ops;
+    int shared; // Record into bench_shared instead of the thread's shard
+};
+
+/**
+ * @brief Benchmark thread: records `ops` observations of varying duration.
+ */
+static void *bench_thread(void *arg) {
+    const struct bench_arg *a = arg;
+
+    for (long i = 0; i < a->ops; i++) {
+        long long ns = (i & 1023) * 997; // Spread over the buckets
+        if (a->shared)
+            cells_add(&bench_shared, ns, 0);
+        else
+            metrics_observe(METRICS_BODY_BUILD, ns);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Records from several threads at once.
+ *
+ * @return Wall time per observation of one thread in ns, or -1 if a thread could not start.
+ */
+static double bench_run(int threads, long ops, int shared) {
+    pthread_t tid[threads];
+    struct bench_arg arg = { ops, shared };
+    struct timespec begin, end;
+    int started = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    while (started < threads && pthread_create(&tid[started], NULL, bench_thread, &arg) == 0)
+        started++;
+    for (int i = 0; i < started; i++)
+        pthread_join(tid[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (started < threads)
+        return -1;
+    return (double)timespec_diff_ns(&end, &begin) / ops; // Each thread made `ops` of them meanwhile
+}
+
+/**
+ * @brief Compares sharded recording with one histogram shared by all threads.
+ *
+ * Reports the wall time per observation with `threads` threads recording at
+ * once. Must not run alongside the server.
+ *
+ * @param threads Recording threads.
+ * @param ops Observations per thread.
+ * @return 0 on success, -1 on error.
+ */
+int metrics_benchmark(int threads, long ops) {
+    double sharded_ns = bench_run(threads, ops, 0);
+    double shared_ns = bench_run(threads, ops, 1);
+
+    if (sharded_ns < 0 || shared_ns < 0) {
+        perror("metrics benchmark thread");
+        return -1;
+    }
+    printf("\n%-9s %8s %12s %12s\n", "metrics", "threads", "ns/observe", "ns/shared");
+    printf("%-9s %8d %12.2f %12.2f\n", "histogram", threads, sharded_ns, shared_ns);
+    return 0;
+}
+
+/**
+ * @brief Checks that a scrape merges every observation recorded by several threads at once.
+ *
+ * Both the count and the sum of the observations must match what the
+ * threads recorded. Must not run alongside the server.
+ *
+ * @param threads Recording threads.
+ * @param ops Observations per thread.
+ * @return 0 if the merge matches, -1 if not or on error.
+ */
+int metrics_check(int threads, long ops) {
+    size_t offset = offsetof(struct metrics_shard, hist) + METRICS_BODY_BUILD * sizeof(struct metrics_cells);
+    uint64_t buckets[METRICS_BUCKETS + 1], sum_before, sum_after, before = 0, after = 0, expect_ns = 0;
+    int ok;
+
+    for (long i = 0; i < ops; i++) // What bench_thread() records
+        expect_ns += (uint64_t)((i & 1023) * 997);
+    expect_ns *= (uint64_t)threads;
+
+    merge_cells(offset, buckets, &sum_before);
+    for (int i = 0; i <= METRICS_BUCKETS; i++)
+        before += buckets[i];
+    if (bench_run(threads, ops, 0) < 0) {
+        perror("metrics check thread");
+        return -1;
+    }
+    merge_cells(offset, buckets, &sum_after);
+    for (int i = 0; i <= METRICS_BUCKETS; i++)
+        after += buckets[i];
+
+    ok = after - before == (uint64_t)threads * (uint64_t)ops && sum_after - sum_before == expect_ns;
+    printf("%-16s %-6s %d threads x %ld observations merged by a scrape\n", "metrics merge", ok ? "ok" : "FAIL",
+           threads, ops);
+    return ok ? 0 : -1;
+}
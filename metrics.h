@@ -0,0 +1,103 @@
+/**
+ * @file metrics.h
+ * @brief Hot-path counters and latency histograms for /metrics (Prometheus text format).
+ *
+ * Recording never takes a lock and never touches a line shared with another
+ * thread: each thread claims one of METRICS_SHARDS cache-line aligned shards
+ * on its first observation and, as its only writer, adds to it with a relaxed
+ * load and store (no locked instruction, no cache-line ping-pong). Threads
+ * beyond the first METRICS_SHARDS - 1 share the last shard with atomic adds.
+ * A scrape sums the shards; a value being added while it is read shows up in
+ * this scrape or the next one.
+ *
+ * Every histogram shares the bucket bounds of metrics_bounds_us, spanning a
+ * fake-bus transaction to a 14-bit conversion, so the series count is fixed
+ * at compile time and so is the size of a scrape (METRICS_BODY_MAX).
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "time_util.h"
+
+#define METRICS_SHARDS 16       // Per-thread shards, the last one shared by late threads
+#define METRICS_BUCKETS 14      // Finite histogram buckets (plus +Inf)
+#define METRICS_CLASSES 5       // Status classes 1xx to 5xx
+#define METRICS_CACHE_MS 1000   // A scrape body is reused for this long
+#define METRICS_BODY_MAX 32768  // Bound of a scrape body
+
+#define METRICS_BENCH_THREADS 4        // Recording threads of the benchmark
+#define METRICS_BENCH_OPS 2000000      // Observations per thread
+#define METRICS_CHECK_OPS 200000       // Observations per thread of the merge check
+
+// Routes counted by metrics_request()
+enum metrics_route {
+    METRICS_ROUTE_DATA,
+    METRICS_ROUTE_HISTORY,
+    METRICS_ROUTE_STATS,
+    METRICS_ROUTE_ARCHIVE,
+    METRICS_ROUTE_STREAM,
+    METRICS_ROUTE_WS,
+    METRICS_ROUTE_STATUS,
+    METRICS_ROUTE_CONFIG,
+    METRICS_ROUTE_METRICS,
+    METRICS_ROUTE_OTHER, // Dashboard and unknown paths
+    METRICS_ROUTES
+};
+
+// Latency histograms recorded outside the HTTP handler
+enum metrics_hist {
+    METRICS_I2C_TRANSACTION, // One bus transaction of the sensor loop (i2c_transport.h hook)
+    METRICS_CONVERSION,      // Measurement command to last result read, both channels
+    METRICS_BODY_BUILD,      // Serialization of a cached response body (response_cache.h)
+    METRICS_HISTS
+};
+
+// Bounded text output of a scrape: writes past `cap` are dropped and flagged
+struct metrics_buf {
+    char *data;    // Output buffer
+    size_t len;    // Bytes written
+    size_t cap;    // Size of the output buffer
+    int truncated; // Set once a write did not fit
+};
+
+// Upper bounds (microseconds) of the finite histogram buckets
+extern const long metrics_bounds_us[METRICS_BUCKETS];
+
+// Returns the route counted for a request path
+enum metrics_route metrics_route_of(const char *url);
+
+// Counts a request answered with `status` after `ns` nanoseconds in the handler
+void metrics_request(enum metrics_route route, unsigned int status, long long ns);
+
+// Adds one observation of `ns` nanoseconds to a histogram
+void metrics_observe(enum metrics_hist hist, long long ns);
+
+// Adds the time elapsed since `begin` (CLOCK_MONOTONIC) to a histogram
+static inline void metrics_observe_since(enum metrics_hist hist, const struct timespec *begin) {
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    metrics_observe(hist, timespec_diff_ns(&end, begin));
+}
+
+// Appends formatted text to a scrape
+void metrics_printf(struct metrics_buf *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Appends the # HELP and # TYPE lines of a metric family
+void metrics_family(struct metrics_buf *b, const char *name, const char *type, const char *help);
+
+// Appends the request counters and every histogram, merged over the shards
+void metrics_format(struct metrics_buf *b);
+
+// Times observations from several threads, sharded and on one shared counter; 0 on success, -1 on error
+int metrics_benchmark(int threads, long ops);
+
+// Records from several threads and checks that a scrape merges them all; 0 if it does, -1 otherwise
+int metrics_check(int threads, long ops);
+
+#endif
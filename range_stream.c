@@ -0,0 +1,200 @@
+/**
+ * @file range_stream.c
+ * @brief Streams a range of samples as JSON (/archive, /history?from=&to=).
+ */
+
+#include <stdlib.h>
+
+#include "range_stream.h"
+#include "archive.h"
+#include "sensor_reader.h"
+#include "sample_codec.h"
+
+enum range_stream_state {
+    RANGE_STREAM_OPEN,     // Opening bracket not sent yet
+    RANGE_STREAM_ARCHIVE,  // Sending rows from archive blocks
+    RANGE_STREAM_RING,     // Sending rows from the history ring
+    RANGE_STREAM_CLOSE,    // Closing bracket not sent yet
+    RANGE_STREAM_DONE,     // Body complete
+};
+
+struct range_reader {
+    enum range_stream_state state;
+    struct range_query q;
+    uint64_t next_seq;               // First sample not visited yet
+    uint64_t last_seq;               // Newest ring sample when the request arrived
+    size_t next_block;               // Next archive index entry to load
+    int rows;                        // Rows sent so far (for the separators)
+    int loaded;                      // A block is being decoded
+    int ordered;                     // Archive blocks are in time order (archive_time_ordered())
+    struct tsblock_header hdr;       // Current block
+    struct tsblock_decoder dec;
+    uint8_t data[TSBLOCK_BYTES_MAX]; // Its payload
+};
+
+/**
+ * @brief Loads the next sealed block for decoding.
+ *
+ * @return 1 if a block was loaded, 0 when the archive is exhausted.
+ */
+static int range_load_block(struct range_reader *r) {
+    struct archive_block blk;
+
+    while (archive_block(r->next_block++, &blk) == 0) {
+        if (archive_read(&blk, &r->hdr, r->data) < 0)
+            continue; // Unreadable block: serve the rest of the range
+        tsblock_decoder_init(&r->dec, &r->hdr, r->data);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes one sample as a JSON row.
+ *
+ * @param p Output cursor with at least RANGE_ROW_MAX bytes available.
+ * @param r Reader (counts the rows).
+ * @param seq Sequence number.
+ * @param ms Unix time, ms.
+ * @param temperature Temperature in hundredths of °C.
+ * @param humidity Relative humidity in hundredths of %.
+ * @return Cursor past the row.
+ */
+static char *range_put_row(char *p, struct range_reader *r, uint64_t seq, int64_t ms,
+                           int32_t temperature, int32_t humidity) {
+    if (r->rows++ > 0)
+        p = json_put_lit(p, ", ");
+    p = json_put_lit(p, "[");
+    p = json_put_u64(p, seq);
+    p = json_put_lit(p, ", ");
+    p = json_put_u64(p, (uint64_t)ms);
+    p = json_put_lit(p, ", ");
+    p = json_put_centi(p, temperature);
+    p = json_put_lit(p, ", ");
+    p = json_put_centi(p, humidity);
+    p = json_put_lit(p, "]");
+    return p;
+}
+
+/**
+ * @brief Writes rows from the archive until the buffer is full or the archive ends.
+ *
+ * @return Cursor past the rows written.
+ */
+static char *range_put_archive(struct range_reader *r, char *p, const char *end) {
+    struct tsblock_sample s;
+
+    while (r->state == RANGE_STREAM_ARCHIVE && (size_t)(end - p) >= RANGE_ROW_MAX) {
+        if (!r->loaded && !(r->loaded = range_load_block(r))) {
+            r->state = r->q.ring ? RANGE_STREAM_RING : RANGE_STREAM_CLOSE;
+            break;
+        }
+        if (!tsblock_decode(&r->dec, &s)) {
+            r->loaded = 0;
+            continue;
+        }
+        if (s.ms > r->q.to_ms && r->ordered) { // Blocks are in time order: the range is complete
+            r->state = RANGE_STREAM_CLOSE;
+            break;
+        }
+        if (s.seq >= r->next_seq && s.ms >= r->q.from_ms && s.ms <= r->q.to_ms)
+            p = range_put_row(p, r, s.seq, s.ms, temp_centi(s.temp), hum_centi(s.hum));
+        if (s.seq >= r->next_seq)
+            r->next_seq = s.seq + 1;
+    }
+    return p;
+}
+
+/**
+ * @brief Writes rows from the history ring until the buffer is full or the range ends.
+ *
+ * The ring is entered once by binary search on time; samples already sent
+ * from the archive are skipped by sequence number.
+ *
+ * @return Cursor past the rows written.
+ */
+static char *range_put_ring(struct range_reader *r, char *p, const char *end) {
+    struct sensor_sample s;
+    uint64_t first = find_sample_time(r->q.from_ms);
+
+    if (first > r->next_seq)
+        r->next_seq = first;
+    while (r->next_seq <= r->last_seq && (size_t)(end - p) >= RANGE_ROW_MAX) {
+        if (get_sample(r->next_seq, &s) == 0) {
+            if (s.time_ms > r->q.to_ms)
+                break;
+            p = range_put_row(p, r, s.seq, s.time_ms, s.temperature, s.humidity);
+        }
+        r->next_seq++;
+    }
+    if (r->next_seq > r->last_seq || (size_t)(end - p) >= RANGE_ROW_MAX)
+        r->state = RANGE_STREAM_CLOSE; // Not stopped by a full buffer: done
+    return p;
+}
+
+/**
+ * @brief MHD content reader: decodes samples straight into the output buffer.
+ *
+ * @param cls Reader state.
+ * @param pos Bytes sent so far (unused).
+ * @param buf Output buffer.
+ * @param max Size of the output buffer.
+ * @return Bytes written, or MHD_CONTENT_READER_END_OF_STREAM.
+ */
+static ssize_t range_read(void *cls, uint64_t pos, char *buf, size_t max) {
+    struct range_reader *r = cls;
+    char *p = buf;
+
+    (void)pos;
+    if (r->state == RANGE_STREAM_OPEN) {
+        p = json_put_lit(p, "{\"samples\": [");
+        r->state = RANGE_STREAM_ARCHIVE;
+    }
+    if (r->state == RANGE_STREAM_ARCHIVE)
+        p = range_put_archive(r, p, buf + max);
+    if (r->state == RANGE_STREAM_RING)
+        p = range_put_ring(r, p, buf + max);
+
+    if (r->state == RANGE_STREAM_CLOSE && (size_t)(buf + max - p) >= 2) {
+        p = json_put_lit(p, "]}");
+        r->state = RANGE_STREAM_DONE;
+    }
+    if (p == buf && r->state == RANGE_STREAM_DONE)
+        return MHD_CONTENT_READER_END_OF_STREAM;
+    return p - buf;
+}
+
+/**
+ * @brief Creates the response streaming the samples selected by a query.
+ *
+ * The first archive block is found by binary search on both the sequence
+ * number and the start time; the ring part is bounded by the newest sample
+ * at request time, so the body ends even while sampling continues. An older
+ * archive with blocks out of time order is read to its end instead of up to
+ * the first sample past the range.
+ *
+ * @param q Range to send.
+ * @return The response, or NULL on allocation failure.
+ */
+struct MHD_Response *range_create_response(const struct range_query *q) {
+    struct range_reader *r = calloc(1, sizeof(*r));
+    struct MHD_Response *response;
+    size_t by_time;
+
+    if (r == NULL)
+        return NULL;
+    r->q = *q;
+    r->next_seq = q->since + 1;
+    r->last_seq = get_sample_seq();
+    r->ordered = archive_time_ordered();
+    r->next_block = archive_find_seq(r->next_seq);
+    by_time = archive_find_time(q->from_ms);
+    if (by_time > r->next_block)
+        r->next_block = by_time;
+
+    response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, RANGE_STREAM_BLOCK_SIZE,
+                                                 &range_read, r, &free);
+    if (response == NULL)
+        free(r);
+    return response;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file range_stream.h
+ * @brief Streams a range of samples as JSON (/archive, /history?from=&to=).
+ *
+ * The body is
+ *
+ *     {"samples": [[<seq>, <unix_ms>, <temperature>, <humidity>], ...]}
+ *
+ * It is produced by an MHD content reader that decodes one archive block
+ * (archive.h) at a time into the output buffer, then continues with the
+ * history ring for the samples not sealed into a block yet. Both sources are
+ * entered by binary search, on the sequence number or on time, so a range
+ * costs O(log n + k) whatever the retention, and one packed block plus one
+ * buffer of memory per request.
+ */
+
+#ifndef RANGE_STREAM_H
+#define RANGE_STREAM_H
+
+#include <stdint.h>
+#include <microhttpd.h>
+
+#include "json_writer.h"
+
+#define RANGE_STREAM_BLOCK_SIZE 32768 // Content reader buffer size
+#define RANGE_ROW_MAX (2 * JSON_U64_MAX + 2 * JSON_CENTI_MAX + 16) // Upper bound of one row
+
+// Samples to stream
+struct range_query {
+    uint64_t since;  // Only samples after this sequence number
+    int64_t from_ms; // Only samples at or after this Unix time (ms)
+    int64_t to_ms;   // Only samples at or before this Unix time (ms)
+    int ring;        // Non-zero to continue with the history ring after the archive
+};
+
+// Creates the response streaming the samples selected by `q`, NULL on allocation failure
+struct MHD_Response *range_create_response(const struct range_query *q);
+
+#endif
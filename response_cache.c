@@ -0,0 +1,90 @@
+/**
+ * @file response_cache.c
+ * @brief Versioned cache of serialized response bodies.
+ */
+
+#include "response_cache.h"
+#include "metrics.h"
+
+/**
+ * @brief Returns a referenced body for a data version.
+ *
+ * The caller owns one reference and must drop it with cached_body_release()
+ * (normally as the MHD free callback of the response using the body).
+ *
+ * @param cache Cache to look up.
+ * @param version Current data version.
+ * @param arena_size Arena size for a rebuild: body plus builder scratch space.
+ * @param build Serializer called on a miss.
+ * @return Body, or NULL if it could not be built.
+ */
+struct cached_body *response_cache_get(struct response_cache *cache, uint64_t version,
+                                       size_t arena_size, cache_build_fn build) {
+    return response_cache_get_keyed(cache, version, 0, arena_size, build);
+}
+
+/**
+ * @brief Returns a referenced body for a data version and variant.
+ *
+ * The cache keeps the last variant built: a request for another one is a
+ * miss that replaces it.
+ *
+ * @param cache Cache to look up.
+ * @param version Current data version.
+ * @param key Variant of the body, stored in body->key before `build` runs.
+ * @param arena_size Arena size for a rebuild: body plus builder scratch space.
+ * @param build Serializer called on a miss.
+ * @return Body, or NULL if it could not be built.
+ */
+struct cached_body *response_cache_get_keyed(struct response_cache *cache, uint64_t version, uint32_t key,
+                                             size_t arena_size, cache_build_fn build) {
+    struct cached_body *body;
+    struct arena *arena;
+    struct timespec begin;
+    int ret;
+
+    pthread_mutex_lock(&cache->lock);
+
+    body = cache->current;
+    if (body != NULL && body->version == version && body->key == key) { // Hit: share the existing body
+        arena_retain(body->arena);
+        atomic_fetch_add_explicit(&cache->hits, 1, memory_order_relaxed);
+        pthread_mutex_unlock(&cache->lock);
+        return body;
+    }
+
+    atomic_fetch_add_explicit(&cache->misses, 1, memory_order_relaxed);
+    arena = arena_create(ARENA_SIZE(sizeof(*body)) + arena_size);
+    body = arena ? arena_alloc(arena, sizeof(*body)) : NULL;
+    if (body == NULL) {
+        pthread_mutex_unlock(&cache->lock);
+        return NULL;
+    }
+    body->arena = arena;
+    body->key = key;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    ret = build(arena, body);
+    metrics_observe_since(METRICS_BODY_BUILD, &begin); // Serialization time, failed builds included
+    if (ret < 0) {
+        arena_release(arena);
+        pthread_mutex_unlock(&cache->lock);
+        return NULL;
+    }
+    arena_retain(arena); // One reference for the cache, one for the caller
+
+    if (cache->current != NULL)
+        cached_body_release(cache->current); // Freed once its last response is sent
+    cache->current = body;
+
+    pthread_mutex_unlock(&cache->lock);
+    return body;
+}
+
+/**
+ * @brief Drops one reference to a body, freeing its arena with the last one.
+ *
+ * @param body Body returned by response_cache_get().
+ */
+void cached_body_release(void *body) {
+    arena_release(((struct cached_body *)body)->arena);
+}
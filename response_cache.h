@@ -0,0 +1,58 @@
+/**
+ * @file response_cache.h
+ * @brief Versioned cache of serialized response bodies.
+ *
+ * A body is rebuilt only when the data version (the sample sequence number)
+ * changes; every request in between shares the same immutable buffer. Each body
+ * lives in its own arena (arena.h), which is reference counted: the cache holds
+ * one reference and each queued MHD response holds another, dropped by
+ * cached_body_release() once MHD has sent it, so a body replaced by a newer
+ * version stays valid until its last transmission ends.
+ *
+ * A cache can also hold one of several variants of a body (e.g. one per
+ * query parameter): the variant key is part of the lookup and is passed to
+ * the builder in the body header.
+ */
+
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "arena.h"
+
+struct cached_body {
+    struct arena *arena; // Arena holding this header, the body and any scratch data
+    uint64_t version;    // Data version the body was built from
+    uint32_t key;        // Variant of the body (0 for single-variant caches)
+    size_t len;          // Body length in bytes
+    char *data;          // Body
+};
+
+struct response_cache {
+    pthread_mutex_t lock;        // Serializes lookups and rebuilds
+    struct cached_body *current; // Latest body, or NULL
+    atomic_ulong hits;           // Requests served from the cached body
+    atomic_ulong misses;         // Requests that rebuilt the body
+};
+
+#define RESPONSE_CACHE_INIT { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0 }
+
+// Builds body->data/len/version from allocations in `arena`; returns -1 if it does not fit
+typedef int (*cache_build_fn)(struct arena *arena, struct cached_body *body);
+
+// Returns a referenced body for `version`, rebuilding it in an arena of arena_size bytes if stale
+struct cached_body *response_cache_get(struct response_cache *cache, uint64_t version,
+                                       size_t arena_size, cache_build_fn build);
+
+// Like response_cache_get(), for the body variant `key` (read by the builder from body->key)
+struct cached_body *response_cache_get_keyed(struct response_cache *cache, uint64_t version, uint32_t key,
+                                             size_t arena_size, cache_build_fn build);
+
+// Drops one reference (usable as an MHD free callback)
+void cached_body_release(void *body);
+
+#endif
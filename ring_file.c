@@ -0,0 +1,127 @@
+/**
+ * @file ring_file.c
+ * @brief Crash-safe history ring kept in a memory-mapped file.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ring_file.h"
+#include "sample_codec.h"
+#include "time_util.h"
+
+/**
+ * @brief Checks a header left by a previous run.
+ *
+ * The write index must match the sequence number, or lag it by one slot if the
+ * process died between the two header stores.
+ *
+ * @return 1 if the ring can be recovered, 0 otherwise.
+ */
+static int ring_file_valid(const struct ring_file_header *hdr) {
+    if (hdr->magic != RING_FILE_MAGIC || hdr->version != RING_FILE_VERSION ||
+        hdr->capacity != MAX_HISTORY || hdr->write_index >= MAX_HISTORY)
+        return 0;
+    return hdr->write_index == hdr->sample_seq % MAX_HISTORY ||
+           (hdr->sample_seq > 0 && hdr->write_index == (hdr->sample_seq - 1) % MAX_HISTORY);
+}
+
+/**
+ * @brief Maps a ring file, recovering its contents or creating it.
+ *
+ * A missing, truncated or incompatible file (other MAX_HISTORY, other version)
+ * is reinitialized empty. The slot after the last published sample may have
+ * been half written when the previous run died, so it is marked invalid.
+ * Recovered sample times are moved onto this boot's monotonic clock, keeping
+ * their wall clock time: only the ring base changes, and it is derived from
+ * the header alone, so recovering again after a crash gives the same result.
+ * Samples older than RING_FILE_AGE_MAX_MS are dropped: the ring could come to
+ * span more than the 2^32 ms its slot times can tell apart.
+ *
+ * @param path File path (a tmpfs or SD card file).
+ * @param recovered Set to 1 if previous history was recovered, 0 if the ring is new.
+ * @return The mapping, or NULL on error (errno set).
+ */
+struct ring_file *ring_file_open(const char *path, int *recovered) {
+    struct ring_file *f;
+    struct stat st;
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    *recovered = 0;
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0 ||
+        ((size_t)st.st_size != sizeof(*f) && ftruncate(fd, sizeof(*f)) < 0)) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+
+    f = mmap(NULL, sizeof(*f), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (f == MAP_FAILED)
+        return NULL;
+
+    if ((size_t)st.st_size == sizeof(*f) && ring_file_valid(&f->hdr)) {
+        struct timespec now;
+        int64_t oldest_ms;
+
+        f->ring.base_ms = f->hdr.base_unix_ms - clock_offset_ms(); // Same Unix times, this boot's clock
+        f->hdr.write_index = (uint32_t)(f->hdr.sample_seq % MAX_HISTORY);
+        f->ring.temp[f->hdr.write_index] &= (uint16_t)~SAMPLE_VALID; // Possibly torn: drop it
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        oldest_ms = timespec_ms(&now) - RING_FILE_AGE_MAX_MS;
+        for (unsigned i = 0; i < MAX_HISTORY; i++)
+            if ((f->ring.temp[i] & SAMPLE_VALID) && ring_time(&f->ring, i) < oldest_ms)
+                f->ring.temp[i] &= (uint16_t)~SAMPLE_VALID;
+        *recovered = 1;
+        return f;
+    }
+
+    // New or unusable file: start empty, magic last. An unusable file may still
+    // carry the magic, so it is cleared (and on disk) before anything else changes.
+    __atomic_store_n(&f->hdr.magic, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    msync(f, sizeof(f->hdr), MS_SYNC);
+    memset(&f->ring, 0, sizeof(f->ring));
+    f->hdr.version = RING_FILE_VERSION;
+    f->hdr.reserved = 0;
+    f->hdr.capacity = MAX_HISTORY;
+    f->hdr.write_index = 0;
+    f->hdr.sample_seq = 0;
+    f->hdr.base_unix_ms = f->ring.base_ms + clock_offset_ms();
+    __atomic_store_n(&f->hdr.magic, RING_FILE_MAGIC, __ATOMIC_RELEASE);
+    msync(f, sizeof(*f), MS_SYNC);
+    return f;
+}
+
+/**
+ * @brief Advances the header past a stored sample.
+ *
+ * The stores are ordered after the slot write, so a process killed at any
+ * point leaves either the old or the new header over intact samples.
+ *
+ * @param f Ring file.
+ * @param sample_seq Sequence number of the sample just stored.
+ * @param clock_offset_ms Current CLOCK_REALTIME - CLOCK_MONOTONIC (time_util.h).
+ */
+void ring_file_commit(struct ring_file *f, uint64_t sample_seq, int64_t clock_offset_ms) {
+    __atomic_store_n(&f->hdr.base_unix_ms, f->ring.base_ms + clock_offset_ms, __ATOMIC_RELAXED);
+    __atomic_store_n(&f->hdr.sample_seq, sample_seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&f->hdr.write_index, (uint32_t)(sample_seq % MAX_HISTORY), __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Flushes the mapping to the storage device (blocks until written).
+ *
+ * @param f Ring file.
+ * @return 0 on success, -1 on error (errno set).
+ */
+int ring_file_sync(struct ring_file *f) {
+    return msync(f, sizeof(*f), MS_SYNC);
+}
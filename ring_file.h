@@ -0,0 +1,81 @@
+/**
+ * @file ring_file.h
+ * @brief Crash-safe history ring kept in a memory-mapped file.
+ *
+ * The file is the ring itself: the sensor thread stores each sample straight
+ * into the shared mapping, so a crash or kill loses nothing that was already
+ * published, and the page cache writes it back on its own. msync() is only
+ * needed against power loss; it is issued every `sync_every` samples to keep
+ * SD card writes (one page per sync) down.
+ *
+ * Layout, native endianness: a header followed by the struct-of-arrays ring.
+ * A sample is stored before the header is advanced past it, so on recovery the
+ * slot after the last published sample is the only one that can be torn; it
+ * is invalidated rather than trusted.
+ *
+ * Sample times are CLOCK_MONOTONIC, which restarts at every boot. They are
+ * kept in 32 bits per slot, in ms after a per-ring base, and read back modulo
+ * 2^32 against the full time of the newest sample: exact as long as the ring
+ * spans less than 2^32 ms (49 days). The header keeps the Unix time of the
+ * base as of the last commit, so recovery moves the base alone onto the new
+ * boot's monotonic clock, and drops samples too old for a ring that goes on
+ * to span MAX_HISTORY more sampling periods.
+ */
+
+#ifndef RING_FILE_H
+#define RING_FILE_H
+
+#include <stdint.h>
+
+#include "sensor_reader.h"
+
+#define RING_FILE_MAGIC 0x48545548u // "HUTH"
+#define RING_FILE_VERSION 3
+#define RING_SPAN_MAX_MS ((int64_t)MAX_HISTORY * SAMPLE_INTERVAL_MAX_MS) // Longest time a ring written nonstop covers
+#define RING_FILE_AGE_MAX_MS ((INT64_C(1) << 32) - RING_SPAN_MAX_MS) // Oldest sample recovery keeps, ms before now
+
+// History ring of raw codes (sample_codec.h), in memory or in the ring file
+struct history_ring {
+    int64_t base_ms;               // CLOCK_MONOTONIC time (ms) that the slot times count from
+    int64_t newest_ms;             // Time of the newest stored sample, ms after base_ms
+    uint32_t time_ms[MAX_HISTORY]; // Time of each sample, ms after base_ms, modulo 2^32
+    uint16_t temp[MAX_HISTORY];    // Temperature codes, sample flags in the status bits
+    uint16_t hum[MAX_HISTORY];     // Humidity codes
+};
+
+struct ring_file_header {
+    uint32_t magic;       // RING_FILE_MAGIC
+    uint16_t version;     // RING_FILE_VERSION
+    uint16_t reserved;
+    uint32_t capacity;    // Ring slots (MAX_HISTORY when written)
+    uint32_t write_index; // Slot of the next sample (sample_seq % capacity)
+    uint64_t sample_seq;  // Samples published so far
+    int64_t base_unix_ms; // Unix time (ms) of ring.base_ms at the last commit
+};
+
+struct ring_file {
+    struct ring_file_header hdr;
+    struct history_ring ring;
+};
+
+// Stores the time of the sample in `slot` (CLOCK_MONOTONIC ms, not before the newest stored)
+static inline void ring_set_time(struct history_ring *r, unsigned slot, int64_t mono_ms) {
+    r->newest_ms = mono_ms - r->base_ms;
+    r->time_ms[slot] = (uint32_t)r->newest_ms;
+}
+
+// Returns the CLOCK_MONOTONIC time (ms) of the sample in `slot`, stored less than 2^32 ms before the newest
+static inline int64_t ring_time(const struct history_ring *r, unsigned slot) {
+    return r->base_ms + r->newest_ms - (uint32_t)((uint32_t)r->newest_ms - r->time_ms[slot]);
+}
+
+// Maps (and recovers or creates) a ring file; returns NULL with errno set on error
+struct ring_file *ring_file_open(const char *path, int *recovered);
+
+// Records that sample `sample_seq` was stored (call after writing its slot), with the current clock offset
+void ring_file_commit(struct ring_file *f, uint64_t sample_seq, int64_t clock_offset_ms);
+
+// Flushes the mapping to the storage device
+int ring_file_sync(struct ring_file *f);
+
+#endif
@@ -0,0 +1,173 @@
+/**
+ * @file rollup.c
+ * @brief Fixed-size rings of min/max/sum buckets for long-term history.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "rollup.h"
+#include "segtree.h"
+#include "vecstat.h"
+
+/**
+ * @brief Binds a tier to its storage.
+ *
+ * @param t Tier to initialize.
+ * @param period_s Bucket length in seconds.
+ * @param buckets Storage for `len` buckets.
+ * @param len Ring length.
+ */
+void rollup_init(struct rollup_tier *t, unsigned period_s, struct rollup_bucket *buckets, unsigned len) {
+    t->period_s = period_s;
+    t->len = len;
+    t->buckets = buckets;
+    t->first = t->head = 0;
+    t->started = 0;
+    t->index = NULL;
+    memset(buckets, 0, len * sizeof(*buckets));
+}
+
+/**
+ * @brief Adds one sample to the bucket covering its time.
+ *
+ * @param t Tier.
+ * @param mono_s Sample time, CLOCK_MONOTONIC seconds.
+ * @param value Sample value per channel, hundredths.
+ */
+void rollup_add(struct rollup_tier *t, uint64_t mono_s, const int32_t value[ROLLUP_CHANNELS]) {
+    uint64_t bucket = mono_s / t->period_s;
+    struct rollup_bucket *b;
+
+    if (!t->started) {
+        t->started = 1;
+        t->first = t->head = bucket;
+        t->buckets[bucket % t->len].count = 0;
+    } else if (bucket > t->head) { // New period: clear the buckets between (at most one full ring)
+        uint64_t from = bucket - t->head > t->len ? bucket - t->len + 1 : t->head + 1;
+        for (uint64_t i = from; i <= bucket; i++) {
+            t->buckets[i % t->len].count = 0;
+            if (t->index != NULL)
+                segtree_set(t->index, (unsigned)(i % t->len), &t->buckets[i % t->len]);
+        }
+        t->head = bucket;
+    }
+
+    b = &t->buckets[t->head % t->len];
+    for (int c = 0; c < ROLLUP_CHANNELS; c++) {
+        if (b->count == 0 || value[c] < b->min[c])
+            b->min[c] = (int16_t)value[c];
+        if (b->count == 0 || value[c] > b->max[c])
+            b->max[c] = (int16_t)value[c];
+        b->sum[c] = (b->count == 0 ? 0 : b->sum[c]) + value[c];
+        b->sumsq[c] = (b->count == 0 ? 0 : b->sumsq[c]) + (int64_t)value[c] * value[c];
+    }
+    b->count++;
+    if (t->index != NULL)
+        segtree_set(t->index, (unsigned)(t->head % t->len), b);
+}
+
+/**
+ * @brief Copies the retained buckets, oldest first.
+ *
+ * Safe to call on a tier being modified (inside a seqlock read section): the
+ * number of buckets copied never exceeds the ring length.
+ *
+ * @param t Tier.
+ * @param out Receives up to t->len buckets.
+ * @param first Receives the bucket number of out[0].
+ * @return Number of buckets copied.
+ */
+unsigned rollup_copy(const struct rollup_tier *t, struct rollup_bucket *out, uint64_t *first) {
+    uint64_t head = t->head, oldest = t->first;
+    unsigned n, slot, tail;
+
+    if (!t->started || head < oldest) {
+        *first = head;
+        return 0;
+    }
+    if (head - oldest >= t->len)
+        oldest = head - t->len + 1;
+    n = (unsigned)(head - oldest + 1);
+    slot = (unsigned)(oldest % t->len);
+    tail = n < t->len - slot ? n : t->len - slot;
+
+    memcpy(out, t->buckets + slot, tail * sizeof(*out));
+    memcpy(out + tail, t->buckets, (n - tail) * sizeof(*out));
+    *first = oldest;
+    return n;
+}
+
+/**
+ * @brief Merges one bucket into another.
+ *
+ * @param into Aggregate to extend.
+ * @param b Bucket to add; ignored if empty.
+ */
+void rollup_merge(struct rollup_bucket *into, const struct rollup_bucket *b) {
+    if (b->count == 0)
+        return;
+    if (into->count == 0) {
+        *into = *b;
+        return;
+    }
+    for (int c = 0; c < ROLLUP_CHANNELS; c++) {
+        if (b->min[c] < into->min[c])
+            into->min[c] = b->min[c];
+        if (b->max[c] > into->max[c])
+            into->max[c] = b->max[c];
+        into->sum[c] += b->sum[c];
+        into->sumsq[c] += b->sumsq[c];
+    }
+    into->count += b->count;
+}
+
+/**
+ * @brief Merges a run of samples into a bucket in one vectorized pass per channel.
+ *
+ * @param into Aggregate to extend.
+ * @param value One array of `n` values per channel, hundredths.
+ * @param n Number of samples; 0 leaves `into` unchanged.
+ */
+void rollup_fold(struct rollup_bucket *into, const int16_t *const value[ROLLUP_CHANNELS], size_t n) {
+    struct rollup_bucket b;
+
+    if (n == 0)
+        return;
+    b.count = (uint32_t)n;
+    for (int c = 0; c < ROLLUP_CHANNELS; c++) {
+        struct vecstat s;
+        vecstat_reset(&s);
+        vecstat_i16(&s, value[c], n, INT16_MAX);
+        b.min[c] = s.min;
+        b.max[c] = s.max;
+        b.sum[c] = s.sum;
+        b.sumsq[c] = (int64_t)s.sumsq;
+    }
+    rollup_merge(into, &b);
+}
+
+/**
+ * @brief Returns the mean of a non-empty bucket, rounded half away from zero.
+ *
+ * @param b Bucket with count > 0.
+ * @param channel Channel index.
+ * @return Mean in hundredths.
+ */
+int32_t rollup_avg(const struct rollup_bucket *b, int channel) {
+    int64_t sum = b->sum[channel], n = b->count;
+    return (int32_t)((sum >= 0 ? sum + n / 2 : sum - n / 2) / n);
+}
+
+/**
+ * @brief Returns the population standard deviation of a non-empty bucket, rounded.
+ *
+ * @param b Bucket with count > 0.
+ * @param channel Channel index.
+ * @return Standard deviation in hundredths.
+ */
+int32_t rollup_stddev(const struct rollup_bucket *b, int channel) {
+    double mean = (double)b->sum[channel] / b->count;
+    double var = (double)b->sumsq[channel] / b->count - mean * mean;
+    return var > 0 ? (int32_t)lround(sqrt(var)) : 0; // Rounding can leave a tiny negative variance
+}
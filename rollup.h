@@ -0,0 +1,73 @@
+/**
+ * @file rollup.h
+ * @brief Fixed-size rings of min/max/sum buckets for long-term history.
+ *
+ * A tier covers `len` consecutive buckets of `period_s` seconds each. Bucket
+ * numbers are CLOCK_MONOTONIC seconds divided by the period, so bucket `b` lives
+ * in slot b % len and the ring never needs to move data: adding a sample either
+ * updates the head bucket or advances the head, clearing the buckets it skips.
+ * Each sample costs O(1) (clearing skipped buckets is paid once per bucket),
+ * plus O(log len) when the tier keeps a segment tree index (segtree.h) for
+ * window aggregates.
+ *
+ * Values are hundredths of a unit (°C or %RH), so a bucket holds its extremes
+ * exactly and its sums (hence mean and standard deviation) without rounding
+ * drift. rollup_fold() aggregates whole arrays with the vecstat.h kernels.
+ */
+
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct segtree;
+
+#define ROLLUP_CHANNELS 2 // Temperature, humidity
+
+#define ROLLUP_MINUTE_S 60           // Period of the minute tier
+#define ROLLUP_MINUTE_BUCKETS 2880   // 48 hours of minutes
+#define ROLLUP_HOUR_S 3600           // Period of the hour tier
+#define ROLLUP_HOUR_BUCKETS 8760     // One year of hours
+
+// Aggregate of the samples of one period, per channel
+struct rollup_bucket {
+    uint32_t count;                    // Samples in the bucket (0: no data)
+    int16_t min[ROLLUP_CHANNELS];      // Lowest value, hundredths
+    int16_t max[ROLLUP_CHANNELS];      // Highest value, hundredths
+    int64_t sum[ROLLUP_CHANNELS];      // Sum of the values, hundredths
+    int64_t sumsq[ROLLUP_CHANNELS];    // Sum of the squared values, hundredths squared
+};
+
+struct rollup_tier {
+    unsigned period_s;             // Bucket length in seconds
+    unsigned len;                  // Buckets in the ring
+    struct rollup_bucket *buckets; // Ring storage, allocated by the owner
+    uint64_t first;                // First bucket number ever written
+    uint64_t head;                 // Bucket number currently being filled
+    int started;                   // At least one sample was added
+    struct segtree *index;         // Aggregate index over the slots, or NULL
+};
+
+// Binds a tier to its storage
+void rollup_init(struct rollup_tier *t, unsigned period_s, struct rollup_bucket *buckets, unsigned len);
+
+// Adds one sample taken at `mono_s` (CLOCK_MONOTONIC seconds)
+void rollup_add(struct rollup_tier *t, uint64_t mono_s, const int32_t value[ROLLUP_CHANNELS]);
+
+// Copies the retained buckets oldest first; returns their count, *first gets the oldest bucket number
+unsigned rollup_copy(const struct rollup_tier *t, struct rollup_bucket *out, uint64_t *first);
+
+// Merges bucket `b` into `into` (empty buckets are the identity)
+void rollup_merge(struct rollup_bucket *into, const struct rollup_bucket *b);
+
+// Merges `n` samples given as one array of hundredths per channel into `into`
+void rollup_fold(struct rollup_bucket *into, const int16_t *const value[ROLLUP_CHANNELS], size_t n);
+
+// Returns the mean of a non-empty bucket in hundredths, rounded half away from zero
+int32_t rollup_avg(const struct rollup_bucket *b, int channel);
+
+// Returns the population standard deviation of a non-empty bucket in hundredths
+int32_t rollup_stddev(const struct rollup_bucket *b, int channel);
+
+#endif
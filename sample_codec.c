@@ -0,0 +1,36 @@
+/**
+ * @file sample_codec.c
+ * @brief Decoding tables of the HTU21D sample codes.
+ */
+
+#include "sample_codec.h"
+
+// Rounds n / 65536 half away from zero
+#define DIV65536(n) ((n) >= 0 ? ((n) + 32768) >> 16 : -((-(n) + 32768) >> 16))
+
+/* T = -46.85 + 175.72 * code / 65536, in hundredths: -4685 + 17572 * code / 65536 */
+#define TEMP_CENTI(i) DIV65536(17572LL * ((i) << 2) - 4685LL * 65536)
+/* RH = -6 + 125 * code / 65536, in hundredths, capped at 100 % */
+#define HUM_RAW(i) DIV65536(12500LL * ((i) << 4) - 600LL * 65536)
+#define HUM_CENTI(i) (HUM_RAW(i) > 10000 ? 10000 : HUM_RAW(i))
+
+#define T_R4(n)    TEMP_CENTI(n), TEMP_CENTI((n) + 1), TEMP_CENTI((n) + 2), TEMP_CENTI((n) + 3)
+#define T_R16(n)   T_R4(n), T_R4((n) + 4), T_R4((n) + 8), T_R4((n) + 12)
+#define T_R64(n)   T_R16(n), T_R16((n) + 16), T_R16((n) + 32), T_R16((n) + 48)
+#define T_R256(n)  T_R64(n), T_R64((n) + 64), T_R64((n) + 128), T_R64((n) + 192)
+#define T_R1K(n)   T_R256(n), T_R256((n) + 256), T_R256((n) + 512), T_R256((n) + 768)
+#define T_R4K(n)   T_R1K(n), T_R1K((n) + 1024), T_R1K((n) + 2048), T_R1K((n) + 3072)
+
+#define H_R4(n)    HUM_CENTI(n), HUM_CENTI((n) + 1), HUM_CENTI((n) + 2), HUM_CENTI((n) + 3)
+#define H_R16(n)   H_R4(n), H_R4((n) + 4), H_R4((n) + 8), H_R4((n) + 12)
+#define H_R64(n)   H_R16(n), H_R16((n) + 16), H_R16((n) + 32), H_R16((n) + 48)
+#define H_R256(n)  H_R64(n), H_R64((n) + 64), H_R64((n) + 128), H_R64((n) + 192)
+#define H_R1K(n)   H_R256(n), H_R256((n) + 256), H_R256((n) + 512), H_R256((n) + 768)
+
+const int16_t temp_centi_table[1 << TEMP_TABLE_BITS] = {
+    T_R4K(0), T_R4K(4096), T_R4K(8192), T_R4K(12288)
+};
+
+const int16_t hum_centi_table[1 << HUM_TABLE_BITS] = {
+    H_R1K(0), H_R1K(1024), H_R1K(2048), H_R1K(3072)
+};
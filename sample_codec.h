@@ -0,0 +1,42 @@
+/**
+ * @file sample_codec.h
+ * @brief Packed HTU21D sample codes and their lookup-table decoding.
+ *
+ * The history keeps what the chip delivers: 16-bit codes, at most 14 (temperature)
+ * and 12 (humidity) of which are significant. The two low bits of a temperature
+ * code are the chip's status bits, always cleared by the driver; they are reused
+ * for per-sample flags. Codes are decoded at query time to hundredths of a unit
+ * by indexing a table with the significant bits, so serializing a sample costs
+ * two loads instead of two float conversions and roundings.
+ *
+ * The tables are generated by the preprocessor from the datasheet formulas
+ * (same technique as the CRC table in htu21d.c), rounded half away from zero;
+ * humidity is capped at 100 %RH like the float conversion.
+ */
+
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include <stdint.h>
+
+#define SAMPLE_VALID 0x1   // Temperature code flag: the slot holds a sample
+#define SAMPLE_RETRIED 0x2 // Temperature code flag: a CRC mismatch forced a re-measurement
+#define SAMPLE_FLAGS 0x3   // Flag bits (the chip's status bits)
+
+#define TEMP_TABLE_BITS 14 // Significant temperature bits (code >> 2)
+#define HUM_TABLE_BITS 12  // Significant humidity bits (code >> 4)
+
+extern const int16_t temp_centi_table[1 << TEMP_TABLE_BITS];
+extern const int16_t hum_centi_table[1 << HUM_TABLE_BITS];
+
+// Temperature of a code in hundredths of °C
+static inline int32_t temp_centi(uint16_t code) {
+    return temp_centi_table[code >> (16 - TEMP_TABLE_BITS)];
+}
+
+// Relative humidity of a code in hundredths of %, capped at 100 %
+static inline int32_t hum_centi(uint16_t code) {
+    return hum_centi_table[code >> (16 - HUM_TABLE_BITS)];
+}
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * @file segtree.c
+ * @brief Segment tree of min/max/sum aggregates over a fixed ring of slots.
+ */
+
+#include <string.h>
+
+#include "segtree.h"
+
+/**
+ * @brief Binds a tree to its storage, all slots empty.
+ *
+ * @param t Tree to initialize.
+ * @param node Storage for SEGTREE_NODES(len) nodes.
+ * @param len Number of slots.
+ */
+void segtree_init(struct segtree *t, struct rollup_bucket *node, unsigned len) {
+    t->len = len;
+    t->node = node;
+    memset(node, 0, SEGTREE_NODES(len) * sizeof(*node));
+}
+
+/**
+ * @brief Sets one slot and refreshes its ancestors: O(log len).
+ *
+ * @param t Tree.
+ * @param slot Slot index (< t->len).
+ * @param leaf New aggregate of the slot.
+ */
+void segtree_set(struct segtree *t, unsigned slot, const struct rollup_bucket *leaf) {
+    unsigned i = slot + t->len;
+
+    t->node[i] = *leaf;
+    for (i >>= 1; i >= 1; i >>= 1) {
+        t->node[i] = t->node[2 * i];
+        rollup_merge(&t->node[i], &t->node[2 * i + 1]);
+    }
+}
+
+/**
+ * @brief Recomputes every inner node from the leaves: O(len).
+ */
+void segtree_build(struct segtree *t) {
+    for (unsigned i = t->len - 1; i >= 1; i--) {
+        t->node[i] = t->node[2 * i];
+        rollup_merge(&t->node[i], &t->node[2 * i + 1]);
+    }
+}
+
+/**
+ * @brief Merges the aggregate of a range of slots: O(log len).
+ *
+ * Safe to call on a tree being modified (inside a seqlock read section):
+ * indices stay in bounds whatever the node contents.
+ *
+ * @param t Tree.
+ * @param lo First slot.
+ * @param hi Slot after the last one (lo <= hi <= t->len).
+ * @param out Aggregate to merge into.
+ */
+void segtree_query(const struct segtree *t, unsigned lo, unsigned hi, struct rollup_bucket *out) {
+    for (lo += t->len, hi += t->len; lo < hi; lo >>= 1, hi >>= 1) {
+        if (lo & 1)
+            rollup_merge(out, &t->node[lo++]);
+        if (hi & 1)
+            rollup_merge(out, &t->node[--hi]);
+    }
+}
+
+/**
+ * @brief Merges the aggregate of the `n` slots ending at `last`, wrapping around.
+ *
+ * @param t Tree.
+ * @param last Newest slot of the window.
+ * @param n Window length in slots (clamped to t->len).
+ * @param out Aggregate to merge into.
+ */
+void segtree_query_ring(const struct segtree *t, unsigned last, unsigned n, struct rollup_bucket *out) {
+    if (n > t->len)
+        n = t->len;
+    if (n <= last + 1) {
+        segtree_query(t, last + 1 - n, last + 1, out);
+    } else { // Wraps: tail of the storage, then its head
+        segtree_query(t, t->len - (n - last - 1), t->len, out);
+        segtree_query(t, 0, last + 1, out);
+    }
+}
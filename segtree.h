@@ -0,0 +1,41 @@
+/**
+ * @file segtree.h
+ * @brief Segment tree of min/max/sum aggregates over a fixed ring of slots.
+ *
+ * Iterative layout: the `len` leaves live in node[len .. 2*len) and node[i]
+ * aggregates node[2*i] and node[2*i+1], for any `len` (the merge is
+ * commutative). Updating one slot and querying a range of slots both touch
+ * O(log len) nodes, so window statistics over a ring no longer scan it.
+ *
+ * Nodes are rollup buckets (rollup.h): count, min, max and sum per channel;
+ * a bucket with count 0 is the identity.
+ */
+
+#ifndef SEGTREE_H
+#define SEGTREE_H
+
+#include "rollup.h"
+
+#define SEGTREE_NODES(len) (2 * (len)) // Node storage for `len` slots
+
+struct segtree {
+    unsigned len;               // Slots (leaves)
+    struct rollup_bucket *node; // SEGTREE_NODES(len) nodes, allocated by the owner
+};
+
+// Binds a tree to its storage, all slots empty
+void segtree_init(struct segtree *t, struct rollup_bucket *node, unsigned len);
+
+// Sets one slot and refreshes its ancestors
+void segtree_set(struct segtree *t, unsigned slot, const struct rollup_bucket *leaf);
+
+// Recomputes every inner node after the leaves were written directly
+void segtree_build(struct segtree *t);
+
+// Merges the aggregate of slots [lo, hi) into *out
+void segtree_query(const struct segtree *t, unsigned lo, unsigned hi, struct rollup_bucket *out);
+
+// Merges the aggregate of the `n` slots ending at slot `last` (wrapping around) into *out
+void segtree_query_ring(const struct segtree *t, unsigned last, unsigned n, struct rollup_bucket *out);
+
+#endif
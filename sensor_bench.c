@@ -0,0 +1,1646 @@
+/**
+ * @file sensor_bench.c
+ * @brief Benchmarks (-b) and self-checks (-c) run from the command line.
+ *
+ * The benchmark runs these sections in order, one table each:
+ * - Acquisition: complete measurement cycles for every resolution in each
+ *   HTU21D mode, blocking on clock_nanosleep() until each deadline. Bus
+ *   transactions (one syscall each on i2c-dev), NACKed polls, wall time per
+ *   sample and samples per second. Against the simulated sensor (-s) this
+ *   runs on any Linux box.
+ * - Sequence lock: 1 to LOCK_READERS_MAX readers copying a history ring while
+ *   a writer updates it (seqlock.h), against the same workload under a
+ *   pthread mutex. Reader throughput, writer latency and torn copies.
+ * - History serialization: a full ring per ring and per value, decoded
+ *   through the sample_codec.h tables, through the float CALC_TEMP/CALC_HUM
+ *   conversion used before, and with the snprintf()/strcat() serializer
+ *   json_writer.h replaced.
+ * - Body allocation: /data and /history bodies built on concurrent threads in
+ *   per-response arenas (arena.h) and, as before, on the stack with a
+ *   malloc()ed copy. Allocations, stack and heap bytes per body in flight and
+ *   resident set growth.
+ * - /history formats: size and encoding time of the JSON and binary
+ *   (history_bin.h) bodies, plain and gzipped at the server's level (gzip.h).
+ * - Dashboard load: this program started as the server (-s -p) with 1, 10 and
+ *   100 HTTP dashboards over loopback, polling /data and /history once per
+ *   sample as the dashboard used to, then holding the /stream Server-Sent
+ *   Events (stream.h). Server CPU time (/proc) and bytes on the wire per
+ *   sample.
+ * - Archive codec: a day of synthetic 1 Hz samples compressed into archive
+ *   blocks (tsblock.h). Bytes per sample, encode and decode throughput
+ *   (against the 12-byte uncompressed sample: 64-bit timestamp and two codes)
+ *   and the archive size for a year.
+ * - Statistics kernels: throughput of every vectorized kernel (vecstat.h)
+ *   this CPU supports.
+ * - Window statistics: min/max/sums over the last k samples by a scalar scan,
+ *   a vectorized scan and the segment tree (segtree.h) queries behind /stats,
+ *   over a million samples, then the vectorized scan and the tree on a ring
+ *   of MAX_HISTORY samples as /stats uses it.
+ * - WebSocket fan-out: sample frames pushed to loopback subscribers through
+ *   /ws (websocket.h), as fast as possible and paced. Frames per second,
+ *   latency and frames dropped.
+ * - Metrics: latency observations from several threads at once into the
+ *   per-thread /metrics shards (metrics.h) and into one shared histogram.
+ *
+ * The checks print ok or FAIL for each of:
+ * - every vectorized statistics kernel against the scalar one, on random and
+ *   edge-case data;
+ * - a process writing the history ring file (ring_file.h) killed with SIGKILL
+ *   at arbitrary points: every sample the reopened file claims must be intact
+ *   and the possibly torn slot dropped, and an incompatible file must be
+ *   reinitialized empty;
+ * - observations recorded from several threads at once, every one of them
+ *   merged by a /metrics scrape.
+ */
+
+#include <dirent.h>
+#include <limits.h>
+#include <malloc.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <signal.h>
+
+#include "sensor_bench.h"
+#include "sample_codec.h"
+#include "json_writer.h"
+#include "tsblock.h"
+#include "segtree.h"
+#include "vecstat.h"
+#include "history_bin.h"
+#include "gzip.h"
+#include "websocket.h"
+#include "metrics.h"
+#include "seqlock.h"
+#include "arena.h"
+#include "ring_file.h"
+
+#define DECODE_ROUNDS 2000 // Full-ring serializations per decoder
+#define FORMAT_ROUNDS 2000 // /history bodies encoded per format
+#define CODEC_SAMPLES 86400 // One day at 1 s
+#define CODEC_BLOCKS ((CODEC_SAMPLES + TSBLOCK_SAMPLES - 1) / TSBLOCK_SAMPLES)
+#define CODEC_ROUNDS 20 // Encode and decode passes over the day
+#define CODEC_RAW_BYTES 12 // Uncompressed sample: int64 timestamp, two 16-bit codes
+#define VECSTAT_VALUES 4096 // Values per kernel call in the throughput test
+#define VECSTAT_ROUNDS 20000 // Kernel calls per implementation
+#define WINDOW_SAMPLES (1u << 20) // Ring of the window statistics benchmark (~12 days at 1 s)
+#define WINDOW_SCAN_VALUES (1u << 26) // Values scanned per window size
+#define WINDOW_QUERIES 200000 // Index queries per window size
+#define LOCK_READERS_MAX 8 // Most concurrent readers of the lock benchmark
+#define LOCK_RUN_MS 300 // Duration of one lock benchmark run
+#define LOCK_WRITE_PERIOD_US 200 // Writer cadence of the lock benchmark, far above the sampling rate
+#define ALLOC_THREADS 4 // Most concurrent builders of the allocation benchmark
+#define ALLOC_INFLIGHT 64 // Bodies each builder holds at once, like responses still being sent
+#define ALLOC_ROUNDS 200 // Fill-and-drain cycles timed per builder
+#define ALLOC_SMALL_MAX 1024 // /data stack buffer before arenas, now its arena (SMALL_BODY_MAX)
+#define ALLOC_HISTORY_MAX (64 + 2 * MAX_HISTORY * (JSON_CENTI_MAX + 1)) // /history values body
+#define LOAD_CLIENTS_MAX 100 // Most dashboards of the load benchmark
+#define LOAD_INTERVAL_MS 100 // Sampling period of the server under load
+#define LOAD_SAMPLES 30 // Sampling periods measured per load benchmark run
+#define LOAD_START_MS 3000 // Longest wait for the server to listen, or for the dashboards to subscribe
+#define LOAD_HEAD_MAX 2048 // Longest response head a dashboard accepts
+#define RECOVERY_KILLS 50 // Writer processes killed by the ring file recovery check
+
+// Ring of codes shared by both decoders, filled with a ramp over the valid range
+static uint16_t bench_temp[MAX_HISTORY], bench_hum[MAX_HISTORY];
+static char bench_out[2 * MAX_HISTORY * (JSON_CENTI_MAX + 1)];
+
+// Full ring with sample times, encoded as either /history body
+static uint16_t format_temp[MAX_HISTORY], format_hum[MAX_HISTORY];
+static int64_t format_time[MAX_HISTORY];
+static char format_json[64 + MAX_HISTORY * (2 * (JSON_CENTI_MAX + 1) + JSON_U64_MAX + 1)];
+static uint8_t format_bin[HISTORY_BIN_SIZE(MAX_HISTORY)];
+static uint8_t format_gz[GZIP_BOUND(sizeof(format_json))];
+
+// Synthetic day of samples and its compressed blocks
+static uint16_t codec_temp[CODEC_SAMPLES], codec_hum[CODEC_SAMPLES];
+static struct tsblock_encoder codec_blocks[CODEC_BLOCKS];
+static volatile uint32_t codec_sink;
+
+/**
+ * @brief Runs `samples` measurement cycles in one mode and resolution.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int bench_mode(const struct sensor_config *cfg, enum htu21d_mode mode,
+                      enum htu21d_resolution res, int samples) {
+    struct i2c_transport bus;
+    struct htu21d dev;
+    struct timespec begin, end, now;
+    unsigned long polls = 0;
+
+    if (sensor_open_transport(&bus, cfg) < 0) {
+        perror("I2C open error");
+        return -1;
+    }
+    htu21d_init(&dev, &bus, mode);
+    if (htu21d_set_resolution(&dev, res) < 0) {
+        perror("HTU21D resolution error");
+        i2c_close(&bus);
+        return -1;
+    }
+    bus.transactions = 0; // Count measurement traffic only
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int i = 0; i < samples; i++) {
+        int ret;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (htu21d_start(&dev, &now) < 0) {
+            perror("HTU21D command error");
+            i2c_close(&bus);
+            return -1;
+        }
+        do {
+            enum htu21d_state before = dev.state;
+
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &dev.deadline, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            ret = htu21d_step(&dev, &now);
+            if (ret == HTU21D_BUSY && dev.state == before)
+                polls++; // The chip NACKed: conversion not finished yet
+        } while (ret == HTU21D_BUSY);
+        if (ret < 0) {
+            perror("HTU21D read error");
+            i2c_close(&bus);
+            return -1;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed_ms = timespec_diff_ns(&end, &begin) / 1e6;
+    char label[16];
+    snprintf(label, sizeof(label), "RH%d/T%d", htu21d_hum_bits(res), htu21d_temp_bits(res));
+    printf("%-9s %-8s %8d %14.2f %10.2f %12.3f %10.1f\n", label,
+           mode == HTU21D_HOLD ? "hold" : "no-hold", samples,
+           (double)bus.transactions / samples, (double)polls / samples,
+           elapsed_ms / samples, samples * 1000.0 / elapsed_ms);
+
+    i2c_close(&bus);
+    return 0;
+}
+
+// History-like data of the lock benchmark: the writer stamps slot (seq - 1) with seq
+static struct {
+    seqlock_t seqlock;
+    pthread_mutex_t mutex;
+    uint64_t seq;
+    uint16_t temp[MAX_HISTORY], hum[MAX_HISTORY];
+} lock_data = { .seqlock = SEQLOCK_INIT, .mutex = PTHREAD_MUTEX_INITIALIZER };
+static atomic_int lock_stop;
+
+struct lock_reader {
+    int use_mutex;       // Copy under the mutex instead of the sequence lock
+    unsigned long reads; // Copies made
+    unsigned long torn;  // Copies mixing two updates
+};
+
+struct lock_writer {
+    int use_mutex;
+    unsigned long writes;
+    long long total_ns, max_ns; // Wake-up to end of update
+};
+
+/**
+ * @brief Lock benchmark reader: copies the ring until told to stop, checking each copy.
+ */
+static void *lock_read_loop(void *arg) {
+    struct lock_reader *r = arg;
+    uint16_t temp[MAX_HISTORY], hum[MAX_HISTORY];
+
+    while (!atomic_load_explicit(&lock_stop, memory_order_relaxed)) {
+        uint64_t seq;
+
+        if (r->use_mutex) {
+            pthread_mutex_lock(&lock_data.mutex);
+            seq = lock_data.seq;
+            memcpy(temp, lock_data.temp, sizeof(temp));
+            memcpy(hum, lock_data.hum, sizeof(hum));
+            pthread_mutex_unlock(&lock_data.mutex);
+        } else {
+            unsigned lock_seq;
+            do {
+                lock_seq = seqlock_read_begin(&lock_data.seqlock);
+                seq = lock_data.seq;
+                memcpy(temp, lock_data.temp, sizeof(temp));
+                memcpy(hum, lock_data.hum, sizeof(hum));
+            } while (seqlock_read_retry(&lock_data.seqlock, lock_seq));
+        }
+        if (seq > 0 && (temp[(seq - 1) % MAX_HISTORY] != (uint16_t)seq ||
+                        hum[(seq - 1) % MAX_HISTORY] != (uint16_t)~seq))
+            r->torn++;
+        r->reads++;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Lock benchmark writer: updates one slot every LOCK_WRITE_PERIOD_US until told to stop.
+ */
+static void *lock_write_loop(void *arg) {
+    struct lock_writer *w = arg;
+    struct timespec next, now;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!atomic_load_explicit(&lock_stop, memory_order_relaxed)) {
+        long long ns;
+        int slot;
+
+        timespec_add_ns(&next, LOCK_WRITE_PERIOD_US * 1000LL);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (w->use_mutex)
+            pthread_mutex_lock(&lock_data.mutex);
+        else
+            seqlock_write_begin(&lock_data.seqlock);
+        slot = (int)(lock_data.seq % MAX_HISTORY);
+        lock_data.seq++;
+        lock_data.temp[slot] = (uint16_t)lock_data.seq;
+        lock_data.hum[slot] = (uint16_t)~lock_data.seq;
+        if (w->use_mutex)
+            pthread_mutex_unlock(&lock_data.mutex);
+        else
+            seqlock_write_end(&lock_data.seqlock);
+        clock_gettime(CLOCK_MONOTONIC, &next); // Lateness does not accumulate into later periods
+        ns = timespec_diff_ns(&next, &now);
+        w->writes++;
+        w->total_ns += ns;
+        if (ns > w->max_ns)
+            w->max_ns = ns;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs one lock benchmark: a writer and `readers` readers for LOCK_RUN_MS.
+ *
+ * @return 0 on success, -1 if a thread could not start.
+ */
+static int lock_run(int use_mutex, int readers) {
+    struct lock_reader r[LOCK_READERS_MAX];
+    struct lock_writer w = { .use_mutex = use_mutex };
+    pthread_t tid[LOCK_READERS_MAX + 1];
+    struct timespec run = { LOCK_RUN_MS / 1000, (LOCK_RUN_MS % 1000) * 1000000L };
+    unsigned long reads = 0, torn = 0;
+    int started = 0;
+
+    atomic_store(&lock_stop, 0);
+    for (int i = 0; i < readers; i++) {
+        r[i] = (struct lock_reader){ .use_mutex = use_mutex };
+        if (pthread_create(&tid[started], NULL, lock_read_loop, &r[i]) != 0)
+            break;
+        started++;
+    }
+    if (started == readers && pthread_create(&tid[started], NULL, lock_write_loop, &w) == 0)
+        started++;
+    if (started == readers + 1)
+        nanosleep(&run, NULL);
+    atomic_store(&lock_stop, 1);
+    for (int i = 0; i < started; i++)
+        pthread_join(tid[i], NULL);
+    if (started < readers + 1)
+        return -1;
+
+    for (int i = 0; i < readers; i++) {
+        reads += r[i].reads;
+        torn += r[i].torn;
+    }
+    printf("%-9s %8d %12.0f %12lu %12.2f %12.1f %8lu\n", use_mutex ? "mutex" : "seqlock", readers,
+           reads * 1000.0 / LOCK_RUN_MS, w.writes, w.writes ? w.total_ns / 1000.0 / w.writes : 0.0,
+           w.max_ns / 1000.0, torn);
+    return 0;
+}
+
+/**
+ * @brief Stresses the sequence lock with concurrent readers, against a mutex baseline.
+ *
+ * Readers copy the whole ring back to back, like /history rebuilds under load;
+ * the writer updates one slot every LOCK_WRITE_PERIOD_US, far more often than
+ * the sensor thread. With the mutex the writer waits for any reader holding
+ * the lock (for a whole time slice if that reader is preempted); with the
+ * sequence lock it never waits, and readers retry instead.
+ */
+static void bench_lock(void) {
+    printf("\n%-9s %8s %12s %12s %12s %12s %8s\n", "lock", "readers", "reads/s", "writes",
+           "write us", "write max", "torn");
+    for (int readers = 1; readers <= LOCK_READERS_MAX; readers *= 2)
+        for (int use_mutex = 0; use_mutex <= 1; use_mutex++)
+            if (lock_run(use_mutex, readers) < 0) {
+                perror("lock benchmark thread");
+                return;
+            }
+}
+
+/**
+ * @brief Serializes the benchmark ring with the lookup tables.
+ *
+ * @return Bytes written.
+ */
+static size_t serialize_table(void) {
+    char *p = bench_out;
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        p = json_put_centi(p, temp_centi(bench_temp[i]));
+        *p++ = ',';
+    }
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        p = json_put_centi(p, hum_centi(bench_hum[i]));
+        *p++ = ',';
+    }
+    return (size_t)(p - bench_out);
+}
+
+/**
+ * @brief Serializes the benchmark ring with the float conversion macros.
+ *
+ * @return Bytes written.
+ */
+static size_t serialize_float(void) {
+    char *p = bench_out;
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        p = json_put_centi(p, json_centi(CALC_TEMP(bench_temp[i])));
+        *p++ = ',';
+    }
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        float hum = CALC_HUM(bench_hum[i]);
+        p = json_put_centi(p, json_centi(hum > 100 ? 100 : hum));
+        *p++ = ',';
+    }
+    return (size_t)(p - bench_out);
+}
+
+/**
+ * @brief Serializes the benchmark ring like /history did before json_writer.h.
+ *
+ * Float conversion, snprintf("%.2f") into a scratch buffer and strcat() onto
+ * the body, which rescans the whole body on every append.
+ *
+ * @return Bytes written.
+ */
+static size_t serialize_snprintf(void) {
+    bench_out[0] = '\0';
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        char num[32];
+        snprintf(num, sizeof(num), "%.2f", CALC_TEMP(bench_temp[i]));
+        strcat(bench_out, num);
+        strcat(bench_out, ",");
+    }
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        char num[32];
+        float hum = CALC_HUM(bench_hum[i]);
+        snprintf(num, sizeof(num), "%.2f", hum > 100 ? 100 : hum);
+        strcat(bench_out, num);
+        strcat(bench_out, ",");
+    }
+    return strlen(bench_out);
+}
+
+/**
+ * @brief Times full-ring serializations with one decoder and formatter.
+ *
+ * @param rounds Serializations to time.
+ */
+static void bench_decode(const char *name, size_t (*serialize)(void), int rounds) {
+    struct timespec begin, end;
+    volatile size_t sink = 0; // Keeps the loop from being optimized away
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int r = 0; r < rounds; r++)
+        sink += serialize();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double ns = (double)timespec_diff_ns(&end, &begin);
+    printf("%-9s %8d %12.2f %10.1f %14.1f\n", name, MAX_HISTORY, ns / rounds / 1000.0,
+           ns / rounds / (2.0 * MAX_HISTORY), 2.0 * MAX_HISTORY * rounds * 1000.0 / ns);
+    (void)sink;
+}
+
+/**
+ * @brief Compares table and float decoding of a full history ring, and the old snprintf/strcat path.
+ */
+static void bench_history_decode(void) {
+    for (int i = 0; i < MAX_HISTORY; i++) { // Codes as stored: status bits clear, humidity 12-bit
+        bench_temp[i] = (uint16_t)((i * 65536 / MAX_HISTORY) & 0xFFFC);
+        bench_hum[i] = (uint16_t)((i * 65536 / MAX_HISTORY) & 0xFFF0);
+    }
+
+    printf("\n%-9s %8s %12s %10s %14s\n", "decoder", "samples", "us/ring", "ns/value", "Mvalues/s");
+    bench_decode("table", serialize_table, DECODE_ROUNDS);
+    bench_decode("float", serialize_float, DECODE_ROUNDS);
+    bench_decode("snprintf", serialize_snprintf, DECODE_ROUNDS / 10); // Quadratic: fewer rounds
+}
+
+// /data-like body formatted by the allocation benchmark
+static size_t alloc_format_small(char *buf, size_t cap, unsigned n) {
+    return (size_t)snprintf(buf, cap, "{\"temperature\": %d.%02d, \"humidity\": %d.%02d, \"seq\": %u}",
+                            20 + (int)(n % 10), (int)(n % 100), 40 + (int)(n % 20), (int)(n % 97), n);
+}
+
+/**
+ * @brief /data before arenas: stack buffer copied by MHD_RESPMEM_MUST_COPY (one malloc() and memcpy()).
+ */
+static void *alloc_small_copy(unsigned *allocs) {
+    char buf[ALLOC_SMALL_MAX];
+    size_t len = alloc_format_small(buf, sizeof(buf), *allocs);
+    char *copy = malloc(len);
+
+    (*allocs)++;
+    if (copy != NULL)
+        memcpy(copy, buf, len);
+    return copy;
+}
+
+/**
+ * @brief /data now: body formatted in place in a single-use arena of SMALL_BODY_MAX.
+ */
+static void *alloc_small_arena(unsigned *allocs) {
+    struct arena *arena = arena_create(ARENA_SIZE(ALLOC_SMALL_MAX));
+    char *buf;
+
+    (*allocs)++;
+    if (arena == NULL)
+        return NULL;
+    buf = arena_alloc(arena, ALLOC_SMALL_MAX);
+    alloc_format_small(buf, ALLOC_SMALL_MAX, *allocs);
+    return arena;
+}
+
+/**
+ * @brief /history before arenas: float ring snapshot on the stack, body in a malloc()ed buffer.
+ */
+static void *alloc_history_copy(unsigned *allocs) {
+    float temp[MAX_HISTORY], hum[MAX_HISTORY];
+    char *body = malloc(ALLOC_HISTORY_MAX);
+    char *p = body;
+
+    (*allocs)++;
+    if (body == NULL)
+        return NULL;
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        temp[i] = CALC_TEMP(bench_temp[i]);
+        hum[i] = CALC_HUM(bench_hum[i]);
+    }
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        p = json_put_centi(p, json_centi(temp[i]));
+        *p++ = ',';
+    }
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        p = json_put_centi(p, json_centi(hum[i] > 100 ? 100 : hum[i]));
+        *p++ = ',';
+    }
+    return body;
+}
+
+/**
+ * @brief /history now: code snapshot and body both in one arena.
+ */
+static void *alloc_history_arena(unsigned *allocs) {
+    struct arena *arena = arena_create(2 * ARENA_SIZE(MAX_HISTORY * sizeof(uint16_t)) +
+                                       ARENA_SIZE(ALLOC_HISTORY_MAX));
+    uint16_t *temp, *hum;
+    char *p;
+
+    (*allocs)++;
+    if (arena == NULL)
+        return NULL;
+    temp = arena_alloc(arena, MAX_HISTORY * sizeof(uint16_t));
+    hum = arena_alloc(arena, MAX_HISTORY * sizeof(uint16_t));
+    p = arena_alloc(arena, ALLOC_HISTORY_MAX);
+    memcpy(temp, bench_temp, MAX_HISTORY * sizeof(uint16_t));
+    memcpy(hum, bench_hum, MAX_HISTORY * sizeof(uint16_t));
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        p = json_put_centi(p, temp_centi(temp[i]));
+        *p++ = ',';
+    }
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        p = json_put_centi(p, hum_centi(hum[i]));
+        *p++ = ',';
+    }
+    return arena;
+}
+
+// One way of building a response body, as compared by the allocation benchmark
+struct alloc_path {
+    const char *body;             // Endpoint whose body is built
+    const char *name;             // Old copy path or arena
+    size_t stack;                 // Stack bytes of one build
+    void *(*build)(unsigned *allocs); // Builds one body and returns its owner (NULL on failure)
+    void (*release)(void *owner); // Frees the body once it has been "sent"
+};
+
+struct alloc_builder {
+    const struct alloc_path *path;
+    unsigned allocs;   // Allocations made by the timed builds
+    long long ns;      // CPU time of the timed builds and releases
+};
+
+static atomic_int alloc_holding; // Builders holding a full set of bodies
+static atomic_int alloc_drain;   // Set once the heap has been measured
+
+/**
+ * @brief Allocation benchmark builder: ALLOC_ROUNDS fills and drains of ALLOC_INFLIGHT
+ * bodies, then one more fill held until the heap has been measured.
+ */
+static void *alloc_build_loop(void *arg) {
+    struct alloc_builder *b = arg;
+    void *owners[ALLOC_INFLIGHT];
+    unsigned held = 0;
+    struct timespec begin, end, wait = { 0, 1000000 };
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+    for (int r = 0; r < ALLOC_ROUNDS; r++) {
+        for (int i = 0; i < ALLOC_INFLIGHT; i++)
+            owners[i] = b->path->build(&b->allocs);
+        for (int i = 0; i < ALLOC_INFLIGHT; i++)
+            if (owners[i] != NULL)
+                b->path->release(owners[i]);
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    b->ns = timespec_diff_ns(&end, &begin);
+
+    for (int i = 0; i < ALLOC_INFLIGHT; i++) // Responses still being sent to slow clients
+        owners[i] = b->path->build(&held);
+    atomic_fetch_add(&alloc_holding, 1);
+    while (!atomic_load(&alloc_drain))
+        nanosleep(&wait, NULL);
+    for (int i = 0; i < ALLOC_INFLIGHT; i++)
+        if (owners[i] != NULL)
+            b->path->release(owners[i]);
+    return NULL;
+}
+
+/**
+ * @brief Heap bytes in use, mmap()ed chunks included.
+ */
+static long long alloc_heap_bytes(void) {
+    struct mallinfo2 mi = mallinfo2();
+    return (long long)(mi.uordblks + mi.hblkhd);
+}
+
+/**
+ * @brief Resident set size in KiB, or 0 if /proc is not readable.
+ */
+static long alloc_rss_kb(void) {
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+
+    if (f == NULL)
+        return 0;
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+        resident = 0;
+    fclose(f);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * @brief Runs one allocation benchmark: `threads` builders of one path.
+ *
+ * @return 0 on success, -1 if a thread could not start.
+ */
+static int alloc_run(const struct alloc_path *path, int threads) {
+    struct alloc_builder b[ALLOC_THREADS];
+    pthread_t tid[ALLOC_THREADS];
+    struct timespec wait = { 0, 1000000 };
+    long long heap, ns = 0;
+    unsigned long allocs = 0;
+    long rss;
+    int started = 0;
+
+    malloc_trim(0); // Return what the previous run freed, so RSS growth is this run's
+    heap = alloc_heap_bytes();
+    rss = alloc_rss_kb();
+    atomic_store(&alloc_holding, 0);
+    atomic_store(&alloc_drain, 0);
+    for (int i = 0; i < threads; i++) {
+        b[i] = (struct alloc_builder){ .path = path };
+        if (pthread_create(&tid[started], NULL, alloc_build_loop, &b[i]) != 0)
+            break;
+        started++;
+    }
+    while (started == threads && atomic_load(&alloc_holding) < threads)
+        nanosleep(&wait, NULL);
+    heap = alloc_heap_bytes() - heap;
+    rss = alloc_rss_kb() - rss;
+    atomic_store(&alloc_drain, 1);
+    for (int i = 0; i < started; i++)
+        pthread_join(tid[i], NULL);
+    if (started < threads)
+        return -1;
+
+    for (int i = 0; i < threads; i++) {
+        allocs += b[i].allocs;
+        ns += b[i].ns;
+    }
+    unsigned long builds = (unsigned long)threads * ALLOC_ROUNDS * ALLOC_INFLIGHT;
+    printf("%-9s %-6s %8d %10.0f %12.2f %10zu %12.0f %10ld\n", path->body, path->name, threads,
+           (double)ns / builds, (double)allocs / builds, path->stack,
+           (double)heap / (threads * ALLOC_INFLIGHT), rss);
+    return 0;
+}
+
+/**
+ * @brief Compares per-response arenas against the stack buffer and copy they replaced.
+ *
+ * Builders on 1 to ALLOC_THREADS threads create and free bodies as requests
+ * would, then each holds ALLOC_INFLIGHT of them, like responses still being
+ * sent, while heap use and resident set growth are measured. Allocations are
+ * those of the body; MHD's own response object costs the same on both paths.
+ */
+static void bench_alloc(void) {
+    static const struct alloc_path paths[] = {
+        { "/data", "copy", ALLOC_SMALL_MAX, alloc_small_copy, free },
+        { "/data", "arena", 0, alloc_small_arena, arena_release },
+        { "/history", "copy", 2 * MAX_HISTORY * sizeof(float), alloc_history_copy, free },
+        { "/history", "arena", 0, alloc_history_arena, arena_release },
+    };
+
+    printf("\n%-9s %-6s %8s %10s %12s %10s %12s %10s\n", "body", "path", "threads", "cpu ns",
+           "allocs/body", "stack B", "heap B/body", "RSS +KiB");
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++)
+        for (int threads = 1; threads <= ALLOC_THREADS; threads *= 2)
+            if (alloc_run(&paths[i], threads) < 0) {
+                perror("allocation benchmark thread");
+                return;
+            }
+}
+
+/**
+ * @brief Encodes the ring as the JSON /history body (same layout as the server's).
+ *
+ * @return Bytes written.
+ */
+static size_t format_encode_json(void) {
+    char *p = json_put_lit(format_json, "{\"seq\": ");
+    p = json_put_u64(p, MAX_HISTORY);
+    p = json_put_lit(p, ", \"time\": [");
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        if (i > 0)
+            *p++ = ',';
+        p = json_put_u64(p, (uint64_t)format_time[i]);
+    }
+    p = json_put_lit(p, "],\"temperature\": [");
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        if (i > 0)
+            *p++ = ',';
+        p = json_put_centi(p, temp_centi(format_temp[i]));
+    }
+    p = json_put_lit(p, "],\"humidity\": [");
+    for (int i = 0; i < MAX_HISTORY; i++) {
+        if (i > 0)
+            *p++ = ',';
+        p = json_put_centi(p, hum_centi(format_hum[i]));
+    }
+    p = json_put_lit(p, "]}");
+    return (size_t)(p - format_json);
+}
+
+/**
+ * @brief Encodes the ring as the binary /history body.
+ *
+ * @return Bytes written.
+ */
+static size_t format_encode_bin(void) {
+    return history_bin_encode(format_bin, MAX_HISTORY, format_temp, format_hum, format_time, MAX_HISTORY);
+}
+
+/**
+ * @brief Times FORMAT_ROUNDS encodings of a full ring in each /history format,
+ * then FORMAT_ROUNDS / 10 gzip compressions of each body.
+ */
+static void bench_history_format(void) {
+    static const struct {
+        const char *name;
+        size_t (*encode)(void);
+        const void *body;
+    } formats[] = { { "json", format_encode_json, format_json }, { "binary", format_encode_bin, format_bin } };
+
+    for (int i = 0; i < MAX_HISTORY; i++) { // A ring of 1 Hz samples near room conditions
+        format_temp[i] = (uint16_t)(((25678 + (i * 37) % 600) & 0xFFFC) | SAMPLE_VALID);
+        format_hum[i] = (uint16_t)((26739 + (i * 53) % 1500) & 0xFFF0);
+        format_time[i] = 1700000000000LL + i * 1000LL;
+    }
+
+    printf("\n%-9s %8s %12s %12s %12s %12s\n", "format", "samples", "bytes", "us/body", "gzip bytes", "us/gzip");
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        struct timespec begin, end;
+        volatile size_t sink = 0;
+        size_t bytes = formats[f].encode(), gz_bytes;
+        double us;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (int r = 0; r < FORMAT_ROUNDS; r++)
+            sink += formats[f].encode();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        us = timespec_diff_ns(&end, &begin) / 1000.0 / FORMAT_ROUNDS;
+
+        gz_bytes = gzip_compress(format_gz, sizeof(format_gz), formats[f].body, bytes, GZIP_LEVEL_DYNAMIC);
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (int r = 0; r < FORMAT_ROUNDS / 10; r++)
+            sink += gzip_compress(format_gz, sizeof(format_gz), formats[f].body, bytes, GZIP_LEVEL_DYNAMIC);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        printf("%-9s %8d %12zu %12.2f %12zu %12.2f\n", formats[f].name, MAX_HISTORY, bytes, us, gz_bytes,
+               timespec_diff_ns(&end, &begin) / 1000.0 / (FORMAT_ROUNDS / 10));
+        (void)sink;
+    }
+}
+
+// Step of a load benchmark dashboard: the response it is reading, if any
+enum load_step { LOAD_IDLE, LOAD_DATA, LOAD_HISTORY, LOAD_STREAM };
+
+// Dashboard of the load benchmark: one keep-alive HTTP/1.1 connection to the server
+struct load_client {
+    int fd;
+    enum load_step step;
+    long long body_left;     // Body bytes still expected, -1 while reading the response head
+    size_t head_len;         // Head bytes buffered so far
+    char head[LOAD_HEAD_MAX];
+};
+
+// Request of a dashboard, as a browser sends it
+static const char load_request_fmt[] =
+    "GET %s HTTP/1.1\r\nHost: sensor.local\r\nUser-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) "
+    "Gecko/20100101 Firefox/128.0\r\nAccept: */*\r\nAccept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate\r\nReferer: http://sensor.local/\r\nConnection: keep-alive\r\n\r\n";
+
+/**
+ * @brief Sends the request for `step` on a dashboard's connection.
+ *
+ * @return Bytes sent, or -1 on error.
+ */
+static long load_request(struct load_client *c, enum load_step step) {
+    static const char *const urls[] = { [LOAD_DATA] = "/data", [LOAD_HISTORY] = "/history",
+                                        [LOAD_STREAM] = "/stream" };
+    char request[sizeof(load_request_fmt) + 16];
+    int len = snprintf(request, sizeof(request), load_request_fmt, urls[step]);
+
+    if (send(c->fd, request, (size_t)len, MSG_NOSIGNAL) != len) // Fits the empty socket buffer
+        return -1;
+    c->step = step;
+    c->body_left = -1;
+    c->head_len = 0;
+    return len;
+}
+
+/**
+ * @brief Consumes received bytes of the response being read.
+ *
+ * The head is buffered until its blank line to find Content-Length; a
+ * chunked /stream body never ends and is only counted.
+ *
+ * @return 1 if the response is complete, 0 if more is expected, -1 on a malformed head.
+ */
+static int load_consume(struct load_client *c, const char *p, size_t n) {
+    if (c->body_left < 0) {
+        size_t take = n < sizeof(c->head) - 1 - c->head_len ? n : sizeof(c->head) - 1 - c->head_len;
+        char *end, *line;
+
+        memcpy(c->head + c->head_len, p, take);
+        c->head_len += take;
+        c->head[c->head_len] = '\0';
+        if ((end = strstr(c->head, "\r\n\r\n")) == NULL)
+            return c->head_len < sizeof(c->head) - 1 ? 0 : -1;
+        n = c->head_len - (size_t)(end + 4 - c->head); // Body bytes received with the head
+        c->body_left = c->step == LOAD_STREAM ? LLONG_MAX : 0;
+        for (line = strstr(c->head, "\r\n"); line != NULL && line < end; line = strstr(line + 2, "\r\n"))
+            if (strncasecmp(line + 2, "Content-Length:", 15) == 0)
+                c->body_left = strtoll(line + 17, NULL, 10);
+    }
+    c->body_left -= (long long)n;
+    return c->body_left <= 0;
+}
+
+/**
+ * @brief CPU time (user and system) used so far by every thread of a process, in ns.
+ *
+ * Sums the per-thread run times of /proc/<pid>/task/<tid>/schedstat; without
+ * schedstats, falls back to the clock-tick totals of /proc/<pid>/stat.
+ *
+ * @return CPU time, or -1 if the process cannot be read.
+ */
+static long long load_process_cpu_ns(pid_t pid) {
+    char path[64];
+    long long total = 0;
+    unsigned long long utime, stime;
+    struct dirent *e;
+    DIR *dir;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+    if ((dir = opendir(path)) != NULL) {
+        while ((e = readdir(dir)) != NULL) {
+            unsigned long long run_ns;
+            char task[sizeof(path) + sizeof(e->d_name) + 16];
+
+            if (e->d_name[0] == '.')
+                continue;
+            snprintf(task, sizeof(task), "%s/%s/schedstat", path, e->d_name);
+            if ((f = fopen(task, "r")) == NULL)
+                continue; // Thread just exited
+            if (fscanf(f, "%llu", &run_ns) == 1)
+                total += (long long)run_ns;
+            fclose(f);
+        }
+        closedir(dir);
+        if (total > 0)
+            return total;
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    if ((f = fopen(path, "r")) == NULL)
+        return -1;
+    // Skip "pid (comm)": the command may contain spaces, so resume after the last ')'
+    if (fscanf(f, "%*d (%*[^)]) %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return (long long)(utime + stime) * (1000000000LL / sysconf(_SC_CLK_TCK));
+}
+
+/**
+ * @brief Starts this program as the server with a simulated sensor on a free loopback port.
+ *
+ * @param port Receives the port it listens on.
+ * @return Server process, or -1 if it did not accept connections within LOAD_START_MS.
+ */
+static pid_t load_server_start(uint16_t *port) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    char port_arg[8], interval_arg[16];
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    pid_t pid;
+
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) < 0) { // Let the kernel pick the port
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    close(fd);
+    *port = ntohs(addr.sin_port);
+    snprintf(port_arg, sizeof(port_arg), "%u", (unsigned)*port);
+    snprintf(interval_arg, sizeof(interval_arg), "%d", LOAD_INTERVAL_MS);
+
+    fflush(stdout);
+    if ((pid = fork()) < 0)
+        return -1;
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0)
+            dup2(null, STDOUT_FILENO); // Keep the server's log out of the tables
+        execl("/proc/self/exe", "http_server", "-s", "-i", interval_arg, "-p", port_arg, (char *)NULL);
+        _exit(127);
+    }
+
+    for (int waited = 0; waited < LOAD_START_MS; waited += 10) {
+        struct timespec pause = { 0, 10000000L };
+        int probe = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int up = probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+
+        if (probe >= 0)
+            close(probe);
+        if (up) {
+            pause.tv_sec = 0;
+            pause.tv_nsec = 3L * LOAD_INTERVAL_MS * 1000000L; // A few samples in the history
+            nanosleep(&pause, NULL);
+            return pid;
+        }
+        if (waitpid(pid, NULL, WNOHANG) == pid)
+            return -1; // Exited: not the server binary, or the port was taken
+        nanosleep(&pause, NULL);
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    return -1;
+}
+
+/**
+ * @brief Runs LOAD_SAMPLES sampling periods of `clients` dashboards against the server.
+ *
+ * @param server Server process, for its CPU time.
+ * @param port Server port.
+ * @param clients Dashboards (0 measures the idle server).
+ * @param stream Hold /stream (after one /history) instead of polling /data and /history every period.
+ * @param idle_ns Server CPU time of an idle period, subtracted from the result.
+ * @return Server CPU time per period in ns, or -1 on error.
+ */
+static long long load_run(pid_t server, uint16_t port, int clients, int stream, long long idle_ns) {
+    static char buf[65536];
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+                                .sin_port = htons(port) };
+    struct load_client c[LOAD_CLIENTS_MAX];
+    struct pollfd pfd[LOAD_CLIENTS_MAX];
+    struct timespec now;
+    long long cpu = -1, bytes = 0, polls = 0, start_ms, end_ms, tick_ms;
+    int opened = 0, ready = 0;
+
+    for (; opened < clients; opened++) {
+        c[opened].fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        c[opened].step = LOAD_IDLE;
+        if (c[opened].fd < 0 || connect(c[opened].fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            opened++;
+            goto out;
+        }
+        setsockopt(c[opened].fd, IPPROTO_TCP, TCP_NODELAY, &(int){ 1 }, sizeof(int));
+        fcntl(c[opened].fd, F_SETFL, O_NONBLOCK);
+        pfd[opened].fd = c[opened].fd;
+        pfd[opened].events = POLLIN;
+        if (stream && load_request(&c[opened], LOAD_HISTORY) < 0) // Page load: not measured
+            goto out;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    start_ms = timespec_ms(&now);
+    end_ms = start_ms + LOAD_START_MS;
+    while (stream && ready < clients) { // Until every dashboard is subscribed
+        if (timespec_ms(&now) >= end_ms || poll(pfd, (nfds_t)clients, LOAD_START_MS) <= 0)
+            goto out;
+        for (int i = 0; i < clients; i++) {
+            ssize_t n;
+            int done;
+            if (!(pfd[i].revents & (POLLIN | POLLHUP | POLLERR)) || c[i].step == LOAD_STREAM)
+                continue;
+            if ((n = recv(c[i].fd, buf, sizeof(buf), 0)) <= 0 || (done = load_consume(&c[i], buf, (size_t)n)) < 0)
+                goto out;
+            if (done && load_request(&c[i], LOAD_STREAM) < 0)
+                goto out;
+            ready += done;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    start_ms = tick_ms = timespec_ms(&now);
+    end_ms = start_ms + (long long)LOAD_SAMPLES * LOAD_INTERVAL_MS;
+    cpu = load_process_cpu_ns(server);
+    while (timespec_ms(&now) < end_ms) {
+        long long wake_ms = stream || tick_ms > end_ms ? end_ms : tick_ms;
+
+        if (!stream && timespec_ms(&now) >= tick_ms) { // Every period, like the dashboard's old timer
+            for (int i = 0; i < clients; i++) {
+                long sent;
+                if (c[i].step != LOAD_IDLE)
+                    continue; // Still busy with the previous poll
+                if ((sent = load_request(&c[i], LOAD_DATA)) < 0)
+                    goto fail;
+                bytes += sent;
+            }
+            tick_ms += LOAD_INTERVAL_MS;
+            continue;
+        }
+        if (poll(pfd, (nfds_t)clients, (int)(wake_ms - timespec_ms(&now))) < 0)
+            goto fail;
+        for (int i = 0; i < clients; i++) {
+            ssize_t n;
+            int done;
+            long sent;
+            if (!(pfd[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            if ((n = recv(c[i].fd, buf, sizeof(buf), 0)) <= 0 || (done = load_consume(&c[i], buf, (size_t)n)) < 0)
+                goto fail;
+            bytes += n;
+            if (done && c[i].step == LOAD_DATA) {
+                if ((sent = load_request(&c[i], LOAD_HISTORY)) < 0)
+                    goto fail;
+                bytes += sent;
+            } else if (done && c[i].step == LOAD_HISTORY) {
+                c[i].step = LOAD_IDLE;
+                polls++;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+    cpu = (load_process_cpu_ns(server) - cpu) / LOAD_SAMPLES;
+
+    if (clients == 0)
+        printf("%-9s %8d %10s %12.1f\n", "idle", 0, "-", cpu / 1000.0);
+    else if (stream)
+        printf("%-9s %8d %10s %12.1f %14.2f %14.0f\n", "sse", clients, "-", (cpu - idle_ns) / 1000.0,
+               (cpu - idle_ns) / 1000.0 / clients, (double)bytes / LOAD_SAMPLES / clients);
+    else
+        printf("%-9s %8d %10.2f %12.1f %14.2f %14.0f\n", "poll", clients, (double)polls / clients / LOAD_SAMPLES,
+               (cpu - idle_ns) / 1000.0, (cpu - idle_ns) / 1000.0 / clients, (double)bytes / LOAD_SAMPLES / clients);
+    goto out;
+fail:
+    cpu = -1;
+out:
+    for (int i = 0; i < opened; i++)
+        if (c[i].fd >= 0)
+            close(c[i].fd);
+    return cpu;
+}
+
+/**
+ * @brief Compares the dashboard's old polling of /data and /history with /stream on the real server.
+ *
+ * Runs this program as the server (-s -p) with a LOAD_INTERVAL_MS sampling
+ * period, so each measured period stands for one second of dashboard use at
+ * the default 1 s. Every dashboard holds one keep-alive HTTP/1.1 connection
+ * and sends browser-sized requests. Polling asks for /data then /history once
+ * per period; streaming loads /history once, unmeasured, then holds /stream.
+ * The server's CPU time (all threads, HTTP parsing and MHD included) is
+ * reported per period above the idle server's, with the bytes on the wire
+ * per dashboard. Polls per period below 1 mean the server fell behind.
+ */
+static void bench_load(void) {
+    long long idle_ns;
+    uint16_t port;
+    pid_t server = load_server_start(&port);
+
+    printf("\n%-9s %8s %10s %12s %14s %14s   (server, %d ms period; per period = per s at 1 s)\n", "dashboard",
+           "clients", "polls/per", "cpu us/per", "cpu us/client", "bytes/client", LOAD_INTERVAL_MS);
+    if (server < 0) {
+        printf("load: could not start this program as the server\n");
+        return;
+    }
+    if ((idle_ns = load_run(server, port, 0, 0, 0)) < 0)
+        perror("load benchmark");
+    for (int clients = 1; idle_ns >= 0 && clients <= LOAD_CLIENTS_MAX; clients *= 10)
+        for (int stream = 0; stream <= 1; stream++)
+            if (load_run(server, port, clients, stream, idle_ns) < 0) {
+                perror("load benchmark");
+                clients = LOAD_CLIENTS_MAX;
+                break;
+            }
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+}
+
+// Temperature code the recovery check stores for sample `seq`
+#define RECOVERY_TEMP(seq) ((uint16_t)((((seq) * 4) & ~SAMPLE_FLAGS) | SAMPLE_VALID))
+
+/**
+ * @brief Recovery check writer (child process): stores samples into the ring file until killed.
+ *
+ * Samples are stored as the sensor thread stores them: slot first, then
+ * ring_file_commit(). Each sample's codes and time are derived from its
+ * sequence number so the survivor can check them.
+ *
+ * @param path Ring file.
+ * @param start_ms CLOCK_MONOTONIC time (ms) of sample 0, the same for every writer.
+ */
+static void recovery_write(const char *path, int64_t start_ms) {
+    int recovered;
+    struct ring_file *f = ring_file_open(path, &recovered);
+    int64_t offset_ms = clock_offset_ms();
+
+    if (f == NULL)
+        _exit(1);
+    for (uint64_t seq = f->hdr.sample_seq + 1;; seq++) {
+        int slot = (int)((seq - 1) % MAX_HISTORY);
+        ring_set_time(&f->ring, (unsigned)slot, start_ms + (int64_t)seq);
+        f->ring.temp[slot] = RECOVERY_TEMP(seq);
+        f->ring.hum[slot] = (uint16_t)~seq;
+        ring_file_commit(f, seq, offset_ms);
+    }
+}
+
+/**
+ * @brief Checks a recovered ring against the writer's pattern.
+ *
+ * Every sample up to the header's sequence number must be intact, except the
+ * oldest one whose slot the writer may have been overwriting; that slot must
+ * have been invalidated.
+ *
+ * @return Slots that do not match.
+ */
+static unsigned long recovery_check(const struct ring_file *f) {
+    uint64_t last = f->hdr.sample_seq;
+    uint64_t first = last >= MAX_HISTORY ? last - MAX_HISTORY + 2 : 1;
+    unsigned long bad = 0;
+
+    if (last == 0)
+        return 0;
+    if (f->ring.temp[last % MAX_HISTORY] & SAMPLE_VALID)
+        bad++;
+    for (uint64_t seq = first; seq <= last; seq++) {
+        int slot = (int)((seq - 1) % MAX_HISTORY);
+        int prev = (int)((seq + MAX_HISTORY - 2) % MAX_HISTORY);
+        if (f->ring.temp[slot] != RECOVERY_TEMP(seq) || f->ring.hum[slot] != (uint16_t)~seq ||
+            (seq > first && ring_time(&f->ring, (unsigned)slot) - ring_time(&f->ring, (unsigned)prev) != 1)) // One ms apart
+            bad++;
+    }
+    return bad;
+}
+
+/**
+ * @brief Kills a process writing the ring file at arbitrary points and checks what reopening recovers.
+ *
+ * A child stores samples back to back and is sent SIGKILL after a varying
+ * delay, RECOVERY_KILLS times, each run continuing the previous one's ring.
+ * Then the header is made incompatible (another version), which must
+ * reinitialize the file empty.
+ *
+ * @return 0 if every reopened ring was intact and the reinitialization worked, 1 otherwise.
+ */
+static int check_ring_file(void) {
+    char path[] = "/tmp/ring_file_bench.XXXXXX";
+    struct timespec start;
+    unsigned long bad = 0;
+    uint64_t samples = 0;
+    int fd = mkstemp(path), kills, recovered = 0, reinit_ok;
+    struct ring_file *f;
+
+    if (fd < 0) {
+        perror("ring file check");
+        return 1;
+    }
+    close(fd);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (kills = 0; kills < RECOVERY_KILLS; kills++) {
+        struct timespec delay = { 0, 200000L + (kills * 7919L) % 20000 * 1000L }; // 0.2 to 20 ms
+        int was_recovered;
+        pid_t pid;
+
+        fflush(stdout);
+        pid = fork();
+        if (pid < 0)
+            break;
+        if (pid == 0)
+            recovery_write(path, timespec_ms(&start));
+        nanosleep(&delay, NULL);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+
+        f = ring_file_open(path, &was_recovered);
+        if (f == NULL)
+            break;
+        recovered += was_recovered;
+        samples = f->hdr.sample_seq;
+        bad += recovery_check(f);
+        munmap(f, sizeof(*f));
+    }
+
+    f = ring_file_open(path, &reinit_ok);
+    if (f != NULL) {
+        f->hdr.version = RING_FILE_VERSION + 1;
+        munmap(f, sizeof(*f));
+        f = ring_file_open(path, &reinit_ok);
+    }
+    reinit_ok = f != NULL && !reinit_ok && f->hdr.magic == RING_FILE_MAGIC && f->hdr.sample_seq == 0;
+    for (int i = 0; reinit_ok && i < MAX_HISTORY; i++)
+        reinit_ok = !(f->ring.temp[i] & SAMPLE_VALID);
+    if (f != NULL)
+        munmap(f, sizeof(*f));
+    unlink(path);
+
+    printf("%-16s %-6s %d kills, %d recovered, %llu samples, %lu mismatched, reinit %s\n", "ring recovery",
+           kills == RECOVERY_KILLS && bad == 0 && reinit_ok ? "ok" : "FAIL", kills, recovered,
+           (unsigned long long)samples, bad, reinit_ok ? "ok" : "failed");
+    return kills == RECOVERY_KILLS && bad == 0 && reinit_ok ? 0 : 1;
+}
+
+/**
+ * @brief Returns a triangle wave in [-swing, swing] with the given period.
+ */
+static int codec_wave(int t, int period, int swing) {
+    int half = period / 2, tri = t % period;
+    tri = tri < half ? tri : period - tri;
+    return (tri * 2 - half) * swing / half;
+}
+
+/**
+ * @brief Encodes the synthetic day into blocks.
+ *
+ * @return Total size of the sealed blocks, headers included.
+ */
+static size_t codec_encode(void) {
+    const int64_t start_ms = 1700000000000LL;
+    size_t bytes = 0;
+
+    for (int b = 0; b < CODEC_BLOCKS; b++) {
+        struct tsblock_encoder *e = &codec_blocks[b];
+        tsblock_encoder_reset(e);
+        for (int i = b * TSBLOCK_SAMPLES; i < CODEC_SAMPLES && i < (b + 1) * TSBLOCK_SAMPLES; i++)
+            tsblock_encode(e, (uint64_t)i + 1, start_ms + i * 1000LL, codec_temp[i], codec_hum[i]);
+        tsblock_seal(e);
+        bytes += sizeof(e->hdr) + e->hdr.bytes;
+    }
+    return bytes;
+}
+
+/**
+ * @brief Decodes every block of the synthetic day.
+ *
+ * @return Number of samples decoded.
+ */
+static size_t codec_decode(void) {
+    struct tsblock_decoder d;
+    struct tsblock_sample s;
+    size_t n = 0;
+    uint32_t sum = 0;
+
+    for (int b = 0; b < CODEC_BLOCKS; b++) {
+        tsblock_decoder_init(&d, &codec_blocks[b].hdr, codec_blocks[b].data);
+        while (tsblock_decode(&d, &s)) {
+            sum += s.temp ^ s.hum;
+            n++;
+        }
+    }
+    codec_sink = sum; // Keeps the decoded values live
+    return n;
+}
+
+/**
+ * @brief Measures archive compression on a day of simulated 1 Hz samples.
+ *
+ * The signal follows the simulated sensor (slow triangle waves) plus one LSB
+ * of noise at the default RH12/T14 resolution.
+ */
+static void bench_archive_codec(void) {
+    struct timespec begin, mid, end;
+    size_t bytes = 0, decoded = 0;
+    uint32_t lcg = 12345;
+
+    for (int i = 0; i < CODEC_SAMPLES; i++) {
+        lcg = lcg * 1103515245u + 12345u;
+        int noise = (int)(lcg >> 30) - 1; // -1, 0, 1 or 2 LSB
+        codec_temp[i] = (uint16_t)((25678 + codec_wave(i, 600, 600) + 4 * noise) & 0xFFFC);
+        codec_hum[i] = (uint16_t)((26739 + codec_wave(i + 150, 600, 1500) + 16 * noise) & 0xFFF0);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int r = 0; r < CODEC_ROUNDS; r++)
+        bytes = codec_encode();
+    clock_gettime(CLOCK_MONOTONIC, &mid);
+    for (int r = 0; r < CODEC_ROUNDS; r++)
+        decoded += codec_decode();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (decoded != (size_t)CODEC_SAMPLES * CODEC_ROUNDS) {
+        printf("\narchive codec: decoded %zu of %d samples\n", decoded, CODEC_SAMPLES * CODEC_ROUNDS);
+        return;
+    }
+
+    double raw_mb = (double)CODEC_SAMPLES * CODEC_RAW_BYTES * CODEC_ROUNDS / 1e6;
+    double bps = (double)bytes / CODEC_SAMPLES;
+    printf("\n%-9s %8s %10s %8s %12s %12s %10s\n", "codec", "samples", "bytes/smp", "ratio",
+           "enc MB/s", "dec MB/s", "MB/year");
+    printf("%-9s %8d %10.3f %8.1f %12.1f %12.1f %10.1f\n", "tsblock", CODEC_SAMPLES, bps,
+           CODEC_RAW_BYTES / bps,
+           raw_mb / (timespec_diff_ns(&mid, &begin) / 1e9),
+           raw_mb / (timespec_diff_ns(&end, &mid) / 1e9),
+           bps * 365.0 * 86400 / 1e6);
+}
+
+/**
+ * @brief Runs one kernel and the scalar one on the same data; returns 0 if they agree.
+ */
+static int vecstat_agree(vecstat_fn fn, const int16_t *v, size_t n, int16_t threshold) {
+    struct vecstat got, expect;
+
+    vecstat_reset(&got);
+    vecstat_reset(&expect);
+    fn(&got, v, n, threshold);
+    vecstat_kernel(VECSTAT_SCALAR)(&expect, v, n, threshold);
+    return got.min == expect.min && got.max == expect.max && got.sum == expect.sum &&
+           got.sumsq == expect.sumsq && got.above == expect.above ? 0 : -1;
+}
+
+/**
+ * @brief Checks each available statistics kernel against the scalar one.
+ *
+ * Edge cases: every length and misalignment around the vector widths, the
+ * int16 extremes (largest squares and pair sums) and runs long enough to
+ * force the lane accumulators to be flushed.
+ *
+ * @return Kernels that disagree.
+ */
+static int check_vecstat(void) {
+    static int16_t data[3 * 16384 * 16 + 64];
+    const size_t len = sizeof(data) / sizeof(data[0]);
+    uint32_t lcg = 777;
+    int failed = 0;
+
+    for (int impl = 0; impl < VECSTAT_IMPLS; impl++) {
+        vecstat_fn fn = vecstat_kernel((enum vecstat_impl)impl);
+        const char *check = "ok";
+
+        if (fn == NULL || impl == VECSTAT_SCALAR) // Missing here, or the reference itself
+            continue;
+        for (size_t i = 0; i < len; i++) { // Random over the full range
+            lcg = lcg * 1103515245u + 12345u;
+            data[i] = (int16_t)(lcg >> 16);
+        }
+        for (size_t n = 0; n <= 64 && *check == 'o'; n++)
+            for (size_t off = 0; off < 8; off++)
+                if (vecstat_agree(fn, data + off, n, (int16_t)(lcg >> 8)) < 0)
+                    check = "FAIL random";
+        if (vecstat_agree(fn, data, len, 0) < 0 || vecstat_agree(fn, data + 1, len - 1, INT16_MIN) < 0)
+            check = "FAIL long";
+        for (size_t i = 0; i < len; i++)
+            data[i] = INT16_MIN;
+        if (vecstat_agree(fn, data, len, INT16_MAX) < 0 || vecstat_agree(fn, data, len, INT16_MIN) < 0)
+            check = "FAIL min";
+        for (size_t i = 0; i < len; i++)
+            data[i] = (int16_t)(i & 1 ? INT16_MAX : INT16_MIN);
+        if (vecstat_agree(fn, data + 3, len - 3, INT16_MAX - 1) < 0)
+            check = "FAIL extremes";
+        failed += *check != 'o';
+        printf("%-16s %-6s agrees with scalar on random and edge-case data\n", vecstat_name((enum vecstat_impl)impl),
+               check);
+    }
+    return failed;
+}
+
+/**
+ * @brief Times each available statistics kernel (checked by check_vecstat()).
+ */
+static void bench_vecstat(void) {
+    static int16_t data[VECSTAT_VALUES];
+
+    printf("\n%-9s %8s %12s\n", "kernel", "values", "Gvalues/s");
+    for (int impl = 0; impl < VECSTAT_IMPLS; impl++) {
+        vecstat_fn fn = vecstat_kernel((enum vecstat_impl)impl);
+        struct timespec begin, end;
+        struct vecstat s;
+        int64_t sink = 0;
+
+        if (fn == NULL)
+            continue;
+        for (size_t i = 0; i < VECSTAT_VALUES; i++)
+            data[i] = (int16_t)(2200 + codec_wave((int)i, 600, 160));
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (int r = 0; r < VECSTAT_ROUNDS; r++) {
+            vecstat_reset(&s);
+            fn(&s, data, VECSTAT_VALUES, 2250);
+            sink += s.sum + (int64_t)s.above;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        codec_sink = (uint32_t)sink;
+        printf("%-9s %8d %12.2f\n", vecstat_name((enum vecstat_impl)impl), VECSTAT_VALUES,
+               (double)VECSTAT_VALUES * VECSTAT_ROUNDS / timespec_diff_ns(&end, &begin));
+    }
+}
+
+/**
+ * @brief Aggregates the `n` slots ending at `last` of a ring of centi values by scanning.
+ */
+static void window_scan(const int16_t *values[ROLLUP_CHANNELS], unsigned last, unsigned n,
+                        struct rollup_bucket *out) {
+    memset(out, 0, sizeof(*out));
+    for (int c = 0; c < ROLLUP_CHANNELS; c++) {
+        int16_t lo = INT16_MAX, hi = INT16_MIN;
+        int64_t sum = 0, sumsq = 0;
+        for (unsigned k = 0, i = (last + WINDOW_SAMPLES - n + 1) % WINDOW_SAMPLES; k < n; k++) {
+            int16_t v = values[c][i];
+            lo = v < lo ? v : lo;
+            hi = v > hi ? v : hi;
+            sum += v;
+            sumsq += v * v;
+            if (++i == WINDOW_SAMPLES)
+                i = 0;
+        }
+        out->min[c] = lo;
+        out->max[c] = hi;
+        out->sum[c] = sum;
+        out->sumsq[c] = sumsq;
+    }
+    out->count = n;
+}
+
+/**
+ * @brief Same as window_scan(), with the vectorized kernels over the two ring spans.
+ */
+static void window_simd(const int16_t *values[ROLLUP_CHANNELS], unsigned last, unsigned n,
+                        struct rollup_bucket *out) {
+    unsigned first = (last + WINDOW_SAMPLES - n + 1) % WINDOW_SAMPLES;
+    unsigned tail = n < WINDOW_SAMPLES - first ? n : WINDOW_SAMPLES - first;
+    const int16_t *span[ROLLUP_CHANNELS] = { values[0] + first, values[1] + first };
+
+    memset(out, 0, sizeof(*out));
+    rollup_fold(out, span, tail);
+    rollup_fold(out, values, n - tail);
+}
+
+/**
+ * @brief Returns non-zero if two aggregates are equal.
+ */
+static int window_same(const struct rollup_bucket *a, const struct rollup_bucket *b) {
+    int same = a->count == b->count;
+    for (int c = 0; c < ROLLUP_CHANNELS; c++)
+        same &= a->min[c] == b->min[c] && a->max[c] == b->max[c] &&
+                a->sum[c] == b->sum[c] && a->sumsq[c] == b->sumsq[c];
+    return same;
+}
+
+/**
+ * @brief Compares scalar and vectorized scans with segment tree queries for window statistics.
+ *
+ * Windows end at pseudo-random ring slots so the wrap-around path is covered;
+ * answers of the vectorized scan and of the tree are checked against the scan.
+ */
+static void bench_window_stats(void) {
+    static const unsigned windows[] = { 64, 128, 300, 3600, 86400, WINDOW_SAMPLES };
+    struct rollup_bucket *nodes = malloc(SEGTREE_NODES(WINDOW_SAMPLES) * sizeof(*nodes));
+    int16_t *temp = malloc(WINDOW_SAMPLES * sizeof(*temp));
+    int16_t *hum = malloc(WINDOW_SAMPLES * sizeof(*hum));
+    const int16_t *values[ROLLUP_CHANNELS] = { temp, hum };
+    struct segtree tree;
+    struct timespec begin, end;
+    uint32_t lcg = 54321;
+
+    if (nodes == NULL || temp == NULL || hum == NULL) {
+        printf("\nwindow stats: not enough memory for %u samples\n", WINDOW_SAMPLES);
+        goto out;
+    }
+
+    segtree_init(&tree, nodes, WINDOW_SAMPLES);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (unsigned i = 0; i < WINDOW_SAMPLES; i++) {
+        struct rollup_bucket *leaf = &tree.node[WINDOW_SAMPLES + i];
+        lcg = lcg * 1103515245u + 12345u;
+        temp[i] = (int16_t)(2200 + codec_wave((int)i, 600, 160) + (int)(lcg >> 30));
+        hum[i] = (int16_t)(4500 + codec_wave((int)i + 150, 600, 290) + (int)(lcg >> 29));
+        leaf->count = 1;
+        for (int c = 0; c < ROLLUP_CHANNELS; c++) {
+            leaf->min[c] = leaf->max[c] = leaf->sum[c] = values[c][i];
+            leaf->sumsq[c] = values[c][i] * values[c][i];
+        }
+    }
+    segtree_build(&tree);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("\n%-9s %12s %12s %12s %10s   (%u samples, build %.1f ms, %s)\n", "window",
+           "scan us/q", "simd us/q", "index us/q", "speedup", WINDOW_SAMPLES,
+           timespec_diff_ns(&end, &begin) / 1e6, vecstat_name(vecstat_selected()));
+    for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+        unsigned n = windows[w];
+        unsigned scans = WINDOW_SCAN_VALUES / n;
+        struct rollup_bucket expect, got;
+        double scan_ns, simd_ns, index_ns;
+        int64_t sink = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (unsigned q = 0; q < scans; q++) {
+            window_scan(values, (q * 2654435761u) % WINDOW_SAMPLES, n, &expect);
+            sink += expect.sum[0] + expect.min[1];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        scan_ns = (double)timespec_diff_ns(&end, &begin) / scans;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (unsigned q = 0; q < scans; q++) {
+            window_simd(values, (q * 2654435761u) % WINDOW_SAMPLES, n, &got);
+            sink -= got.sum[0] + got.min[1];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        simd_ns = (double)timespec_diff_ns(&end, &begin) / scans;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (unsigned q = 0; q < WINDOW_QUERIES; q++) {
+            memset(&got, 0, sizeof(got));
+            segtree_query_ring(&tree, (q * 2654435761u) % WINDOW_SAMPLES, n, &got);
+            sink -= got.sum[0] + got.min[1];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        index_ns = (double)timespec_diff_ns(&end, &begin) / WINDOW_QUERIES;
+
+        for (unsigned q = 0; q < 64; q++) { // Spot check the answers
+            unsigned last = (q * 2654435761u) % WINDOW_SAMPLES;
+            memset(&got, 0, sizeof(got));
+            window_scan(values, last, n, &expect);
+            segtree_query_ring(&tree, last, n, &got);
+            if (!window_same(&expect, &got)) {
+                printf("window %u: index disagrees with scan at slot %u\n", n, last);
+                goto out;
+            }
+            window_simd(values, last, n, &got);
+            if (!window_same(&expect, &got)) {
+                printf("window %u: vectorized scan disagrees with scan at slot %u\n", n, last);
+                goto out;
+            }
+        }
+        codec_sink = (uint32_t)sink;
+        printf("%-9u %12.2f %12.2f %12.3f %10.0f\n", n, scan_ns / 1000.0, simd_ns / 1000.0,
+               index_ns / 1000.0, scan_ns / index_ns);
+    }
+
+out:
+    free(nodes);
+    free(temp);
+    free(hum);
+}
+
+/**
+ * @brief Times raw /stats windows on a ring of MAX_HISTORY samples: vectorized scan against the ring index.
+ *
+ * This is the case the server has to serve (sensor_reader.c answers every raw
+ * window from the ring index), down to windows of a few samples, and the
+ * cost of the one leaf update per published sample that keeping the tree
+ * adds to the writer.
+ */
+static void bench_window_ring(void) {
+    static const unsigned windows[] = { 16, 32, 64, 128, 256, MAX_HISTORY };
+    static struct rollup_bucket nodes[SEGTREE_NODES(MAX_HISTORY)];
+    static int16_t temp[MAX_HISTORY], hum[MAX_HISTORY];
+    const int16_t *values[ROLLUP_CHANNELS] = { temp, hum };
+    struct segtree tree;
+    struct timespec begin, end;
+    int64_t sink = 0;
+
+    segtree_init(&tree, nodes, MAX_HISTORY);
+    for (unsigned i = 0; i < MAX_HISTORY; i++) {
+        struct rollup_bucket *leaf = &tree.node[MAX_HISTORY + i];
+        temp[i] = (int16_t)(2200 + codec_wave((int)i, 600, 160));
+        hum[i] = (int16_t)(4500 + codec_wave((int)i + 150, 600, 290));
+        leaf->count = 1;
+        for (int c = 0; c < ROLLUP_CHANNELS; c++) {
+            leaf->min[c] = leaf->max[c] = leaf->sum[c] = values[c][i];
+            leaf->sumsq[c] = values[c][i] * values[c][i];
+        }
+    }
+    segtree_build(&tree);
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (unsigned q = 0; q < WINDOW_QUERIES; q++) // One leaf update per published sample
+        segtree_set(&tree, q % MAX_HISTORY, &tree.node[MAX_HISTORY + q % MAX_HISTORY]);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("\n%-9s %12s %12s %10s   (ring of %d, index update %.3f us)\n", "window", "simd us/q",
+           "index us/q", "speedup", MAX_HISTORY, timespec_diff_ns(&end, &begin) / 1000.0 / WINDOW_QUERIES);
+    for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+        unsigned n = windows[w];
+        struct rollup_bucket got;
+        double simd_ns, index_ns;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (unsigned q = 0; q < WINDOW_QUERIES; q++) {
+            unsigned first = (q * 2654435761u) % MAX_HISTORY;
+            unsigned tail = n < MAX_HISTORY - first ? n : MAX_HISTORY - first;
+            const int16_t *span[ROLLUP_CHANNELS] = { temp + first, hum + first };
+            memset(&got, 0, sizeof(got));
+            rollup_fold(&got, span, tail);
+            rollup_fold(&got, values, n - tail);
+            sink += got.sum[0] + got.min[1];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        simd_ns = (double)timespec_diff_ns(&end, &begin) / WINDOW_QUERIES;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (unsigned q = 0; q < WINDOW_QUERIES; q++) {
+            memset(&got, 0, sizeof(got));
+            segtree_query_ring(&tree, (q * 2654435761u + n - 1) % MAX_HISTORY, n, &got);
+            sink -= got.sum[0] + got.min[1];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        index_ns = (double)timespec_diff_ns(&end, &begin) / WINDOW_QUERIES;
+
+        printf("%-9u %12.3f %12.3f %10.1f\n", n, simd_ns / 1000.0, index_ns / 1000.0, simd_ns / index_ns);
+    }
+    codec_sink = (uint32_t)sink;
+}
+
+/**
+ * @brief Measures bus cost and throughput for each resolution and mode.
+ *
+ * @param cfg Acquisition settings (device or simulated sensor).
+ * @param samples Measurement cycles per resolution and mode.
+ * @return 0 on success, 1 on error.
+ */
+int sensor_benchmark(const struct sensor_config *cfg, int samples) {
+    static const enum htu21d_resolution resolutions[] = {
+        HTU21D_RES_RH12_T14, HTU21D_RES_RH10_T13, HTU21D_RES_RH8_T12, HTU21D_RES_RH11_T11,
+    };
+
+    printf("%-9s %-8s %8s %14s %10s %12s %10s\n", "res", "mode", "samples",
+           "syscalls/smp", "polls/smp", "ms/sample", "samples/s");
+    for (size_t i = 0; i < sizeof(resolutions) / sizeof(resolutions[0]); i++) {
+        if (bench_mode(cfg, HTU21D_NO_HOLD, resolutions[i], samples) < 0 ||
+            bench_mode(cfg, HTU21D_HOLD, resolutions[i], samples) < 0)
+            return 1;
+    }
+    bench_lock();
+    bench_history_decode();
+    bench_alloc();
+    bench_history_format();
+    bench_load();
+    bench_archive_codec();
+    bench_vecstat();
+    bench_window_stats();
+    bench_window_ring();
+    if (ws_benchmark(WS_BENCH_SUBSCRIBERS, WS_BENCH_MESSAGES) < 0)
+        return 1;
+    if (metrics_benchmark(METRICS_BENCH_THREADS, METRICS_BENCH_OPS) < 0)
+        return 1;
+    return 0;
+}
+
+/**
+ * @brief Runs the self-checks, one line each with ok or FAIL.
+ *
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int sensor_check(void) {
+    int failed = 0;
+
+    printf("%-16s %-6s %s\n", "check", "result", "detail");
+    failed += check_vecstat();
+    failed += check_ring_file();
+    failed += metrics_check(METRICS_BENCH_THREADS, METRICS_CHECK_OPS) < 0;
+    return failed ? 1 : 0;
+}
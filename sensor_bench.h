@@ -0,0 +1,18 @@
+/**
+ * @file sensor_bench.h
+ * @brief Benchmarks (-b) and self-checks (-c) run from the command line.
+ */
+
+#ifndef SENSOR_BENCH_H
+#define SENSOR_BENCH_H
+
+#include "sensor_reader.h"
+
+// Measures bus transactions and wall time per sample for each measurement mode,
+// then the cost of decoding a full history ring and the archive compression
+int sensor_benchmark(const struct sensor_config *cfg, int samples);
+
+// Runs the self-checks (statistics kernels, ring file recovery, metrics merge); 0 if all pass
+int sensor_check(void);
+
+#endif
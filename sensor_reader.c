@@ -7,154 +7,893 @@
  * updates and maintains a history of sensor readings.
  *
  * Features:
- * - Reads temperature and humidity data from the sensor.
+ * - Drives the non-blocking HTU21D state machine (htu21d.c) from an epoll/timerfd loop.
  * - Maintains a circular buffer for historical data.
+ * - Appends every sample to the compressed long-term archive (archive.c), if enabled.
+ * - Publishes data through a sequence lock: readers never block the sensor thread
+ *   and never see a half-written update.
  * - Provides functions to retrieve the latest sensor data and history.
- * - Runs a dedicated thread to continuously update sensor readings.
+ * - Runs a dedicated thread that samples on a drift-free absolute cadence.
  *
  * Functions:
- * - `read_temperature`: Reads and calculates the temperature from the sensor.
- * - `read_humidity`: Reads and calculates the humidity from the sensor.
+ * - `publish_sample`: Converts a finished measurement and updates shared variables.
  * - `sensor_loop`: Continuously reads sensor data and updates shared variables.
  * - `start_sensor_loop`: Starts a thread to run the sensor loop.
  * - `get_latest_sensor_data`: Retrieves the latest sensor data in JSON format.
  * - `get_history`: Retrieves historical temperature and humidity data.
+ * - `get_history_since`: Retrieves only the samples newer than a sequence number.
+ * - `get_rollup`: Retrieves the minute or hour min/max/avg buckets.
+ * - `get_sample`: Retrieves one sample of the history by sequence number.
+ * - `find_sample_time`: Binary searches the history ring by time.
+ * - `get_window_stats`: Min/max/mean/stddev over a window ending now.
+ * - `add_sample_listener`: Registers a non-blocking callback run after each sample.
+ * - `get_sensor_stats`: Retrieves acquisition and CRC error counters.
+ * - `get_scheduler_stats`: Retrieves sampling cadence, overrun and jitter counters.
+ * - `get_data_version`, `get_next_cycle_ms`: Validators and freshness for HTTP caching.
  *
  * Dependencies:
- * - I2C communication for sensor interaction (I2C-DEV).
+ * - I2C communication for sensor interaction (I2C-DEV, or the simulated sensor).
  * - POSIX threads for running the sensor loop in a separate thread.
  */
 
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
 #include "sensor_reader.h"
+#include "seqlock.h"
+#include "json_writer.h"
+#include "sample_codec.h"
+#include "ring_file.h"
+#include "archive.h"
+#include "segtree.h"
+#include "metrics.h"
 
 /* Global variables */
-static char latest_data[128] = "No data"; // Buffer to store the latest sensor data in JSON format, including temperature, humidity, or error messages.
+static struct history_ring ring_mem; // History ring when no history file is used
+static struct ring_file *ring_file;  // Memory-mapped history file, or NULL
+
+// State published by the sensor thread. The HTTP threads copy it without locking
+// and retry if the sensor thread updated it meanwhile (see seqlock.h).
+static struct {
+    seqlock_t lock;                 // Sequence lock guarding the fields below
+    char latest_data[128];          // Latest sensor data in JSON format, including temperature, humidity, or error messages.
+    struct history_ring *ring;      // Struct-of-arrays history ring of raw codes (sample_codec.h)
+    int history_index;              // Index to track the current position in the circular buffers.
+    uint64_t sample_seq;            // Number of samples published so far (data version).
+    uint64_t error_count;           // Error messages published in place of the latest data.
+    struct rollup_tier tiers[HISTORY_TIERS]; // Long-term min/max/avg buckets (minute, hour)
+    struct segtree ring_index;      // Aggregates over the ring slots, for window statistics
+    struct segtree tier_index[HISTORY_TIERS]; // Aggregates over the rollup buckets
+} shared = { .lock = SEQLOCK_INIT, .latest_data = "No data", .ring = &ring_mem };
+
+// Bucket storage of the rollup tiers, sized at compile time
+static struct rollup_bucket minute_buckets[ROLLUP_MINUTE_BUCKETS];
+static struct rollup_bucket hour_buckets[ROLLUP_HOUR_BUCKETS];
+
+// Segment tree storage of the window statistics indexes
+static struct rollup_bucket ring_index_nodes[SEGTREE_NODES(MAX_HISTORY)];
+static struct rollup_bucket minute_index_nodes[SEGTREE_NODES(ROLLUP_MINUTE_BUCKETS)];
+static struct rollup_bucket hour_index_nodes[SEGTREE_NODES(ROLLUP_HOUR_BUCKETS)];
+
+static struct sensor_config sensor_cfg; // Settings used by the sensor thread
+
+// Callbacks run by the sensor thread after each published sample (registered before start)
+static struct {
+    sample_listener_fn fn;
+    void *arg;
+} listeners[SAMPLE_LISTENERS_MAX];
+static int listener_count = 0;
+
+// Acquisition counters, written by the sensor thread only and read by the HTTP thread
+static struct {
+    atomic_ulong samples, read_errors;
+    atomic_ulong crc_errors, crc_retries, nacks, timeouts, bus_errors;
+} shared_stats;
 
-static float temperature_history[MAX_HISTORY] = {0}; // Circular buffer to store historical temperature readings.
-static float humidity_history[MAX_HISTORY] = {0};    // Circular buffer to store historical humidity readings.
-static int history_index = 0;                        // Index to track the current position in the circular buffers.
+const long jitter_bounds_us[JITTER_BUCKETS] = { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 50000, 100000 };
 
-const uint8_t read_tmp = 0xF3; // Temperature read command
-const uint8_t read_hum = 0xF5; // Humidity read command
+// Scheduler counters, written by the sensor thread only
+static struct {
+    atomic_ulong cycles, missed, overruns;
+    atomic_long max_jitter_us;
+    atomic_ulong jitter[JITTER_BUCKETS + 1];
+    _Atomic int64_t next_cycle_ms; // Start of the next measurement cycle (CLOCK_MONOTONIC ms)
+} sched_stats;
+
+static int wake_fd = -1;                  // eventfd waking the sensor thread for requests
+static atomic_int requested_res = -1;     // Resolution requested over HTTP, -1 if none
+static atomic_int current_res = HTU21D_RES_RH12_T14; // Resolution programmed into the chip
 
 /* Function definitions */
 /**
  * @brief Retrieves the latest sensor data.
- * 
- * @return A pointer to the latest sensor data as a string.
+ *
+ * Copies a consistent snapshot: never a mix of two updates.
+ *
+ * @param buf Buffer receiving the JSON string.
+ * @param len Size of the buffer.
+ * @return Length of the string copied.
  */
-const char* get_latest_sensor_data(void) {
-    return latest_data;
+size_t get_latest_sensor_data(char *buf, size_t len) {
+    unsigned seq;
+    size_t n;
+
+    do {
+        seq = seqlock_read_begin(&shared.lock);
+        n = strnlen(shared.latest_data, sizeof(shared.latest_data));
+        if (n >= len)
+            n = len - 1;
+        memcpy(buf, shared.latest_data, n);
+    } while (seqlock_read_retry(&shared.lock, seq));
+
+    buf[n] = '\0';
+    return n;
 }
 
 /**
- * @brief Reads temperature from the sensor.
+ * @brief Replaces the latest data with an error message.
  *
- * @param fd Sensor file descriptor.
- * @return Calculated temperature as a float.
+ * @param json Error object in JSON format.
  */
-float read_temperature(int fd) {
-    uint8_t data[3]; // Buffer to store raw data read from the sensor.
-    int raw;         // Variable to store the raw temperature data.
+static void publish_error(const char *json) {
+    seqlock_write_begin(&shared.lock);
+    snprintf(shared.latest_data, sizeof(shared.latest_data), "%s", json);
+    shared.error_count++;
+    seqlock_write_end(&shared.lock);
+}
 
-    write(fd, &read_tmp, 1); // Send the temperature read command to the sensor.
-    usleep(50000);           // 50ms delay to allow the sensor to process the command.
-    
-    read(fd, data, 3); // Read 3 bytes of data from the sensor.
+/**
+ * @brief Opens the transport selected by the configuration.
+ *
+ * @param bus Transport to initialize.
+ * @param cfg Acquisition settings.
+ * @return 0 on success, -1 on error (errno set).
+ */
+int sensor_open_transport(struct i2c_transport *bus, const struct sensor_config *cfg) {
+    if (cfg->simulate)
+        return i2c_fake_open(bus);
+    return i2c_dev_open(bus, cfg->i2c_dev ? cfg->i2c_dev : I2C_DEV, SENSOR_ADDR);
+}
 
-    raw = (data[0] << 8) | data[1]; // Combine the first two bytes into a 16-bit raw value.
-    raw &= 0xFFFC;                  // Mask the status bits from the raw data.
+/**
+ * @brief Bus timing hook of the sensor loop: records one transaction for /metrics.
+ */
+static void observe_i2c(long long ns) {
+    metrics_observe(METRICS_I2C_TRANSACTION, ns);
+}
 
-    return CALC_TEMP(raw);    // Convert the raw data to a temperature value using macro.
+/**
+ * @brief Arms the timerfd for an absolute CLOCK_MONOTONIC deadline.
+ */
+static void arm_timer(int tfd, const struct timespec *when) {
+    struct itimerspec its = { .it_interval = { 0, 0 }, .it_value = *when };
+    timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
 }
 
 /**
- * @brief Reads humidity from the sensor.
+ * @brief Returns the ring slot as a one-sample bucket (empty if never written).
+ */
+static struct rollup_bucket ring_leaf(int slot) {
+    struct rollup_bucket b = { 0 };
+    int32_t centi[ROLLUP_CHANNELS];
+
+    if (!(shared.ring->temp[slot] & SAMPLE_VALID))
+        return b;
+    centi[0] = temp_centi(shared.ring->temp[slot]);
+    centi[1] = hum_centi(shared.ring->hum[slot]);
+    b.count = 1;
+    for (int c = 0; c < ROLLUP_CHANNELS; c++) {
+        b.min[c] = b.max[c] = (int16_t)centi[c];
+        b.sum[c] = centi[c];
+        b.sumsq[c] = (int64_t)centi[c] * centi[c];
+    }
+    return b;
+}
+
+/**
+ * @brief Publishes a finished measurement to the latest data and history buffers.
+ *
+ * The history keeps the codes as delivered by the chip; they are decoded only
+ * when served (sample_codec.h).
+ *
+ * @param raw_temp Temperature code, status bits masked.
+ * @param raw_hum Humidity code, status bits masked.
+ * @param flags SAMPLE_RETRIED if a CRC mismatch forced a re-measurement.
+ * @param when Scheduled start of the measurement cycle (CLOCK_MONOTONIC); the
+ *             fixed cadence keeps archived timestamps cheap to compress.
+ */
+static void publish_sample(uint16_t raw_temp, uint16_t raw_hum, unsigned flags, const struct timespec *when) {
+    int32_t centi[ROLLUP_CHANNELS] = { temp_centi(raw_temp), hum_centi(raw_hum) }; // Humidity capped at 100%
+    uint16_t temp_code = (uint16_t)((raw_temp & ~SAMPLE_FLAGS) | SAMPLE_VALID | flags);
+    int64_t offset_ms = ring_file != NULL ? clock_offset_ms() : 0; // Read outside the write section
+    char *p;
+
+    seqlock_write_begin(&shared.lock); // Readers retry until the update is complete
+
+    // Update latest data in JSON format
+    p = json_put_lit(shared.latest_data, "{\"temperature\": ");
+    p = json_put_centi(p, centi[0]);
+    p = json_put_lit(p, ", \"humidity\": ");
+    p = json_put_centi(p, centi[1]);
+    p = json_put_lit(p, "}");
+    *p = '\0';
+
+    // Store data in history buffers
+    ring_set_time(shared.ring, (unsigned)shared.history_index, timespec_ms(when));
+    shared.ring->temp[shared.history_index] = temp_code;
+    shared.ring->hum[shared.history_index] = raw_hum;
+    {
+        struct rollup_bucket leaf = ring_leaf(shared.history_index);
+        segtree_set(&shared.ring_index, (unsigned)shared.history_index, &leaf); // O(log MAX_HISTORY)
+    }
+    shared.history_index = (shared.history_index + 1) % MAX_HISTORY; // Update circular index
+    shared.sample_seq++;
+    if (ring_file != NULL) // Persisted once the slot is written
+        ring_file_commit(ring_file, shared.sample_seq, offset_ms);
+    for (int t = 0; t < HISTORY_TIERS; t++) // O(1) rollup maintenance, O(log n) index update
+        rollup_add(&shared.tiers[t], (uint64_t)when->tv_sec, centi);
+
+    seqlock_write_end(&shared.lock);
+
+    for (int i = 0; i < listener_count; i++) // Wake consumers waiting for this sample
+        listeners[i].fn(listeners[i].arg);
+
+    archive_append(shared.sample_seq, when, temp_code, raw_hum); // Seals a block every TSBLOCK_SAMPLES
+
+    if (ring_file != NULL && sensor_cfg.sync_every > 0 && shared.sample_seq % sensor_cfg.sync_every == 0)
+        ring_file_sync(ring_file); // Batched: at most one page write per sync_every samples
+}
+
+/**
+ * @brief Mirrors the driver's error counters into the shared counters.
  *
- * @param fd Sensor file descriptor.
- * @return Calculated humidity as a float.
+ * @param st Counters of the acquisition state machine.
  */
-float read_humidity(int fd) {
-    uint8_t data[3]; // Buffer to store raw data read from the sensor.
-    int raw;         // Variable to store the raw temperature data.
+static void sync_stats(const struct htu21d_stats *st) {
+    atomic_store_explicit(&shared_stats.crc_errors, st->crc_errors, memory_order_relaxed);
+    atomic_store_explicit(&shared_stats.crc_retries, st->crc_retries, memory_order_relaxed);
+    atomic_store_explicit(&shared_stats.nacks, st->nacks, memory_order_relaxed);
+    atomic_store_explicit(&shared_stats.timeouts, st->timeouts, memory_order_relaxed);
+    atomic_store_explicit(&shared_stats.bus_errors, st->bus_errors, memory_order_relaxed);
+}
 
-    write(fd, &read_hum, 1); // Send the humidity read command to the sensor.
-    usleep(50000);           // 50ms delay to allow the sensor to process the command.
+/**
+ * @brief Records how late a cycle started against its scheduled time.
+ *
+ * @param late_ns Start lateness in nanoseconds.
+ */
+static void record_jitter(long long late_ns) {
+    long us = (long)(late_ns / 1000);
+    int b = 0;
 
-    read(fd, data, 3);       // Read 3 bytes of data from the sensor.
+    while (b < JITTER_BUCKETS && us > jitter_bounds_us[b])
+        b++;
+    atomic_fetch_add_explicit(&sched_stats.jitter[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&sched_stats.cycles, 1, memory_order_relaxed);
+    if (us > atomic_load_explicit(&sched_stats.max_jitter_us, memory_order_relaxed))
+        atomic_store_explicit(&sched_stats.max_jitter_us, us, memory_order_relaxed);
+}
 
-    raw = (data[0] << 8) | data[1]; // Combine the first two bytes into a 16-bit raw value.
-    raw &= 0xFFFC;                  // Mask the status bits from the raw data.
+/**
+ * @brief Advances the absolute schedule by one period after a cycle.
+ *
+ * The next start is always a whole number of periods after the first one, so
+ * conversion time and wake-up latency never accumulate. If the cycle ran past
+ * one or more start times, those periods are counted as missed and skipped.
+ *
+ * @param next Scheduled start of the cycle that just finished; advanced in place.
+ * @param now Current CLOCK_MONOTONIC time.
+ * @param interval_ns Sampling period.
+ */
+static void advance_schedule(struct timespec *next, const struct timespec *now, long long interval_ns) {
+    timespec_add_ns(next, interval_ns);
+    if (timespec_cmp(now, next) >= 0) {
+        long long behind = timespec_diff_ns(now, next) / interval_ns + 1; // Starts already passed
+        atomic_fetch_add_explicit(&sched_stats.overruns, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&sched_stats.missed, (unsigned long)behind, memory_order_relaxed);
+        timespec_add_ns(next, behind * interval_ns);
+    }
+    atomic_store_explicit(&sched_stats.next_cycle_ms, timespec_ms(next), memory_order_relaxed);
+}
 
-    return CALC_HUM(raw);    // Convert the raw data to a humidity value using macro.
+/**
+ * @brief Programs a resolution and records it as the current one.
+ *
+ * @param dev Idle acquisition state machine.
+ * @param res Resolution to program.
+ */
+static void apply_resolution(struct htu21d *dev, enum htu21d_resolution res) {
+    if (htu21d_set_resolution(dev, res) < 0) {
+        perror("HTU21D resolution error");
+        return;
+    }
+    atomic_store(&current_res, res);
 }
 
 /**
  * @brief Thread function to continuously read sensor data and update shared variables.
  *
- * This function initializes the I2C communication with the sensor, reads temperature
- * and humidity data in a loop, and updates the latest data and history buffers.
+ * This function opens the sensor transport and drives the non-blocking HTU21D
+ * state machine from an epoll loop. A single absolute CLOCK_MONOTONIC timerfd is
+ * re-armed for whichever comes next: the start of the next measurement cycle or
+ * the point where the running conversion should be finished. Cycles start on a
+ * fixed cadence of cfg->interval_ms (start to start), so the conversion time is
+ * part of the period rather than added to it. The thread is idle
+ * in epoll_wait() while the chip converts, so further event sources can share it;
+ * an eventfd delivers resolution changes, which are applied between cycles.
  *
- * @param arg Mandatory void argument.
+ * @param arg Pointer to the struct sensor_config to use.
  * @return NULL on error or when the thread exits.
  */
 void* sensor_loop(void* arg) {
-    int fd = open(I2C_DEV, O_RDWR); // Open I2C device
+    const struct sensor_config *cfg = arg;
+    struct i2c_transport bus; // Transport to the sensor
+    struct htu21d dev;        // Acquisition state machine
+    struct timespec now, next_cycle;
+    struct timespec cycle_start = { 0, 0 }; // When the current measurement was commanded
+    long long interval_ns = (long long)cfg->interval_ms * 1000000LL;
+    struct epoll_event ev_timer = { .events = EPOLLIN };
+    struct epoll_event ev_wake = { .events = EPOLLIN };
+    unsigned long crc_retries = 0; // CRC retry count when the current cycle started
+    int tfd, epfd;
+
     /* Init */
-    if (fd < 0 || ioctl(fd, I2C_SLAVE, SENSOR_ADDR) < 0) { // Check I2C initialization
+    if (sensor_open_transport(&bus, cfg) < 0) { // Check I2C initialization
         perror("I2C open error");
-        strcpy(latest_data, "{\"error\": \"I2C error\"}"); // Log error
+        publish_error("{\"error\": \"I2C error\"}"); // Log error
+        return NULL;
+    }
+    bus.on_transaction = observe_i2c; // Bus latency histogram of /metrics
+
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    ev_timer.data.fd = tfd;
+    ev_wake.data.fd = wake_fd;
+    if (tfd < 0 || epfd < 0 || wake_fd < 0 ||
+        epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev_timer) < 0 ||
+        epoll_ctl(epfd, EPOLL_CTL_ADD, wake_fd, &ev_wake) < 0) {
+        perror("Sensor timer error");
+        publish_error("{\"error\": \"Timer error\"}");
+        i2c_close(&bus);
         return NULL;
     }
 
+    htu21d_init(&dev, &bus, cfg->hold ? HTU21D_HOLD : HTU21D_NO_HOLD);
+    apply_resolution(&dev, cfg->resolution); // Conversion deadlines follow the resolution
+    clock_gettime(CLOCK_MONOTONIC, &next_cycle);
+    atomic_store_explicit(&sched_stats.next_cycle_ms, timespec_ms(&next_cycle), memory_order_relaxed);
+
     /* Loop */
     while (1) {
-        float temp = read_temperature(fd); // Read temperature
-        float hum = read_humidity(fd);    // Read humidity
+        int idle = dev.state == HTU21D_IDLE || dev.state == HTU21D_READY;
+        struct epoll_event events[4];
+        uint64_t expirations;
+
+        arm_timer(tfd, idle ? &next_cycle : &dev.deadline);
+        int n = epoll_wait(epfd, events, 4, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("Sensor epoll error");
+            break;
+        }
+        for (int i = 0; i < n; i++)
+            read(events[i].data.fd, &expirations, sizeof(expirations)); // Acknowledge timer or eventfd
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
 
-        if(hum > 100) hum = 100; // Cap humidity at 100%
+        if (idle) {
+            int res = atomic_exchange(&requested_res, -1);
+            if (res >= 0 && res != atomic_load(&current_res))
+                apply_resolution(&dev, (enum htu21d_resolution)res);
+            if (timespec_cmp(&now, &next_cycle) < 0)
+                continue; // Woken by something else
+            record_jitter(timespec_diff_ns(&now, &next_cycle));
+            crc_retries = dev.stats.crc_retries;
+            cycle_start = now;
+            if (htu21d_start(&dev, &now) < 0) {
+                perror("HTU21D command error");
+                publish_error("{\"error\": \"Sensor error\"}");
+                atomic_fetch_add_explicit(&shared_stats.read_errors, 1, memory_order_relaxed);
+                sync_stats(&dev.stats);
+                advance_schedule(&next_cycle, &now, interval_ns);
+            }
+            continue;
+        }
 
-        // Update latest data in JSON format
-        snprintf(latest_data, sizeof(latest_data),
-                 "{\"temperature\": %.2f, \"humidity\": %.2f}", temp, hum);
+        if (timespec_cmp(&now, &dev.deadline) < 0)
+            continue;
 
-        // Store data in history buffers
-        temperature_history[history_index] = temp;
-        humidity_history[history_index] = hum;
-        history_index = (history_index + 1) % MAX_HISTORY; // Update circular index
+        int ret = htu21d_step(&dev, &now);
+        if (ret == HTU21D_BUSY)
+            continue; // Still converting, timer re-armed for dev.deadline
 
-        sleep(1); // Wait 1 second before next reading
+        if (ret < 0) {
+            perror("HTU21D read error");
+            publish_error("{\"error\": \"Sensor error\"}");
+            atomic_fetch_add_explicit(&shared_stats.read_errors, 1, memory_order_relaxed);
+        } else {
+            metrics_observe(METRICS_CONVERSION, timespec_diff_ns(&now, &cycle_start));
+            publish_sample(dev.raw_temp, dev.raw_hum,
+                           dev.stats.crc_retries != crc_retries ? SAMPLE_RETRIED : 0, &next_cycle);
+            atomic_fetch_add_explicit(&shared_stats.samples, 1, memory_order_relaxed);
+        }
+        sync_stats(&dev.stats);
+
+        advance_schedule(&next_cycle, &now, interval_ns); // Next start on the fixed cadence
     }
 
-    close(fd); // Close I2C device
+    close(epfd);
+    close(tfd);
+    i2c_close(&bus); // Close I2C device
     return NULL;
 }
 
+/**
+ * @brief Switches the history to a memory-mapped file, recovering its samples.
+ *
+ * @param path History file path.
+ * @return 0 on success, -1 on error (the in-memory ring stays in use).
+ */
+static int open_history_file(const char *path) {
+    int recovered;
+
+    ring_file = ring_file_open(path, &recovered);
+    if (ring_file == NULL)
+        return -1;
+
+    shared.ring = &ring_file->ring;
+    shared.sample_seq = ring_file->hdr.sample_seq;
+    shared.history_index = (int)(shared.sample_seq % MAX_HISTORY);
+    if (recovered && shared.sample_seq > 0) {
+        int last = (int)((shared.sample_seq - 1) % MAX_HISTORY);
+        char *p = json_put_lit(shared.latest_data, "{\"temperature\": ");
+        p = json_put_centi(p, temp_centi(shared.ring->temp[last]));
+        p = json_put_lit(p, ", \"humidity\": ");
+        p = json_put_centi(p, hum_centi(shared.ring->hum[last]));
+        p = json_put_lit(p, "}");
+        *p = '\0';
+        printf("Recovered history up to sample %llu from %s\n",
+               (unsigned long long)shared.sample_seq, path);
+    }
+    return 0;
+}
+
+/**
+ * @brief Opens the long-term archive and keeps sequence numbers increasing across runs.
+ *
+ * Archived samples are looked up by sequence number, so numbering must not
+ * restart below the archive (e.g. when running without a history file). If
+ * the archive is ahead of the ring, the ring contents belong to other sequence
+ * numbers and are dropped.
+ *
+ * @param path Archive file path.
+ */
+static void open_archive(const char *path) {
+    uint64_t last;
+
+    if (archive_open(path) < 0) {
+        perror("Archive file error"); // Keep running without an archive
+        return;
+    }
+    last = archive_last_seq();
+    if (last > shared.sample_seq) {
+        memset(shared.ring, 0, sizeof(*shared.ring)); // No SAMPLE_VALID flags
+        shared.sample_seq = last;
+        shared.history_index = (int)(last % MAX_HISTORY);
+        if (ring_file != NULL)
+            ring_file_commit(ring_file, last, clock_offset_ms());
+    }
+}
+
+/**
+ * @brief Builds the window statistics indexes over the ring and the rollup tiers.
+ *
+ * The ring may hold recovered samples, so its index is built from the slots.
+ */
+static void init_indexes(void) {
+    segtree_init(&shared.ring_index, ring_index_nodes, MAX_HISTORY);
+    for (int i = 0; i < MAX_HISTORY; i++)
+        shared.ring_index.node[MAX_HISTORY + i] = ring_leaf(i);
+    segtree_build(&shared.ring_index);
+
+    segtree_init(&shared.tier_index[HISTORY_MINUTE], minute_index_nodes, ROLLUP_MINUTE_BUCKETS);
+    segtree_init(&shared.tier_index[HISTORY_HOUR], hour_index_nodes, ROLLUP_HOUR_BUCKETS);
+    for (int t = 0; t < HISTORY_TIERS; t++)
+        shared.tiers[t].index = &shared.tier_index[t];
+}
+
 /**
  * @brief Starts a new thread to run the sensor loop.
  * 
  * This function creates a detached thread that executes the 
- * sensor_loop function. The thread runs independently and 
+ * sensor_loop function with a copy of the given configuration. The thread runs independently and 
  * does not require manual joining.
  */
-void start_sensor_loop(void) {
+void start_sensor_loop(const struct sensor_config *cfg) {
     pthread_t tid; // Thread identifier
-    pthread_create(&tid, NULL, sensor_loop, NULL); // Create a new thread to run sensor_loop
+    sensor_cfg = *cfg; // Keep a copy that outlives the caller
+    if (sensor_cfg.interval_ms <= 0)
+        sensor_cfg.interval_ms = SAMPLE_INTERVAL_MS;
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK); // Lets other threads wake the loop
+    if (sensor_cfg.history_file != NULL && open_history_file(sensor_cfg.history_file) < 0)
+        perror("History file error"); // Keep running with the in-memory history
+    if (sensor_cfg.archive_file != NULL)
+        open_archive(sensor_cfg.archive_file);
+    rollup_init(&shared.tiers[HISTORY_MINUTE], ROLLUP_MINUTE_S, minute_buckets, ROLLUP_MINUTE_BUCKETS);
+    rollup_init(&shared.tiers[HISTORY_HOUR], ROLLUP_HOUR_S, hour_buckets, ROLLUP_HOUR_BUCKETS);
+    init_indexes();
+    pthread_create(&tid, NULL, sensor_loop, &sensor_cfg); // Create a new thread to run sensor_loop
     pthread_detach(tid); // Detach the thread to allow it to run independently
 }
 
 /**
  * @brief Retrieves the historical temperature and humidity data.
- * 
- * @param temp_history Pointer to an array where temperature history will be stored.
- * @param hum_history Pointer to an array where humidity history will be stored.
- */
-void get_history(float* temp_history, float* hum_history) {
-    int i = 0;
-    for (i = 0; i < MAX_HISTORY; i++) {
-        // Copy temperature history in circular order
-        temp_history[i] = temperature_history[(history_index + i) % MAX_HISTORY];
-        // Copy humidity history in circular order
-        hum_history[i] = humidity_history[(history_index + i) % MAX_HISTORY];
+ *
+ * Copies a consistent snapshot of the rings, oldest value first. Slots never
+ * written have no SAMPLE_VALID flag. Sample times are stored on the monotonic
+ * clock and mapped to Unix time with the current clock offset.
+ *
+ * @param temp_history Pointer to an array where temperature codes will be stored.
+ * @param hum_history Pointer to an array where humidity codes will be stored.
+ * @param time_history Pointer to an array where Unix times (ms) will be stored.
+ * @return Sample sequence number (samples published so far) of the snapshot.
+ */
+uint64_t get_history(uint16_t *temp_history, uint16_t *hum_history, int64_t *time_history) {
+    int64_t offset_ms = clock_offset_ms();
+    unsigned seq;
+    uint64_t sample_seq;
+
+    do {
+        seq = seqlock_read_begin(&shared.lock);
+        int head = shared.history_index;
+        if (head < 0 || head >= MAX_HISTORY) // Torn index: the retry check below catches it
+            head = 0;
+        int tail = MAX_HISTORY - head;
+
+        // Copy both rings in circular order: [head, end) then [0, head)
+        memcpy(temp_history, shared.ring->temp + head, tail * sizeof(uint16_t));
+        memcpy(temp_history + tail, shared.ring->temp, head * sizeof(uint16_t));
+        memcpy(hum_history, shared.ring->hum + head, tail * sizeof(uint16_t));
+        memcpy(hum_history + tail, shared.ring->hum, head * sizeof(uint16_t));
+        for (int i = 0; i < MAX_HISTORY; i++)
+            time_history[i] = ring_time(shared.ring, (unsigned)((head + i) % MAX_HISTORY)) + offset_ms;
+        sample_seq = shared.sample_seq;
+    } while (seqlock_read_retry(&shared.lock, seq));
+
+    return sample_seq;
+}
+
+/**
+ * @brief Returns the version of the latest data (/data).
+ *
+ * Counts samples and error messages: it changes whenever the latest data
+ * does, including when an error replaces it without a new sample.
+ */
+uint64_t get_data_version(void) {
+    unsigned seq;
+    uint64_t version;
+
+    do {
+        seq = seqlock_read_begin(&shared.lock);
+        version = shared.sample_seq + shared.error_count;
+    } while (seqlock_read_retry(&shared.lock, seq));
+
+    return version;
+}
+
+/**
+ * @brief Returns when the next measurement cycle starts (CLOCK_MONOTONIC ms).
+ *
+ * No new sample can be published before then, so responses derived from
+ * the samples stay fresh until that time. 0 before the sensor loop starts.
+ */
+int64_t get_next_cycle_ms(void) {
+    return atomic_load_explicit(&sched_stats.next_cycle_ms, memory_order_relaxed);
+}
+
+/**
+ * @brief Retrieves the samples published after a given sequence number.
+ *
+ * Copies samples since + 1 .. latest, oldest first. When `since` is no longer
+ * in the ring (or lies in the future, e.g. after a restart) nothing is copied
+ * and `*count` is set to -1: the caller must start over with get_history().
+ *
+ * @param since Last sequence number the caller has.
+ * @param temp_history Receives up to MAX_HISTORY temperature codes.
+ * @param hum_history Receives up to MAX_HISTORY humidity codes.
+ * @param time_history Receives up to MAX_HISTORY Unix times (ms).
+ * @param count Receives the number of samples copied, or -1.
+ * @return Sample sequence number of the snapshot.
+ */
+uint64_t get_history_since(uint64_t since, uint16_t *temp_history, uint16_t *hum_history,
+                           int64_t *time_history, int *count) {
+    int64_t offset_ms = clock_offset_ms();
+    unsigned seq;
+    uint64_t sample_seq;
+
+    do {
+        seq = seqlock_read_begin(&shared.lock);
+        sample_seq = shared.sample_seq;
+        *count = -1;
+        if (since <= sample_seq && sample_seq - since <= MAX_HISTORY) {
+            int n = (int)(sample_seq - since);
+            int first = (int)(since % MAX_HISTORY);         // Slot of sample since + 1
+            int tail = n < MAX_HISTORY - first ? n : MAX_HISTORY - first;
+
+            memcpy(temp_history, shared.ring->temp + first, tail * sizeof(uint16_t));
+            memcpy(temp_history + tail, shared.ring->temp, (n - tail) * sizeof(uint16_t));
+            memcpy(hum_history, shared.ring->hum + first, tail * sizeof(uint16_t));
+            memcpy(hum_history + tail, shared.ring->hum, (n - tail) * sizeof(uint16_t));
+            for (int i = 0; i < n; i++)
+                time_history[i] = ring_time(shared.ring, (unsigned)((first + i) % MAX_HISTORY)) + offset_ms;
+            *count = n;
+        }
+    } while (seqlock_read_retry(&shared.lock, seq));
+
+    return sample_seq;
+}
+
+/**
+ * @brief Retrieves the buckets of a rollup tier.
+ *
+ * @param tier Tier to copy.
+ * @param buckets Receives up to history_tier_len(tier) buckets, oldest first.
+ * @param span Receives the position of the copy in time.
+ * @return Number of buckets copied.
+ */
+unsigned get_rollup(enum history_tier tier, struct rollup_bucket *buckets, struct rollup_span *span) {
+    unsigned seq, n;
+
+    do {
+        seq = seqlock_read_begin(&shared.lock);
+        n = rollup_copy(&shared.tiers[tier], buckets, &span->first);
+        span->seq = shared.sample_seq;
+    } while (seqlock_read_retry(&shared.lock, seq));
+
+    span->period_s = shared.tiers[tier].period_s;
+    span->count = n;
+    return n;
+}
+
+/**
+ * @brief Returns the number of buckets kept by a rollup tier.
+ */
+unsigned history_tier_len(enum history_tier tier) {
+    return tier == HISTORY_MINUTE ? ROLLUP_MINUTE_BUCKETS : ROLLUP_HOUR_BUCKETS;
+}
+
+/**
+ * @brief Retrieves one sample from the history ring by sequence number.
+ *
+ * Sample `seq` (1-based) lives in slot (seq - 1) % MAX_HISTORY until it is
+ * overwritten MAX_HISTORY samples later.
+ *
+ * @param seq Sequence number of the sample.
+ * @param sample Where to store the sample.
+ * @return 0 on success, -1 if the sample is not published yet, already overwritten or invalid.
+ */
+int get_sample(uint64_t seq, struct sensor_sample *sample) {
+    int64_t offset_ms = clock_offset_ms();
+    unsigned lock_seq;
+    int found;
+
+    do {
+        lock_seq = seqlock_read_begin(&shared.lock);
+        found = seq > 0 && seq <= shared.sample_seq && shared.sample_seq - seq < MAX_HISTORY;
+        if (found) {
+            int slot = (int)((seq - 1) % MAX_HISTORY);
+            found = shared.ring->temp[slot] & SAMPLE_VALID; // Not lost across a restart
+            sample->seq = seq;
+            sample->time_ms = ring_time(shared.ring, (unsigned)slot) + offset_ms;
+            sample->temperature = temp_centi(shared.ring->temp[slot]);
+            sample->humidity = hum_centi(shared.ring->hum[slot]);
+            sample->temp_code = shared.ring->temp[slot];
+            sample->hum_code = shared.ring->hum[slot];
+        }
+    } while (seqlock_read_retry(&shared.lock, lock_seq));
+
+    return found ? 0 : -1;
+}
+
+/**
+ * @brief Binary searches the ring for the first sample at or after a monotonic time.
+ *
+ * Call inside a seqlock read section (or from the sensor thread), with the
+ * sequence number read once in that section: the writer may publish while
+ * the search runs, and the caller's bounds must match the ones searched.
+ *
+ * @param mono_ms CLOCK_MONOTONIC time, ms.
+ * @param last Snapshot of shared.sample_seq.
+ * @return Sequence number of the sample, or last + 1 if every sample is older.
+ */
+static uint64_t ring_find_mono(int64_t mono_ms, uint64_t last) {
+    uint64_t hi = last + 1;
+    uint64_t lo = hi > MAX_HISTORY ? hi - MAX_HISTORY : 1; // Oldest sample still in the ring
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        int slot = (int)((mid - 1) % MAX_HISTORY);
+        if (!(shared.ring->temp[slot] & SAMPLE_VALID) || ring_time(shared.ring, (unsigned)slot) < mono_ms)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-}
\ No newline at end of file
+    return lo;
+}
+
+/**
+ * @brief Finds the first sample of the history ring at or after a point in time.
+ *
+ * Sample times increase with the sequence number, so the ring is binary
+ * searched in sequence order: O(log MAX_HISTORY) slot reads, no copy. Slots
+ * without SAMPLE_VALID only ever precede the valid ones and count as older.
+ *
+ * @param unix_ms Unix time in ms, mapped to the monotonic clock with the
+ *                current clock offset.
+ * @return Sequence number of the first sample at or after `unix_ms`, or the
+ *         latest sequence number + 1 if every sample in the ring is older.
+ */
+uint64_t find_sample_time(int64_t unix_ms) {
+    int64_t mono_ms = unix_ms - clock_offset_ms();
+    unsigned lock_seq;
+    uint64_t seq;
+
+    do {
+        lock_seq = seqlock_read_begin(&shared.lock);
+        seq = ring_find_mono(mono_ms, __atomic_load_n(&shared.sample_seq, __ATOMIC_RELAXED));
+    } while (seqlock_read_retry(&shared.lock, lock_seq));
+
+    return seq;
+}
+
+/**
+ * @brief Computes min/max/mean/stddev over a window of time ending now.
+ *
+ * Windows the ring can cover are answered from the ring index at sample
+ * resolution; longer ones from the minute or hour tier index, starting with
+ * the bucket holding the window start. Either way a binary search and a
+ * segment tree query: O(log n) whatever the window length. On the ring the
+ * query beats a vectorized scan (vecstat.h) at every window length, down to
+ * 16 samples (sensor_bench.c), so raw windows are not scanned.
+ *
+ * @param window_ms Window length in ms.
+ * @param stats Receives the aggregate and where it came from.
+ */
+void get_window_stats(int64_t window_ms, struct window_stats *stats) {
+    int64_t offset_ms = clock_offset_ms();
+    int64_t ring_ms = (int64_t)MAX_HISTORY * sensor_cfg.interval_ms;
+    int tier = window_ms <= ring_ms ? -1 :
+               window_ms <= (int64_t)ROLLUP_MINUTE_BUCKETS * ROLLUP_MINUTE_S * 1000 ? HISTORY_MINUTE : HISTORY_HOUR;
+    struct timespec now;
+    int64_t start_mono;
+    uint64_t last;
+    unsigned lock_seq;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    start_mono = timespec_ms(&now) - window_ms;
+    stats->tier = tier;
+
+    do {
+        lock_seq = seqlock_read_begin(&shared.lock);
+        memset(&stats->agg, 0, sizeof(stats->agg));
+        last = __atomic_load_n(&shared.sample_seq, __ATOMIC_RELAXED); // Once: the writer may publish meanwhile
+        stats->seq = last;
+        stats->from_ms = start_mono + offset_ms;
+
+        if (tier < 0) { // Samples from the first one at or after the window start
+            uint64_t first = ring_find_mono(start_mono, last);
+            if (first <= last) {
+                int slot = (int)((first - 1) % MAX_HISTORY);
+                uint64_t n = last - first + 1; // At most MAX_HISTORY (segtree_query_ring() clamps it too)
+
+                stats->from_ms = ring_time(shared.ring, (unsigned)slot) + offset_ms;
+                segtree_query_ring(&shared.ring_index, (unsigned)((last - 1) % MAX_HISTORY),
+                                   (unsigned)(n < MAX_HISTORY ? n : MAX_HISTORY), &stats->agg);
+            }
+        } else { // Buckets from the one holding the window start
+            const struct rollup_tier *t = &shared.tiers[tier];
+            uint64_t first = start_mono > 0 ? (uint64_t)start_mono / 1000 / t->period_s : 0;
+            if (first < t->first)
+                first = t->first;
+            if (t->head >= t->len && first < t->head - t->len + 1) // Older buckets were overwritten
+                first = t->head - t->len + 1;
+            if (t->started && t->head >= first) {
+                stats->from_ms = (int64_t)(first * t->period_s) * 1000 + offset_ms;
+                segtree_query_ring(t->index, (unsigned)(t->head % t->len),
+                                   (unsigned)(t->head - first + 1), &stats->agg);
+            }
+        }
+    } while (seqlock_read_retry(&shared.lock, lock_seq));
+}
+
+/**
+ * @brief Registers a callback run by the sensor thread after each sample.
+ *
+ * Listeners run on the acquisition thread and must not block. Register them
+ * before start_sensor_loop().
+ *
+ * @param fn Callback.
+ * @param arg Callback argument.
+ * @return 0 on success, -1 if SAMPLE_LISTENERS_MAX listeners are registered.
+ */
+int add_sample_listener(sample_listener_fn fn, void *arg) {
+    if (listener_count >= SAMPLE_LISTENERS_MAX)
+        return -1;
+    listeners[listener_count].fn = fn;
+    listeners[listener_count].arg = arg;
+    listener_count++;
+    return 0;
+}
+
+/**
+ * @brief Returns the sequence number of the latest published sample.
+ *
+ * Cheap enough to call on every request to check whether cached data is stale.
+ */
+uint64_t get_sample_seq(void) {
+    unsigned seq;
+    uint64_t sample_seq;
+
+    do {
+        seq = seqlock_read_begin(&shared.lock);
+        sample_seq = shared.sample_seq;
+    } while (seqlock_read_retry(&shared.lock, seq));
+
+    return sample_seq;
+}
+
+/**
+ * @brief Retrieves the acquisition counters.
+ *
+ * @param stats Where to store a copy of the counters.
+ */
+void get_sensor_stats(struct sensor_stats *stats) {
+    stats->samples = atomic_load_explicit(&shared_stats.samples, memory_order_relaxed);
+    stats->read_errors = atomic_load_explicit(&shared_stats.read_errors, memory_order_relaxed);
+    stats->crc_errors = atomic_load_explicit(&shared_stats.crc_errors, memory_order_relaxed);
+    stats->crc_retries = atomic_load_explicit(&shared_stats.crc_retries, memory_order_relaxed);
+    stats->nacks = atomic_load_explicit(&shared_stats.nacks, memory_order_relaxed);
+    stats->timeouts = atomic_load_explicit(&shared_stats.timeouts, memory_order_relaxed);
+    stats->bus_errors = atomic_load_explicit(&shared_stats.bus_errors, memory_order_relaxed);
+}
+
+/**
+ * @brief Retrieves the sampling scheduler counters.
+ *
+ * @param stats Where to store a copy of the counters.
+ */
+void get_scheduler_stats(struct scheduler_stats *stats) {
+    stats->interval_ms = sensor_cfg.interval_ms;
+    stats->cycles = atomic_load_explicit(&sched_stats.cycles, memory_order_relaxed);
+    stats->missed = atomic_load_explicit(&sched_stats.missed, memory_order_relaxed);
+    stats->overruns = atomic_load_explicit(&sched_stats.overruns, memory_order_relaxed);
+    stats->max_jitter_us = atomic_load_explicit(&sched_stats.max_jitter_us, memory_order_relaxed);
+    for (int i = 0; i <= JITTER_BUCKETS; i++)
+        stats->jitter[i] = atomic_load_explicit(&sched_stats.jitter[i], memory_order_relaxed);
+}
+
+/**
+ * @brief Requests a new measurement resolution.
+ *
+ * The sensor thread owns the bus, so the request is only recorded here and the
+ * thread is woken; the user register is written before the next cycle starts.
+ *
+ * @param res Resolution to program.
+ */
+void set_sensor_resolution(enum htu21d_resolution res) {
+    uint64_t one = 1;
+
+    atomic_store(&requested_res, (int)res);
+    if (wake_fd >= 0)
+        write(wake_fd, &one, sizeof(one));
+}
+
+/**
+ * @brief Returns the resolution currently programmed into the sensor.
+ */
+enum htu21d_resolution get_sensor_resolution(void) {
+    return (enum htu21d_resolution)atomic_load(&current_res);
+}
@@ -19,21 +19,149 @@
 #include <linux/i2c-dev.h>  // For I2C communication
 #include <sys/ioctl.h>  // For I2C device control
 
+#include "i2c_transport.h"  // Swappable I2C transport (i2c-dev or simulated)
+#include "htu21d.h"  // HTU21D acquisition state machine
+#include "rollup.h"  // Long-term min/max/avg buckets
+
 #define I2C_DEV "/dev/i2c-1"  // I2C device path
 #define SENSOR_ADDR 0x40  // Sensor I2C address
-#define MAX_HISTORY 300  // Maximum history size for sensor data
+#define MAX_HISTORY 600  // Maximum history size for sensor data (4 bytes of codes + 4 of time per sample)
+#define SAMPLE_INTERVAL_MS 1000  // Default sampling period
+#define SAMPLE_INTERVAL_MIN_MS 10     // Shortest supported sampling period
+#define SAMPLE_INTERVAL_MAX_MS 3600000 // Longest supported sampling period (1 hour)
+#define JITTER_BUCKETS 10 // Finite buckets of the scheduler jitter histogram
+#define HISTORY_SYNC_SAMPLES 60 // Default samples between history file flushes
+#define SAMPLE_LISTENERS_MAX 4 // Callbacks notified after each published sample
 
-// Macros to calculate temperature and humidity from raw sensor data
+// Macros to calculate temperature and humidity from raw sensor data (reference for sample_codec.h)
 #define CALC_TEMP(raw) (-46.85 + (175.72 * ((float)raw / 65536.0)))
 #define CALC_HUM(raw)  (-6.0 + (125.0 * ((float)raw / 65536.0)))
 
+// Acquisition settings, filled in by main() from the command line
+struct sensor_config {
+    const char *i2c_dev; // I2C device path
+    int simulate;        // Use the in-process simulated HTU21D instead of i2c-dev
+    int hold;            // Use hold master (clock stretching) measurements
+    enum htu21d_resolution resolution; // Resolution programmed at startup
+    long interval_ms;    // Sampling period (start to start)
+    const char *history_file; // Memory-mapped history ring file, NULL to keep history in memory
+    long sync_every;     // Samples between msync() of the history file (0: leave it to the kernel)
+    const char *archive_file; // Compressed long-term archive file, NULL to disable
+};
+
+// One published sample
+struct sensor_sample {
+    uint64_t seq;      // Sequence number (1 for the first sample)
+    int64_t time_ms;   // Unix time in ms (monotonic stamp mapped to the wall clock when read)
+    int32_t temperature; // Temperature in hundredths of °C
+    int32_t humidity;    // Relative humidity in hundredths of %
+    uint16_t temp_code;  // Temperature code as stored, flags in the low bits (sample_codec.h)
+    uint16_t hum_code;   // Humidity code as stored
+};
+
+// Long-term history tiers (the raw tier is the MAX_HISTORY sample ring)
+enum history_tier {
+    HISTORY_MINUTE, // ROLLUP_MINUTE_BUCKETS one-minute buckets
+    HISTORY_HOUR,   // ROLLUP_HOUR_BUCKETS one-hour buckets
+    HISTORY_TIERS
+};
+
+// Position in time of a rollup copy
+struct rollup_span {
+    uint64_t seq;      // Sample sequence number of the snapshot
+    uint64_t first;    // Bucket number of the oldest bucket (CLOCK_MONOTONIC seconds / period_s)
+    unsigned period_s; // Bucket length
+    unsigned count;    // Buckets copied
+};
+
+// Aggregate over a window of time ending now
+struct window_stats {
+    int tier;                 // Data used: -1 for the raw ring, else an enum history_tier
+    uint64_t seq;             // Sample sequence number of the snapshot
+    int64_t from_ms;          // Unix time (ms) of the first sample or bucket covered
+    struct rollup_bucket agg; // Count, min, max and sums per channel (count 0: no data)
+};
+
+// Callback run by the sensor thread after each published sample; must not block
+typedef void (*sample_listener_fn)(void *arg);
+
+// Acquisition counters since startup
+struct sensor_stats {
+    unsigned long samples;     // Measurement cycles published
+    unsigned long read_errors; // Measurement cycles that failed
+    unsigned long crc_errors;  // Frames rejected by the CRC check
+    unsigned long crc_retries; // Conversions repeated after a CRC mismatch
+    unsigned long nacks;       // Reads NACKed while the chip was converting
+    unsigned long timeouts;    // Conversions that never completed
+    unsigned long bus_errors;  // Other I2C failures
+};
+
+// Sampling scheduler counters since startup
+struct scheduler_stats {
+    long interval_ms;         // Configured sampling period
+    unsigned long cycles;     // Measurement cycles started
+    unsigned long missed;     // Periods skipped because a cycle overran
+    unsigned long overruns;   // Cycles that finished after the next start was due
+    long max_jitter_us;       // Worst start lateness observed
+    unsigned long jitter[JITTER_BUCKETS + 1]; // Start lateness histogram (last bucket: overflow)
+};
+
+// Upper bounds (microseconds) of the finite jitter histogram buckets
+extern const long jitter_bounds_us[JITTER_BUCKETS];
+
+// Opens the I2C transport selected by the configuration
+int sensor_open_transport(struct i2c_transport *bus, const struct sensor_config *cfg);
+
 // Starts the sensor reading loop in a separate thread
-void start_sensor_loop(void);
+void start_sensor_loop(const struct sensor_config *cfg);
+
+// Copies the latest sensor data as a JSON string, returns its length
+size_t get_latest_sensor_data(char *buf, size_t len);
+
+// Retrieves historical codes and Unix times (ms), returns their sample sequence number
+uint64_t get_history(uint16_t *temp_history, uint16_t *hum_history, int64_t *time_history);
+
+// Retrieves the samples newer than `since`; *count is -1 if `since` left the ring
+uint64_t get_history_since(uint64_t since, uint16_t *temp_history, uint16_t *hum_history,
+                           int64_t *time_history, int *count);
+
+// Returns the sequence number of the first ring sample at or after a Unix time (ms)
+uint64_t find_sample_time(int64_t unix_ms);
+
+// Computes min/max/mean/stddev over the last `window_ms` milliseconds in O(log n)
+void get_window_stats(int64_t window_ms, struct window_stats *stats);
+
+// Returns the sequence number of the latest published sample
+uint64_t get_sample_seq(void);
+
+// Returns the version of the latest data: changes with every sample and every error message
+uint64_t get_data_version(void);
+
+// Returns the CLOCK_MONOTONIC time (ms) at which the next measurement cycle starts
+int64_t get_next_cycle_ms(void);
+
+// Copies the buckets of a rollup tier oldest first, returns their count
+unsigned get_rollup(enum history_tier tier, struct rollup_bucket *buckets, struct rollup_span *span);
+
+// Returns the number of buckets kept by a rollup tier
+unsigned history_tier_len(enum history_tier tier);
+
+// Retrieves one sample of the history by sequence number, -1 if not available
+int get_sample(uint64_t seq, struct sensor_sample *sample);
+
+// Registers a callback run after each published sample (before start_sensor_loop)
+int add_sample_listener(sample_listener_fn fn, void *arg);
+
+// Retrieves the acquisition counters
+void get_sensor_stats(struct sensor_stats *stats);
+
+// Retrieves the sampling scheduler counters
+void get_scheduler_stats(struct scheduler_stats *stats);
 
-// Retrieves the latest sensor data as a string
-const char* get_latest_sensor_data(void);
+// Requests a new measurement resolution, applied by the sensor thread between cycles
+void set_sensor_resolution(enum htu21d_resolution res);
 
-// Retrieves historical temperature and humidity data
-void get_history(float* temp_history, float* hum_history);
+// Returns the resolution currently programmed into the sensor
+enum htu21d_resolution get_sensor_resolution(void);
 
 #endif
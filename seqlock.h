@@ -0,0 +1,49 @@
+/**
+ * @file seqlock.h
+ * @brief Single-writer sequence lock for data shared with the HTTP threads.
+ *
+ * The writer never blocks: it makes the sequence odd, updates the protected
+ * data and makes it even again. Readers copy the data without taking any lock
+ * and retry if the sequence was odd or changed while they were copying, so they
+ * never observe a half-written update.
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdatomic.h>
+
+typedef struct {
+    atomic_uint seq; // Even: stable, odd: update in progress
+} seqlock_t;
+
+#define SEQLOCK_INIT { 0 }
+
+// Starts an update (single writer only)
+static inline void seqlock_write_begin(seqlock_t *sl) {
+    unsigned s = atomic_load_explicit(&sl->seq, memory_order_relaxed);
+    atomic_store_explicit(&sl->seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // Odd sequence visible before the data changes
+}
+
+// Publishes an update
+static inline void seqlock_write_end(seqlock_t *sl) {
+    unsigned s = atomic_load_explicit(&sl->seq, memory_order_relaxed);
+    atomic_store_explicit(&sl->seq, s + 1, memory_order_release); // Data visible before the even sequence
+}
+
+// Starts a read section; returns the sequence to pass to seqlock_read_retry()
+static inline unsigned seqlock_read_begin(const seqlock_t *sl) {
+    unsigned s;
+    while ((s = atomic_load_explicit((atomic_uint *)&sl->seq, memory_order_acquire)) & 1)
+        ; // Writer in progress: its update is a few hundred nanoseconds
+    return s;
+}
+
+// Returns non-zero if the data copied since seqlock_read_begin() may be torn
+static inline int seqlock_read_retry(const seqlock_t *sl, unsigned start) {
+    atomic_thread_fence(memory_order_acquire); // Data loads complete before the re-check
+    return atomic_load_explicit((atomic_uint *)&sl->seq, memory_order_relaxed) != start;
+}
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ * @file stream.c
+ * @brief Server-Sent Events stream of published samples (/stream).
+ */
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "stream.h"
+#include "waitlist.h"
+#include "sensor_reader.h"
+#include "time_util.h"
+
+struct stream_client {
+    struct waiter waiter;        // Waitlist entry while suspended
+    uint64_t next_seq;           // First sample not sent yet
+    struct timespec last_write;  // Last time anything was sent (CLOCK_MONOTONIC)
+};
+
+static atomic_ulong clients = 0; // Connected subscribers
+
+/**
+ * @brief Writes one sample as an SSE event.
+ *
+ * @param p Output cursor with at least STREAM_EVENT_MAX bytes available.
+ * @param s Sample.
+ * @return Cursor past the event.
+ */
+static char *stream_put_event(char *p, const struct sensor_sample *s) {
+    p = json_put_lit(p, "id: ");
+    p = json_put_u64(p, s->seq);
+    p = json_put_lit(p, "\ndata: {\"seq\": ");
+    p = json_put_u64(p, s->seq);
+    p = json_put_lit(p, ", \"time\": ");
+    p = json_put_u64(p, (uint64_t)s->time_ms);
+    p = json_put_lit(p, ", \"temperature\": ");
+    p = json_put_centi(p, s->temperature);
+    p = json_put_lit(p, ", \"humidity\": ");
+    p = json_put_centi(p, s->humidity);
+    p = json_put_lit(p, "}\n\n");
+    return p;
+}
+
+/**
+ * @brief MHD content reader: sends pending samples or parks the connection.
+ *
+ * @param cls Subscriber.
+ * @param pos Bytes sent so far (unused).
+ * @param buf Output buffer.
+ * @param max Size of the output buffer.
+ * @return Bytes written, or 0 after suspending the connection.
+ */
+static ssize_t stream_read(void *cls, uint64_t pos, char *buf, size_t max) {
+    struct stream_client *c = cls;
+    uint64_t latest = get_sample_seq();
+    struct sensor_sample s;
+    struct timespec now;
+    char *p = buf;
+
+    (void)pos;
+    if (latest >= c->next_seq + MAX_HISTORY) // Fell behind the ring: skip what was overwritten
+        c->next_seq = latest - MAX_HISTORY + 1;
+
+    while (c->next_seq <= latest && (size_t)(buf + max - p) >= STREAM_EVENT_MAX) {
+        if (get_sample(c->next_seq, &s) == 0)
+            p = stream_put_event(p, &s);
+        c->next_seq++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (p == buf && timespec_diff_ns(&now, &c->last_write) >= STREAM_KEEPALIVE_MS * 1000000LL)
+        p = json_put_lit(p, ": keepalive\n\n"); // Keeps proxies from closing an idle stream
+    if (p != buf) {
+        c->last_write = now;
+        return p - buf;
+    }
+
+    waitlist_suspend(&c->waiter, c->next_seq); // Resumed by the next sample or tick
+    return 0;
+}
+
+/**
+ * @brief MHD free callback: releases the subscriber once the stream ends.
+ */
+static void stream_free(void *cls) {
+    atomic_fetch_sub_explicit(&clients, 1, memory_order_relaxed);
+    free(cls);
+}
+
+/**
+ * @brief Creates the event stream response for a new subscriber.
+ *
+ * The stream starts after the sample named by the Last-Event-ID request header
+ * if present, otherwise with the next sample to be published.
+ *
+ * @param connection Connection of the subscriber.
+ * @return The response, or NULL on allocation failure.
+ */
+struct MHD_Response *stream_create_response(struct MHD_Connection *connection) {
+    const char *last_id = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Last-Event-ID");
+    struct stream_client *c = calloc(1, sizeof(*c));
+    uint64_t latest = get_sample_seq();
+    struct MHD_Response *response;
+
+    if (c == NULL)
+        return NULL;
+    c->waiter.conn = connection;
+    c->next_seq = latest + 1;
+    if (last_id != NULL && strtoull(last_id, NULL, 10) < latest) // Ids from before a restart are ignored
+        c->next_seq = strtoull(last_id, NULL, 10) + 1;
+    clock_gettime(CLOCK_MONOTONIC, &c->last_write);
+
+    response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, STREAM_BLOCK_SIZE,
+                                                 &stream_read, c, &stream_free);
+    if (response == NULL) {
+        free(c);
+        return NULL;
+    }
+    atomic_fetch_add_explicit(&clients, 1, memory_order_relaxed);
+    return response;
+}
+
+/**
+ * @brief Returns the number of connected subscribers.
+ */
+unsigned long stream_clients(void) {
+    return atomic_load_explicit(&clients, memory_order_relaxed);
+}
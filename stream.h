@@ -0,0 +1,35 @@
+/**
+ * @file stream.h
+ * @brief Server-Sent Events stream of published samples (/stream).
+ *
+ * Each subscriber gets one event per sample:
+ *
+ *     id: <seq>
+ *     data: {"seq": <seq>, "time": <unix_ms>, "temperature": 22.05, "humidity": 45.10}
+ *
+ * The response body is produced by an MHD content reader. When the subscriber
+ * has seen every sample, the reader suspends the connection on the waitlist
+ * (waitlist.h) instead of returning to be polled, and the notifier resumes it
+ * as soon as the sensor thread publishes the next sample. A browser that
+ * reconnects sends Last-Event-ID and resumes after that sample, as long as it
+ * is still in the history ring.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <microhttpd.h>
+
+#include "json_writer.h"
+
+#define STREAM_BLOCK_SIZE 4096 // Content reader buffer size
+#define STREAM_EVENT_MAX (3 * JSON_U64_MAX + 2 * JSON_CENTI_MAX + 64) // Upper bound of one event
+#define STREAM_KEEPALIVE_MS 10000 // Send a comment line after this much silence
+
+// Creates the event stream response for a new subscriber, NULL on allocation failure
+struct MHD_Response *stream_create_response(struct MHD_Connection *connection);
+
+// Returns the number of connected subscribers
+unsigned long stream_clients(void);
+
+#endif
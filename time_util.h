@@ -0,0 +1,53 @@
+/**
+ * @file time_util.h
+ * @brief Small struct timespec helpers for CLOCK_MONOTONIC deadlines and timestamps.
+ */
+
+#ifndef TIME_UTIL_H
+#define TIME_UTIL_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define NSEC_PER_SEC 1000000000LL
+
+// Adds (possibly negative) nanoseconds to a timespec, keeping it normalized
+static inline void timespec_add_ns(struct timespec *ts, long long ns) {
+    long long total = (long long)ts->tv_nsec + ns;
+    ts->tv_sec += (time_t)(total / NSEC_PER_SEC);
+    total %= NSEC_PER_SEC;
+    if (total < 0) {
+        total += NSEC_PER_SEC;
+        ts->tv_sec--;
+    }
+    ts->tv_nsec = (long)total;
+}
+
+// Returns <0, 0 or >0 as a is before, equal to or after b
+static inline int timespec_cmp(const struct timespec *a, const struct timespec *b) {
+    if (a->tv_sec != b->tv_sec)
+        return a->tv_sec < b->tv_sec ? -1 : 1;
+    if (a->tv_nsec != b->tv_nsec)
+        return a->tv_nsec < b->tv_nsec ? -1 : 1;
+    return 0;
+}
+
+// Returns a - b in nanoseconds
+static inline long long timespec_diff_ns(const struct timespec *a, const struct timespec *b) {
+    return (long long)(a->tv_sec - b->tv_sec) * NSEC_PER_SEC + (a->tv_nsec - b->tv_nsec);
+}
+
+// Returns a timespec in milliseconds
+static inline int64_t timespec_ms(const struct timespec *ts) {
+    return (int64_t)ts->tv_sec * 1000 + ts->tv_nsec / 1000000;
+}
+
+// Returns CLOCK_REALTIME - CLOCK_MONOTONIC in ms: added to a monotonic stamp it gives Unix time
+static inline int64_t clock_offset_ms(void) {
+    struct timespec mono, wall;
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &wall);
+    return timespec_ms(&wall) - timespec_ms(&mono);
+}
+
+#endif
@@ -0,0 +1,234 @@
+/**
+ * @file tsblock.c
+ * @brief Gorilla-style compressed blocks of samples.
+ */
+
+#include <string.h>
+
+#include "tsblock.h"
+#include "sample_codec.h"
+
+/**
+ * @brief Appends the low `n` bits of `v` (n <= 32), MSB first.
+ */
+static void put_bits(struct tsblock_encoder *e, uint64_t v, int n) {
+    e->acc = (e->acc << n) | (v & ((1ULL << n) - 1));
+    e->nacc += n;
+    while (e->nacc >= 8) {
+        e->nacc -= 8;
+        e->data[e->hdr.bytes++] = (uint8_t)(e->acc >> e->nacc);
+    }
+}
+
+/**
+ * @brief Reads `n` bits (n <= 32); reads past the payload return zero bits.
+ */
+static uint64_t get_bits(struct tsblock_decoder *d, int n) {
+    while (d->nacc < n) {
+        d->acc = (d->acc << 8) | (d->pos < d->hdr->bytes ? d->data[d->pos] : 0);
+        d->pos++;
+        d->nacc += 8;
+    }
+    d->nacc -= n;
+    return (d->acc >> d->nacc) & ((1ULL << n) - 1);
+}
+
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/**
+ * @brief Writes a timestamp delta-of-delta.
+ */
+static void put_dod(struct tsblock_encoder *e, int64_t dod) {
+    if (dod == 0)
+        put_bits(e, 0x0, 1);
+    else if (dod >= -64 && dod < 64) {
+        put_bits(e, 0x2, 2);
+        put_bits(e, (uint64_t)dod, 7);
+    } else if (dod >= -256 && dod < 256) {
+        put_bits(e, 0x6, 3);
+        put_bits(e, (uint64_t)dod, 9);
+    } else if (dod >= -2048 && dod < 2048) {
+        put_bits(e, 0xE, 4);
+        put_bits(e, (uint64_t)dod, 12);
+    } else {
+        put_bits(e, 0xF, 4);
+        put_bits(e, (uint64_t)dod, 32);
+    }
+}
+
+/**
+ * @brief Sign-extends the low `n` bits of `v`.
+ */
+static int64_t sign_extend(uint64_t v, int n) {
+    return (int64_t)(v << (64 - n)) >> (64 - n);
+}
+
+static int64_t get_dod(struct tsblock_decoder *d) {
+    if (get_bits(d, 1) == 0)
+        return 0;
+    if (get_bits(d, 1) == 0)
+        return sign_extend(get_bits(d, 7), 7);
+    if (get_bits(d, 1) == 0)
+        return sign_extend(get_bits(d, 9), 9);
+    if (get_bits(d, 1) == 0)
+        return sign_extend(get_bits(d, 12), 12);
+    return sign_extend(get_bits(d, 32), 32);
+}
+
+/**
+ * @brief Writes a value delta, zig-zag encoded.
+ */
+static void put_delta(struct tsblock_encoder *e, int32_t delta) {
+    uint32_t z = zigzag(delta);
+
+    if (z == 0)
+        put_bits(e, 0x0, 1);
+    else if (z < 16) {
+        put_bits(e, 0x2, 2);
+        put_bits(e, z, 4);
+    } else if (z < 128) {
+        put_bits(e, 0x6, 3);
+        put_bits(e, z, 7);
+    } else if (z < 1024) {
+        put_bits(e, 0xE, 4);
+        put_bits(e, z, 10);
+    } else {
+        put_bits(e, 0xF, 4);
+        put_bits(e, z, 16);
+    }
+}
+
+static int32_t get_delta(struct tsblock_decoder *d) {
+    if (get_bits(d, 1) == 0)
+        return 0;
+    if (get_bits(d, 1) == 0)
+        return unzigzag((uint32_t)get_bits(d, 4));
+    if (get_bits(d, 1) == 0)
+        return unzigzag((uint32_t)get_bits(d, 7));
+    if (get_bits(d, 1) == 0)
+        return unzigzag((uint32_t)get_bits(d, 10));
+    return unzigzag((uint32_t)get_bits(d, 16));
+}
+
+/**
+ * @brief FNV-1a over the payload.
+ */
+static uint32_t tsblock_checksum(const uint8_t *data, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ data[i]) * 16777619u;
+    return h;
+}
+
+/**
+ * @brief Empties an encoder.
+ */
+void tsblock_encoder_reset(struct tsblock_encoder *e) {
+    memset(&e->hdr, 0, sizeof(e->hdr));
+    e->acc = 0;
+    e->nacc = 0;
+    e->prev_ms = e->prev_delta = 0;
+    e->prev_temp = e->prev_hum = 0;
+}
+
+/**
+ * @brief Appends a sample to an unsealed block.
+ *
+ * Sequence numbers are not stored: the samples of a block are consecutive.
+ *
+ * @param e Encoder with fewer than TSBLOCK_SAMPLES samples.
+ * @param seq Sequence number (used for the first sample only).
+ * @param ms Unix time in ms.
+ * @param temp Temperature code.
+ * @param hum Humidity code.
+ * @return Samples in the block, or 0 if the timestamp goes backwards or jumps by
+ *         more than TSBLOCK_GAP_MAX_MS (seal the block and start a new one).
+ */
+uint32_t tsblock_encode(struct tsblock_encoder *e, uint64_t seq, int64_t ms, uint16_t temp, uint16_t hum) {
+    int32_t t = temp >> (16 - TEMP_TABLE_BITS), h = hum >> (16 - HUM_TABLE_BITS);
+
+    if (e->hdr.count > 0 && (ms < e->prev_ms || ms - e->prev_ms > TSBLOCK_GAP_MAX_MS))
+        return 0; // Keeps every delta-of-delta within 32 bits
+    if (e->hdr.count == 0) {
+        e->hdr.first_seq = seq;
+        e->hdr.first_ms = ms;
+        e->prev_ms = ms;
+    }
+    int64_t delta = ms - e->prev_ms;
+    put_dod(e, delta - e->prev_delta);
+    put_delta(e, t - e->prev_temp);
+    put_delta(e, h - e->prev_hum);
+
+    e->prev_delta = delta;
+    e->prev_ms = ms;
+    e->prev_temp = t;
+    e->prev_hum = h;
+    e->hdr.last_ms = ms;
+    return ++e->hdr.count;
+}
+
+/**
+ * @brief Flushes the last bits (zero padded) and completes the header.
+ */
+void tsblock_seal(struct tsblock_encoder *e) {
+    if (e->nacc > 0)
+        put_bits(e, 0, 8 - e->nacc);
+    e->hdr.magic = TSBLOCK_MAGIC;
+    e->hdr.checksum = tsblock_checksum(e->data, e->hdr.bytes);
+}
+
+/**
+ * @brief Checks a sealed block read back from storage.
+ *
+ * @return 0 if the header is plausible and the payload checksum matches, -1 otherwise.
+ */
+int tsblock_verify(const struct tsblock_header *hdr, const uint8_t *data) {
+    if (hdr->magic != TSBLOCK_MAGIC || hdr->count == 0 || hdr->count > TSBLOCK_SAMPLES ||
+        hdr->bytes > TSBLOCK_BYTES_MAX || hdr->last_ms < hdr->first_ms)
+        return -1;
+    return tsblock_checksum(data, hdr->bytes) == hdr->checksum ? 0 : -1;
+}
+
+/**
+ * @brief Starts decoding a sealed block.
+ */
+void tsblock_decoder_init(struct tsblock_decoder *d, const struct tsblock_header *hdr, const uint8_t *data) {
+    d->hdr = hdr;
+    d->data = data;
+    d->pos = 0;
+    d->acc = 0;
+    d->nacc = 0;
+    d->index = 0;
+    d->prev_ms = hdr->first_ms;
+    d->prev_delta = 0;
+    d->prev_temp = d->prev_hum = 0;
+}
+
+/**
+ * @brief Decodes the next sample.
+ *
+ * @param d Decoder.
+ * @param s Receives the sample.
+ * @return 1 if a sample was decoded, 0 at the end of the block.
+ */
+int tsblock_decode(struct tsblock_decoder *d, struct tsblock_sample *s) {
+    if (d->index >= d->hdr->count)
+        return 0;
+
+    d->prev_delta += get_dod(d);
+    d->prev_ms += d->prev_delta;
+    d->prev_temp += get_delta(d);
+    d->prev_hum += get_delta(d);
+
+    s->seq = d->hdr->first_seq + d->index++;
+    s->ms = d->prev_ms;
+    s->temp = (uint16_t)((d->prev_temp << (16 - TEMP_TABLE_BITS)) | SAMPLE_VALID);
+    s->hum = (uint16_t)(d->prev_hum << (16 - HUM_TABLE_BITS));
+    return 1;
+}
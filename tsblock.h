@@ -0,0 +1,90 @@
+/**
+ * @file tsblock.h
+ * @brief Gorilla-style compressed blocks of samples.
+ *
+ * A block holds up to TSBLOCK_SAMPLES consecutive samples bit-packed MSB first:
+ *
+ * - Timestamps (ms) as delta-of-delta against the previous interval:
+ *   '0' (same interval), '10'+7 bits, '110'+9 bits, '1110'+12 bits, '1111'+32 bits.
+ *   Samples are stamped with their scheduled start, so on a steady cadence
+ *   every timestamp after the second costs one bit.
+ * - Temperature (code >> 2, 14 bits) and humidity (code >> 4, 12 bits) as
+ *   zig-zag deltas against the previous value: '0' (unchanged), '10'+4 bits,
+ *   '110'+7 bits, '1110'+10 bits, '1111'+16 bits. The values are integer codes,
+ *   so a delta is exact where Gorilla XORs floats.
+ *
+ * The first sample is coded against an interval of 0 and values of 0. Blocks
+ * are decoded one sample at a time, so a reader never needs more than the
+ * packed block in memory.
+ */
+
+#ifndef TSBLOCK_H
+#define TSBLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TSBLOCK_MAGIC 0x4B4C4254u // "TBLK"
+#define TSBLOCK_SAMPLES 600       // Samples per block (10 minutes at 1 s)
+#define TSBLOCK_GAP_MAX_MS (1LL << 30) // Longest interval inside a block (~12 days)
+#define TSBLOCK_SAMPLE_BITS_MAX (4 + 32 + 2 * (4 + 16)) // Worst case per sample
+#define TSBLOCK_BYTES_MAX ((TSBLOCK_SAMPLES * TSBLOCK_SAMPLE_BITS_MAX + 7) / 8) // Payload bound
+
+// Block header, stored in front of the payload (native endianness)
+struct tsblock_header {
+    uint32_t magic;     // TSBLOCK_MAGIC
+    uint32_t bytes;     // Payload length
+    uint32_t count;     // Samples in the block
+    uint32_t checksum;  // FNV-1a of the payload
+    uint64_t first_seq; // Sequence number of the first sample (the others follow without gaps)
+    int64_t first_ms;   // Unix time of the first sample, ms
+    int64_t last_ms;    // Unix time of the last sample, ms
+};
+
+// One decoded sample
+struct tsblock_sample {
+    uint64_t seq;       // Sequence number
+    int64_t ms;         // Unix time, ms
+    uint16_t temp;      // Temperature code (SAMPLE_VALID set, see sample_codec.h)
+    uint16_t hum;       // Humidity code
+};
+
+struct tsblock_encoder {
+    struct tsblock_header hdr;         // Filled in as samples are added
+    uint8_t data[TSBLOCK_BYTES_MAX];   // Payload
+    uint64_t acc;                      // Bits not yet stored in data[]
+    int nacc;                          // Number of bits in acc
+    int64_t prev_ms, prev_delta;       // Previous timestamp and interval
+    int32_t prev_temp, prev_hum;       // Previous values
+};
+
+struct tsblock_decoder {
+    const struct tsblock_header *hdr;  // Block being decoded
+    const uint8_t *data;               // Its payload
+    size_t pos;                        // Next payload byte
+    uint64_t acc;                      // Bits read ahead
+    int nacc;                          // Number of bits in acc
+    uint32_t index;                    // Samples decoded so far
+    int64_t prev_ms, prev_delta;
+    int32_t prev_temp, prev_hum;
+};
+
+// Empties an encoder
+void tsblock_encoder_reset(struct tsblock_encoder *e);
+
+// Appends a sample; returns the number of samples in the block (TSBLOCK_SAMPLES: full), 0 if it does not fit
+uint32_t tsblock_encode(struct tsblock_encoder *e, uint64_t seq, int64_t ms, uint16_t temp, uint16_t hum);
+
+// Flushes the last bits and completes the header; the block is then hdr + data[0 .. hdr.bytes)
+void tsblock_seal(struct tsblock_encoder *e);
+
+// Checks a sealed block read back from storage; returns 0 if intact
+int tsblock_verify(const struct tsblock_header *hdr, const uint8_t *data);
+
+// Starts decoding a sealed block
+void tsblock_decoder_init(struct tsblock_decoder *d, const struct tsblock_header *hdr, const uint8_t *data);
+
+// Decodes the next sample; returns 1, or 0 at the end of the block
+int tsblock_decode(struct tsblock_decoder *d, struct tsblock_sample *s);
+
+#endif
@@ -0,0 +1,285 @@
+/**
+ * @file vecstat.c
+ * @brief Vectorized summary statistics over arrays of 16-bit values.
+ *
+ * The x86 kernels are compiled with per-function target attributes, so one
+ * binary carries all of them and the CPU decides at run time. NEON is always
+ * present on AArch64; 32-bit ARM builds get it when compiled with NEON
+ * enabled and still check the HWCAP bit.
+ *
+ * Lane accumulators are flushed into 64-bit totals every VECSTAT_BLOCK
+ * vectors, before a 32-bit lane sum or a 16-bit lane count could overflow.
+ */
+
+#include <stdatomic.h>
+
+#include "vecstat.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VECSTAT_HAVE_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VECSTAT_HAVE_NEON 1
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#define VECSTAT_BLOCK 16384 // Vectors per flush: lane sums stay below 2^31, lane counts below 2^16
+
+static atomic_int selected = -1;        // enum vecstat_impl, -1 until detected
+static _Atomic(vecstat_fn) selected_fn; // Its kernel, NULL until the first call
+
+/**
+ * @brief Empties a summary.
+ */
+void vecstat_reset(struct vecstat *s) {
+    s->min = INT16_MAX;
+    s->max = INT16_MIN;
+    s->sum = 0;
+    s->sumsq = 0;
+    s->above = 0;
+}
+
+/**
+ * @brief Portable kernel, also used for the tails of the vector kernels.
+ */
+static void vecstat_scalar(struct vecstat *s, const int16_t *v, size_t n, int16_t threshold) {
+    int16_t lo = s->min, hi = s->max;
+    int64_t sum = 0;
+    uint64_t sumsq = 0, above = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        int32_t x = v[i];
+        lo = x < lo ? (int16_t)x : lo;
+        hi = x > hi ? (int16_t)x : hi;
+        sum += x;
+        sumsq += (uint64_t)(x * x); // At most 2^30
+        above += x > threshold;
+    }
+    s->min = lo;
+    s->max = hi;
+    s->sum += sum;
+    s->sumsq += sumsq;
+    s->above += above;
+}
+
+/**
+ * @brief Merges vector lane extremes and squares into a summary.
+ */
+static void vecstat_fold(struct vecstat *s, const int16_t *lo, const int16_t *hi, int lanes,
+                         const uint64_t *sq, int sq_lanes) {
+    for (int k = 0; k < lanes; k++) {
+        s->min = lo[k] < s->min ? lo[k] : s->min;
+        s->max = hi[k] > s->max ? hi[k] : s->max;
+    }
+    for (int k = 0; k < sq_lanes; k++)
+        s->sumsq += sq[k];
+}
+
+#ifdef VECSTAT_HAVE_X86
+/**
+ * @brief SSE2 kernel: 8 values per step.
+ *
+ * pmaddwd against ones sums pairs into 32-bit lanes; against the value itself
+ * it yields pairs of squares, at most 2^31, zero-extended into 64-bit lanes.
+ */
+__attribute__((target("sse2")))
+static void vecstat_sse2(struct vecstat *s, const int16_t *v, size_t n, int16_t threshold) {
+    const __m128i zero = _mm_setzero_si128(), ones = _mm_set1_epi16(1), thr = _mm_set1_epi16(threshold);
+    __m128i vmin = _mm_set1_epi16(INT16_MAX), vmax = _mm_set1_epi16(INT16_MIN), sq = zero;
+    size_t i = 0, vectors = n / 8;
+    int16_t lo[8], hi[8], count[8];
+    int32_t sum[4];
+    uint64_t sq_lane[2];
+
+    while (vectors > 0) {
+        size_t block = vectors < VECSTAT_BLOCK ? vectors : VECSTAT_BLOCK;
+        __m128i vsum = zero, vabove = zero;
+
+        vectors -= block;
+        for (; block > 0; block--, i += 8) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(v + i));
+            __m128i x2 = _mm_madd_epi16(x, x);
+            vmin = _mm_min_epi16(vmin, x);
+            vmax = _mm_max_epi16(vmax, x);
+            vsum = _mm_add_epi32(vsum, _mm_madd_epi16(x, ones));
+            sq = _mm_add_epi64(sq, _mm_unpacklo_epi32(x2, zero));
+            sq = _mm_add_epi64(sq, _mm_unpackhi_epi32(x2, zero));
+            vabove = _mm_sub_epi16(vabove, _mm_cmpgt_epi16(x, thr)); // True is -1
+        }
+        _mm_storeu_si128((__m128i *)sum, vsum);
+        _mm_storeu_si128((__m128i *)count, vabove);
+        for (int k = 0; k < 4; k++)
+            s->sum += sum[k];
+        for (int k = 0; k < 8; k++)
+            s->above += (uint16_t)count[k];
+    }
+    _mm_storeu_si128((__m128i *)lo, vmin);
+    _mm_storeu_si128((__m128i *)hi, vmax);
+    _mm_storeu_si128((__m128i *)sq_lane, sq);
+    vecstat_fold(s, lo, hi, 8, sq_lane, 2);
+    vecstat_scalar(s, v + i, n - i, threshold);
+}
+
+/**
+ * @brief AVX2 kernel: the SSE2 kernel on 16 values per step.
+ */
+__attribute__((target("avx2")))
+static void vecstat_avx2(struct vecstat *s, const int16_t *v, size_t n, int16_t threshold) {
+    const __m256i zero = _mm256_setzero_si256(), ones = _mm256_set1_epi16(1), thr = _mm256_set1_epi16(threshold);
+    __m256i vmin = _mm256_set1_epi16(INT16_MAX), vmax = _mm256_set1_epi16(INT16_MIN), sq = zero;
+    size_t i = 0, vectors = n / 16;
+    int16_t lo[16], hi[16], count[16];
+    int32_t sum[8];
+    uint64_t sq_lane[4];
+
+    while (vectors > 0) {
+        size_t block = vectors < VECSTAT_BLOCK ? vectors : VECSTAT_BLOCK;
+        __m256i vsum = zero, vabove = zero;
+
+        vectors -= block;
+        for (; block > 0; block--, i += 16) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(v + i));
+            __m256i x2 = _mm256_madd_epi16(x, x);
+            vmin = _mm256_min_epi16(vmin, x);
+            vmax = _mm256_max_epi16(vmax, x);
+            vsum = _mm256_add_epi32(vsum, _mm256_madd_epi16(x, ones));
+            sq = _mm256_add_epi64(sq, _mm256_unpacklo_epi32(x2, zero));
+            sq = _mm256_add_epi64(sq, _mm256_unpackhi_epi32(x2, zero));
+            vabove = _mm256_sub_epi16(vabove, _mm256_cmpgt_epi16(x, thr));
+        }
+        _mm256_storeu_si256((__m256i *)sum, vsum);
+        _mm256_storeu_si256((__m256i *)count, vabove);
+        for (int k = 0; k < 8; k++)
+            s->sum += sum[k];
+        for (int k = 0; k < 16; k++)
+            s->above += (uint16_t)count[k];
+    }
+    _mm256_storeu_si256((__m256i *)lo, vmin);
+    _mm256_storeu_si256((__m256i *)hi, vmax);
+    _mm256_storeu_si256((__m256i *)sq_lane, sq);
+    vecstat_fold(s, lo, hi, 16, sq_lane, 4);
+    vecstat_scalar(s, v + i, n - i, threshold);
+}
+#endif
+
+#ifdef VECSTAT_HAVE_NEON
+/**
+ * @brief NEON kernel: 8 values per step.
+ *
+ * Pairs are summed with a pairwise add-accumulate into 32-bit lanes; squares
+ * are widened to 32 bits (at most 2^30) and accumulated into 64-bit lanes.
+ */
+static void vecstat_neon(struct vecstat *s, const int16_t *v, size_t n, int16_t threshold) {
+    const int16x8_t thr = vdupq_n_s16(threshold);
+    int16x8_t vmin = vdupq_n_s16(INT16_MAX), vmax = vdupq_n_s16(INT16_MIN);
+    uint64x2_t sq = vdupq_n_u64(0);
+    size_t i = 0, vectors = n / 8;
+    int16_t lo[8], hi[8];
+    uint16_t count[8];
+    int32_t sum[4];
+    uint64_t sq_lane[2];
+
+    while (vectors > 0) {
+        size_t block = vectors < VECSTAT_BLOCK ? vectors : VECSTAT_BLOCK;
+        int32x4_t vsum = vdupq_n_s32(0);
+        uint16x8_t vabove = vdupq_n_u16(0);
+
+        vectors -= block;
+        for (; block > 0; block--, i += 8) {
+            int16x8_t x = vld1q_s16(v + i);
+            int32x4_t x2_lo = vmull_s16(vget_low_s16(x), vget_low_s16(x));
+            int32x4_t x2_hi = vmull_s16(vget_high_s16(x), vget_high_s16(x));
+            vmin = vminq_s16(vmin, x);
+            vmax = vmaxq_s16(vmax, x);
+            vsum = vpadalq_s16(vsum, x);
+            sq = vpadalq_u32(sq, vreinterpretq_u32_s32(x2_lo));
+            sq = vpadalq_u32(sq, vreinterpretq_u32_s32(x2_hi));
+            vabove = vsubq_u16(vabove, vcgtq_s16(x, thr)); // True is all ones
+        }
+        vst1q_s32(sum, vsum);
+        vst1q_u16(count, vabove);
+        for (int k = 0; k < 4; k++)
+            s->sum += sum[k];
+        for (int k = 0; k < 8; k++)
+            s->above += count[k];
+    }
+    vst1q_s16(lo, vmin);
+    vst1q_s16(hi, vmax);
+    vst1q_u64(sq_lane, sq);
+    vecstat_fold(s, lo, hi, 8, sq_lane, 2);
+    vecstat_scalar(s, v + i, n - i, threshold);
+}
+#endif
+
+/**
+ * @brief Returns the kernel of an implementation, or NULL if this CPU lacks it.
+ */
+vecstat_fn vecstat_kernel(enum vecstat_impl impl) {
+    switch (impl) {
+    case VECSTAT_SCALAR:
+        return vecstat_scalar;
+#ifdef VECSTAT_HAVE_X86
+    case VECSTAT_SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2") ? vecstat_sse2 : NULL;
+    case VECSTAT_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? vecstat_avx2 : NULL;
+#endif
+#ifdef VECSTAT_HAVE_NEON
+    case VECSTAT_NEON:
+#if defined(__aarch64__)
+        return vecstat_neon; // Mandatory on AArch64
+#else
+        return (getauxval(AT_HWCAP) & HWCAP_NEON) ? vecstat_neon : NULL;
+#endif
+#endif
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * @brief Returns the implementation used by vecstat_i16(): the widest one available.
+ */
+enum vecstat_impl vecstat_selected(void) {
+    int impl = atomic_load_explicit(&selected, memory_order_relaxed);
+
+    if (impl < 0) { // Racing first calls detect the same answer
+        impl = VECSTAT_IMPLS - 1;
+        while (impl > VECSTAT_SCALAR && vecstat_kernel((enum vecstat_impl)impl) == NULL)
+            impl--;
+        atomic_store_explicit(&selected, impl, memory_order_relaxed);
+    }
+    return (enum vecstat_impl)impl;
+}
+
+/**
+ * @brief Merges n values into a summary with the selected kernel.
+ *
+ * @param s Summary to extend (see vecstat_reset()).
+ * @param v Values, any alignment.
+ * @param n Number of values.
+ * @param threshold Values strictly above it are counted in s->above.
+ */
+void vecstat_i16(struct vecstat *s, const int16_t *v, size_t n, int16_t threshold) {
+    vecstat_fn fn = atomic_load_explicit(&selected_fn, memory_order_relaxed);
+
+    if (fn == NULL) {
+        fn = vecstat_kernel(vecstat_selected());
+        atomic_store_explicit(&selected_fn, fn, memory_order_relaxed);
+    }
+    fn(s, v, n, threshold);
+}
+
+/**
+ * @brief Returns the name of an implementation.
+ */
+const char *vecstat_name(enum vecstat_impl impl) {
+    static const char *const names[VECSTAT_IMPLS] = { "scalar", "sse2", "avx2", "neon" };
+    return (unsigned)impl < VECSTAT_IMPLS ? names[impl] : "?";
+}
@@ -0,0 +1,56 @@
+/**
+ * @file vecstat.h
+ * @brief Vectorized summary statistics over arrays of 16-bit values.
+ *
+ * One fused pass yields the minimum, maximum, sum, sum of squares and the
+ * number of values above a threshold. Kernels exist for SSE2 and AVX2 (x86)
+ * and NEON (ARM), next to a portable scalar loop; the best one the CPU
+ * supports is picked at the first call. Every kernel returns exactly the
+ * scalar result: sums are widened before they can overflow.
+ *
+ * Values are hundredths of a unit (°C or %RH), as decoded from the history
+ * codes (sample_codec.h).
+ */
+
+#ifndef VECSTAT_H
+#define VECSTAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Implementations, in order of preference within an architecture
+enum vecstat_impl {
+    VECSTAT_SCALAR, // Portable loop, always available
+    VECSTAT_SSE2,   // 8 lanes, x86
+    VECSTAT_AVX2,   // 16 lanes, x86
+    VECSTAT_NEON,   // 8 lanes, ARM
+    VECSTAT_IMPLS,
+};
+
+// Running summary; kernels merge into it
+struct vecstat {
+    int16_t min;    // Lowest value (INT16_MAX while empty)
+    int16_t max;    // Highest value (INT16_MIN while empty)
+    int64_t sum;    // Sum of the values
+    uint64_t sumsq; // Sum of the squared values
+    uint64_t above; // Values strictly greater than the threshold
+};
+
+typedef void (*vecstat_fn)(struct vecstat *s, const int16_t *v, size_t n, int16_t threshold);
+
+// Empties a summary
+void vecstat_reset(struct vecstat *s);
+
+// Merges n values into a summary with the selected kernel
+void vecstat_i16(struct vecstat *s, const int16_t *v, size_t n, int16_t threshold);
+
+// Returns the kernel of an implementation, or NULL if this CPU lacks it
+vecstat_fn vecstat_kernel(enum vecstat_impl impl);
+
+// Returns the implementation used by vecstat_i16()
+enum vecstat_impl vecstat_selected(void);
+
+// Returns the name of an implementation ("scalar", "sse2", "avx2", "neon")
+const char *vecstat_name(enum vecstat_impl impl);
+
+#endif
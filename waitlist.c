@@ -0,0 +1,108 @@
+/**
+ * @file waitlist.c
+ * @brief Suspended HTTP connections waiting for the next sample.
+ *
+ * A waiter is pushed only after its connection is suspended, and it is resumed
+ * only after being popped, so each connection is on the stack at most once and
+ * cannot be freed by MHD while it is linked. The notifier reads `next` before
+ * resuming a waiter: once resumed, the connection may finish and free it.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "waitlist.h"
+#include "sensor_reader.h"
+
+static _Atomic(struct waiter *) waiters = NULL; // Stack of suspended connections
+static int notify_fd = -1;                      // Signalled when a sample is published
+
+/**
+ * @brief Resumes every waiter on each notification or tick.
+ */
+static void *waitlist_loop(void *arg) {
+    struct pollfd pfd = { .fd = notify_fd, .events = POLLIN };
+    uint64_t count;
+
+    (void)arg;
+    for (;;) {
+        int n = poll(&pfd, 1, WAITLIST_TICK_MS);
+        if (n < 0 && errno != EINTR)
+            break;
+        if (n > 0 && read(notify_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+            break;
+
+        // Detach the whole stack at once; waiters pushed meanwhile wait for the next pass
+        struct waiter *w = atomic_exchange_explicit(&waiters, NULL, memory_order_acquire);
+        while (w != NULL) {
+            struct waiter *next = w->next; // `w` may be freed once its connection resumes
+            MHD_resume_connection(w->conn);
+            w = next;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Starts the notifier thread.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int waitlist_start(void) {
+    pthread_t thread;
+
+    notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (notify_fd < 0)
+        return -1;
+    if (pthread_create(&thread, NULL, waitlist_loop, NULL) != 0) {
+        close(notify_fd);
+        notify_fd = -1;
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+/**
+ * @brief Wakes the notifier thread.
+ *
+ * Registered as a sample listener: a single non-blocking eventfd write, so the
+ * sensor thread never waits on HTTP clients.
+ *
+ * @param arg Unused.
+ */
+void waitlist_notify(void *arg) {
+    uint64_t one = 1;
+
+    (void)arg;
+    if (write(notify_fd, &one, sizeof(one)) < 0) {
+        // EAGAIN: the counter is saturated, a wakeup is already pending
+    }
+}
+
+/**
+ * @brief Suspends a connection until the next sample or tick.
+ *
+ * Must be called from the MHD callback currently handling `w->conn`. If sample
+ * `want_seq` was published between the caller's check and the push, the
+ * notifier is kicked so the wakeup is not lost.
+ *
+ * @param w Waiter with `conn` set; must stay valid until the connection resumes.
+ * @param want_seq First sample the caller has not sent yet.
+ */
+void waitlist_suspend(struct waiter *w, uint64_t want_seq) {
+    MHD_suspend_connection(w->conn);
+
+    w->next = atomic_load_explicit(&waiters, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&waiters, &w->next, w,
+                                                  memory_order_release, memory_order_relaxed))
+        ;
+
+    atomic_thread_fence(memory_order_seq_cst); // Order the push before the re-check
+    if (get_sample_seq() >= want_seq) // Published before the push: the notifier may have missed us
+        waitlist_notify(NULL);
+}
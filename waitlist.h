@@ -0,0 +1,35 @@
+/**
+ * @file waitlist.h
+ * @brief Suspended HTTP connections waiting for the next sample.
+ *
+ * Streaming and long-poll responses that have nothing to send suspend their
+ * connection and park a `struct waiter` here instead of being polled. The list is
+ * a lock-free stack: the sensor thread's listener only bumps an eventfd, and a
+ * notifier thread detaches the whole stack in one exchange and resumes every
+ * connection on it. A periodic tick resumes all waiters too, so streams can send
+ * keepalives and long polls can time out.
+ */
+
+#ifndef WAITLIST_H
+#define WAITLIST_H
+
+#include <stdint.h>
+#include <microhttpd.h>
+
+#define WAITLIST_TICK_MS 15000 // Resume every waiter at least this often
+
+struct waiter {
+    struct MHD_Connection *conn; // Suspended connection
+    struct waiter *next;         // Next waiter on the stack
+};
+
+// Starts the notifier thread; returns 0 on success, -1 on error
+int waitlist_start(void);
+
+// Sample listener (see add_sample_listener()): resumes all waiters, never blocks
+void waitlist_notify(void *arg);
+
+// Suspends the connection until sample `want_seq` is published or the next tick
+void waitlist_suspend(struct waiter *w, uint64_t want_seq);
+
+#endif
@@ -0,0 +1,793 @@
+/**
+ * @file websocket.c
+ * @brief WebSocket push of binary sample frames (/ws).
+ *
+ * MHD hands over each upgraded socket in its own thread; the client is pushed
+ * on a lock-free stack and adopted by the WebSocket thread, which from then on
+ * is the only one touching it. Queued frames are copied to the output buffer in
+ * one batch, so a backlog costs one send() rather than one per frame; frames
+ * still in the queue are the ones dropped when it overflows.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include "websocket.h"
+#include "sensor_reader.h"
+#include "sample_codec.h"
+#include "time_util.h"
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11" // Appended to the key (RFC 6455)
+#define WS_KEY_LEN 24            // base64 of the 16-byte client nonce
+#define WS_ACCEPT_LEN 28         // base64 of a SHA-1 digest
+#define WS_CONTROL_MAX (2 + 125) // Largest control frame sent (pong, close)
+#define WS_OUT_MAX (WS_QUEUE_FRAMES * WS_SAMPLE_FRAME) // Output batch, also fits a control frame
+#define WS_EVENTS 64             // epoll events handled per wakeup
+
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+#define WS_FIN 0x80
+
+#define WS_CLOSE_PROTOCOL 1002 // Close status: protocol error
+#define WS_CLOSE_TOO_BIG 1009  // Close status: message too big
+
+struct ws_client {
+    int fd;                                  // Upgraded socket (non-blocking)
+    struct MHD_UpgradeResponseHandle *urh;   // MHD handle closing it, NULL in the benchmark
+    struct ws_client *next;                  // Next pending or connected client
+    uint8_t in[WS_IN_MAX];                   // Received bytes not parsed yet
+    size_t in_len;
+    uint8_t queue[WS_QUEUE_FRAMES][WS_SAMPLE_FRAME]; // Sample frames not sent yet, oldest at head
+    unsigned head, count;
+    uint8_t ctrl[WS_CONTROL_MAX];            // Control frame to send before the next batch
+    size_t ctrl_len;
+    uint8_t out[WS_OUT_MAX];                 // Batch being sent
+    size_t out_len, out_off;
+    int closing;                             // Close frame queued: drop the client once it is sent
+    int want_out;                            // Registered for EPOLLOUT
+};
+
+static _Atomic(struct ws_client *) pending = NULL; // Upgraded, not adopted yet
+static struct ws_client *clients = NULL;           // Adopted (WebSocket thread only)
+static int wake_fd = -1;                           // Signalled on new samples and clients
+static int epfd = -1;
+static uint64_t next_seq;                          // First sample not pushed yet
+
+static atomic_ulong client_count = 0;
+static atomic_ulong dropped_frames = 0;
+
+/* SHA-1 (FIPS 180-4), only used for the handshake */
+
+static uint32_t rol32(uint32_t v, int n) {
+    return v << n | v >> (32 - n);
+}
+
+static void sha1_block(uint32_t h[5], const uint8_t *p) {
+    uint32_t w[80], a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    for (int i = 16; i < 80; i++)
+        w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k, t;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        t = rol32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rol32(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+static void sha1(const uint8_t *data, size_t len, uint8_t digest[20]) {
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    uint8_t last[128] = { 0 };
+    size_t tail = len % 64, blocks = len - tail;
+    size_t padded = tail < 56 ? 64 : 128;
+
+    for (size_t i = 0; i < blocks; i += 64)
+        sha1_block(h, data + i);
+    memcpy(last, data + blocks, tail);
+    last[tail] = 0x80;
+    for (int i = 0; i < 8; i++) // Length in bits, big-endian
+        last[padded - 1 - i] = (uint8_t)((uint64_t)len * 8 >> (8 * i));
+    for (size_t i = 0; i < padded; i += 64)
+        sha1_block(h, last + i);
+    for (int i = 0; i < 20; i++)
+        digest[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+/**
+ * @brief Base64-encodes bytes (with padding) into a NUL-terminated string.
+ */
+static void base64(const uint8_t *in, size_t len, char *out) {
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < len ? (uint32_t)in[i + 1] << 8 : 0) |
+                     (i + 2 < len ? in[i + 2] : 0);
+        *out++ = digits[v >> 18];
+        *out++ = digits[(v >> 12) & 63];
+        *out++ = i + 1 < len ? digits[(v >> 6) & 63] : '=';
+        *out++ = i + 2 < len ? digits[v & 63] : '=';
+    }
+    *out = '\0';
+}
+
+/**
+ * @brief Returns non-zero if a comma-separated header value lists a token.
+ */
+static int header_has_token(const char *value, const char *token) {
+    size_t n = strlen(token);
+
+    while (value != NULL && *value != '\0') {
+        while (*value == ' ' || *value == '\t' || *value == ',')
+            value++;
+        if (strncasecmp(value, token, n) == 0 &&
+            (value[n] == '\0' || value[n] == ',' || value[n] == ' ' || value[n] == '\t'))
+            return 1;
+        while (*value != '\0' && *value != ',')
+            value++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks the handshake headers of a WebSocket upgrade request.
+ *
+ * @param connection The MHD connection object.
+ * @return Non-zero for a version 13 upgrade with a well-formed key.
+ */
+int ws_is_handshake(struct MHD_Connection *connection) {
+    const char *upgrade = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Upgrade");
+    const char *conn = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Connection");
+    const char *version = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Sec-WebSocket-Version");
+    const char *key = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Sec-WebSocket-Key");
+
+    return header_has_token(upgrade, "websocket") && header_has_token(conn, "upgrade") &&
+           version != NULL && strcmp(version, "13") == 0 && key != NULL && strlen(key) == WS_KEY_LEN;
+}
+
+/**
+ * @brief Adds a client to the pending stack and wakes the WebSocket thread.
+ */
+static void ws_adopt(struct ws_client *c) {
+    c->next = atomic_load_explicit(&pending, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&pending, &c->next, c,
+                                                  memory_order_release, memory_order_relaxed))
+        ;
+    ws_notify(NULL);
+}
+
+/**
+ * @brief MHD upgrade handler: hands the socket over to the WebSocket thread.
+ */
+static void ws_upgraded(void *cls, struct MHD_Connection *connection, void *con_cls,
+                        const char *extra_in, size_t extra_in_size, MHD_socket sock,
+                        struct MHD_UpgradeResponseHandle *urh) {
+    struct ws_client *c = calloc(1, sizeof(*c));
+
+    (void)cls;
+    (void)connection;
+    (void)con_cls;
+    if (c == NULL || fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK) < 0) {
+        free(c);
+        MHD_upgrade_action(urh, MHD_UPGRADE_ACTION_CLOSE);
+        return;
+    }
+    c->fd = sock;
+    c->urh = urh;
+    c->in_len = extra_in_size < sizeof(c->in) ? extra_in_size : sizeof(c->in); // Frames sent with the request
+    if (c->in_len > 0)
+        memcpy(c->in, extra_in, c->in_len);
+    atomic_fetch_add_explicit(&client_count, 1, memory_order_relaxed);
+    ws_adopt(c);
+}
+
+/**
+ * @brief Creates the 101 response of a WebSocket handshake.
+ *
+ * @param connection Connection of a request accepted by ws_is_handshake().
+ * @return The response, or NULL on allocation failure.
+ */
+struct MHD_Response *ws_create_response(struct MHD_Connection *connection) {
+    const char *key = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Sec-WebSocket-Key");
+    uint8_t buf[WS_KEY_LEN + sizeof(WS_GUID) - 1], digest[20];
+    char accept[WS_ACCEPT_LEN + 1];
+    struct MHD_Response *response;
+
+    memcpy(buf, key, WS_KEY_LEN);
+    memcpy(buf + WS_KEY_LEN, WS_GUID, sizeof(WS_GUID) - 1);
+    sha1(buf, sizeof(buf), digest);
+    base64(digest, sizeof(digest), accept);
+
+    response = MHD_create_response_for_upgrade(&ws_upgraded, NULL);
+    if (response == NULL)
+        return NULL;
+    MHD_add_response_header(response, "Upgrade", "websocket");
+    MHD_add_response_header(response, "Sec-WebSocket-Accept", accept);
+    return response;
+}
+
+static uint8_t *put_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_le64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t)(v >> (8 * i));
+    return p + 8;
+}
+
+/**
+ * @brief Encodes a sample as a binary frame of WS_SAMPLE_FRAME bytes.
+ */
+static void ws_encode(uint8_t *frame, const struct sensor_sample *s) {
+    uint8_t *p = frame;
+
+    *p++ = WS_FIN | WS_OP_BINARY;
+    *p++ = WS_SAMPLE_PAYLOAD; // Unmasked, 7-bit length
+    p = put_le64(p, s->seq);
+    p = put_le64(p, (uint64_t)s->time_ms);
+    p = put_le16(p, (uint16_t)(s->temp_code & ~SAMPLE_FLAGS));
+    p = put_le16(p, s->hum_code);
+    put_le16(p, (uint16_t)(s->temp_code & SAMPLE_FLAGS));
+}
+
+/**
+ * @brief Appends a frame to a client's queue, dropping the oldest if it is full.
+ */
+static void ws_enqueue(struct ws_client *c, const uint8_t *frame) {
+    if (c->closing)
+        return;
+    if (c->count == WS_QUEUE_FRAMES) {
+        c->head = (c->head + 1) % WS_QUEUE_FRAMES;
+        c->count--;
+        atomic_fetch_add_explicit(&dropped_frames, 1, memory_order_relaxed);
+    }
+    memcpy(c->queue[(c->head + c->count) % WS_QUEUE_FRAMES], frame, WS_SAMPLE_FRAME);
+    c->count++;
+}
+
+/**
+ * @brief Queues a control frame (replacing one not sent yet).
+ */
+static void ws_control(struct ws_client *c, int opcode, const uint8_t *payload, size_t len) {
+    c->ctrl[0] = (uint8_t)(WS_FIN | opcode);
+    c->ctrl[1] = (uint8_t)len;
+    memcpy(c->ctrl + 2, payload, len);
+    c->ctrl_len = 2 + len;
+}
+
+/**
+ * @brief Queues a close frame; the client is dropped once it is sent.
+ */
+static void ws_close_with(struct ws_client *c, unsigned status) {
+    uint8_t code[2] = { (uint8_t)(status >> 8), (uint8_t)status };
+
+    ws_control(c, WS_OP_CLOSE, code, sizeof(code));
+    c->closing = 1;
+}
+
+/**
+ * @brief Registers or unregisters a client for EPOLLOUT.
+ */
+static void ws_want_out(struct ws_client *c, int want) {
+    struct epoll_event ev = { .events = EPOLLIN | (want ? EPOLLOUT : 0), .data.ptr = c };
+
+    if (c->want_out != want && epfd >= 0)
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->want_out = want;
+}
+
+/**
+ * @brief Sends as much queued output as the socket takes without blocking.
+ *
+ * @return 0 to keep the client, -1 to drop it (error, or close frame sent).
+ */
+static int ws_flush(struct ws_client *c) {
+    for (;;) {
+        if (c->out_off == c->out_len) { // Batch sent: start the next one
+            c->out_off = c->out_len = 0;
+            if (c->ctrl_len > 0) {
+                memcpy(c->out, c->ctrl, c->ctrl_len);
+                c->out_len = c->ctrl_len;
+                c->ctrl_len = 0;
+            } else if (c->closing) {
+                return -1; // Close frame sent
+            } else {
+                for (; c->count > 0; c->count--) {
+                    memcpy(c->out + c->out_len, c->queue[c->head], WS_SAMPLE_FRAME);
+                    c->out_len += WS_SAMPLE_FRAME;
+                    c->head = (c->head + 1) % WS_QUEUE_FRAMES;
+                }
+                if (c->out_len == 0)
+                    break;
+            }
+        }
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return -1;
+            ws_want_out(c, 1); // Socket full: resume when it drains
+            return 0;
+        }
+        c->out_off += (size_t)n;
+    }
+    ws_want_out(c, 0);
+    return 0;
+}
+
+/**
+ * @brief Reads and handles client frames (ping, close; data is ignored).
+ *
+ * @return 0 to keep the client, -1 to drop it (connection closed or error).
+ */
+static int ws_receive(struct ws_client *c) {
+    for (;;) {
+        ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+        if (n == 0)
+            return -1;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return -1;
+            break;
+        }
+        c->in_len += (size_t)n;
+        if (c->in_len == sizeof(c->in))
+            break; // Parse before reading more
+    }
+
+    while (c->in_len >= 2 && !c->closing) {
+        uint8_t *p = c->in;
+        size_t hdr = 2 + 4, len = p[1] & 0x7F;
+
+        if (len == 126) {
+            hdr += 2;
+            len = c->in_len >= 4 ? (size_t)p[2] << 8 | p[3] : 0;
+        } else if (len == 127) {
+            len = sizeof(c->in); // Too big in any case
+        }
+        if (!(p[1] & 0x80)) { // Client frames must be masked
+            ws_close_with(c, WS_CLOSE_PROTOCOL);
+            break;
+        }
+        if (hdr + len > sizeof(c->in)) {
+            ws_close_with(c, WS_CLOSE_TOO_BIG);
+            break;
+        }
+        if (c->in_len < hdr + len)
+            break; // Incomplete frame
+
+        uint8_t *payload = p + hdr;
+        for (size_t i = 0; i < len; i++)
+            payload[i] ^= p[hdr - 4 + i % 4];
+        switch (p[0] & 0x0F) {
+        case WS_OP_PING:
+            if (len <= WS_CONTROL_MAX - 2)
+                ws_control(c, WS_OP_PONG, payload, len);
+            break;
+        case WS_OP_CLOSE: // Echo the status code, then close
+            ws_control(c, WS_OP_CLOSE, payload, len >= 2 ? 2 : 0);
+            c->closing = 1;
+            break;
+        default: // Data and pongs carry nothing for us
+            break;
+        }
+        c->in_len -= hdr + len;
+        memmove(c->in, c->in + hdr + len, c->in_len);
+    }
+    return ws_flush(c);
+}
+
+/**
+ * @brief Closes a client's connection and frees it.
+ */
+static void ws_free(struct ws_client *c) {
+    if (epfd >= 0)
+        epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    if (c->urh != NULL)
+        MHD_upgrade_action(c->urh, MHD_UPGRADE_ACTION_CLOSE); // MHD closes the socket
+    else
+        close(c->fd);
+    atomic_fetch_sub_explicit(&client_count, 1, memory_order_relaxed);
+    free(c);
+}
+
+/**
+ * @brief Unlinks a client from the connected list and frees it.
+ */
+static void ws_drop(struct ws_client *c) {
+    struct ws_client **pp = &clients;
+
+    while (*pp != c)
+        pp = &(*pp)->next;
+    *pp = c->next;
+    ws_free(c);
+}
+
+/**
+ * @brief Queues a frame to every client, then sends what each socket takes.
+ */
+static void ws_broadcast(const uint8_t *frames, size_t n) {
+    struct ws_client **pp = &clients;
+
+    for (struct ws_client *c = clients; c != NULL; c = c->next)
+        for (size_t i = 0; i < n; i++)
+            ws_enqueue(c, frames + i * WS_SAMPLE_FRAME);
+    while (*pp != NULL) {
+        struct ws_client *c = *pp;
+        if (ws_flush(c) < 0) {
+            *pp = c->next;
+            ws_free(c);
+        } else {
+            pp = &c->next;
+        }
+    }
+}
+
+/**
+ * @brief Encodes the samples published since the last pass and pushes them.
+ *
+ * Only the last WS_QUEUE_FRAMES can matter to any client, so a longer gap
+ * (e.g. a history recovered at startup) is skipped.
+ */
+static void ws_publish(void) {
+    static uint8_t frames[WS_QUEUE_FRAMES * WS_SAMPLE_FRAME];
+    uint64_t latest = get_sample_seq();
+    struct sensor_sample s;
+    size_t n = 0;
+
+    if (latest >= next_seq + WS_QUEUE_FRAMES)
+        next_seq = latest - WS_QUEUE_FRAMES + 1;
+    for (; next_seq <= latest; next_seq++)
+        if (get_sample(next_seq, &s) == 0)
+            ws_encode(frames + WS_SAMPLE_FRAME * n++, &s);
+    if (n > 0)
+        ws_broadcast(frames, n);
+}
+
+/**
+ * @brief WebSocket thread: adopts new clients, pushes samples, serves sockets.
+ */
+static void *ws_loop(void *arg) {
+    struct epoll_event events[WS_EVENTS];
+    uint64_t count;
+
+    (void)arg;
+    next_seq = get_sample_seq() + 1;
+    for (;;) {
+        int n = epoll_wait(epfd, events, WS_EVENTS, -1), woken = 0;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("WebSocket epoll error");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            struct ws_client *c = events[i].data.ptr;
+            if (c == NULL) {
+                if (read(wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                    perror("WebSocket eventfd error");
+                woken = 1;
+            } else if ((events[i].events & (EPOLLERR | EPOLLHUP)) ||
+                       ((events[i].events & EPOLLIN) && ws_receive(c) < 0) ||
+                       ((events[i].events & EPOLLOUT) && ws_flush(c) < 0)) {
+                ws_drop(c); // Appears once per batch: not referenced again
+            }
+        }
+        if (!woken)
+            continue;
+
+        struct ws_client *c = atomic_exchange_explicit(&pending, NULL, memory_order_acquire);
+        while (c != NULL) {
+            struct ws_client *next = c->next;
+            struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+            if (epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) {
+                ws_free(c);
+            } else {
+                c->next = clients;
+                clients = c;
+                if (c->in_len > 0 && ws_receive(c) < 0)
+                    ws_drop(c);
+            }
+            c = next;
+        }
+        ws_publish();
+    }
+    return NULL;
+}
+
+/**
+ * @brief Starts the WebSocket thread.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int ws_start(void) {
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    pthread_t thread;
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (wake_fd < 0 || epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, wake_fd, &ev) < 0 ||
+        pthread_create(&thread, NULL, ws_loop, NULL) != 0) {
+        if (wake_fd >= 0)
+            close(wake_fd);
+        if (epfd >= 0)
+            close(epfd);
+        wake_fd = epfd = -1;
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+/**
+ * @brief Wakes the WebSocket thread.
+ *
+ * Registered as a sample listener: a single non-blocking eventfd write.
+ *
+ * @param arg Unused.
+ */
+void ws_notify(void *arg) {
+    uint64_t one = 1;
+
+    (void)arg;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {
+        // EAGAIN: the counter is saturated, a wakeup is already pending
+    }
+}
+
+/**
+ * @brief Returns the number of connected WebSocket clients.
+ */
+unsigned long ws_clients(void) {
+    return atomic_load_explicit(&client_count, memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the number of frames dropped from the queues of slow clients.
+ */
+unsigned long ws_dropped(void) {
+    return atomic_load_explicit(&dropped_frames, memory_order_relaxed);
+}
+
+/* Loopback benchmark */
+
+#define WS_BENCH_LATENCY_BUCKETS 10000 // 1 us latency histogram buckets (last one: overflow)
+
+// Receiving side of the benchmark, run by its own thread
+struct ws_bench_rx {
+    int *fds;                    // Subscriber ends of the socket pairs
+    int n;                       // Subscribers read (the slow one is not)
+    const int64_t *sent_ns;      // Send time of each seq (CLOCK_MONOTONIC)
+    uint64_t last_seq;           // Stop once every subscriber got this seq, or its frame was dropped
+    uint64_t frames;             // Frames received
+    uint64_t latency_ns;         // Sum of latencies
+    int64_t max_ns;
+    uint32_t hist[WS_BENCH_LATENCY_BUCKETS];
+};
+
+static int64_t ws_bench_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * @brief Reads frames on every subscriber until each has seen the last one.
+ */
+static void *ws_bench_reader(void *arg) {
+    struct ws_bench_rx *rx = arg;
+    static uint8_t buf[64 * 1024];
+    uint8_t (*partial)[WS_SAMPLE_FRAME] = calloc((size_t)rx->n, WS_SAMPLE_FRAME);
+    size_t *partial_len = calloc((size_t)rx->n, sizeof(size_t));
+    int ep = epoll_create1(EPOLL_CLOEXEC), done = 0;
+    char *finished = calloc((size_t)rx->n, 1);
+
+    if (partial == NULL || partial_len == NULL || finished == NULL || ep < 0)
+        goto out;
+    for (int i = 0; i < rx->n; i++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)i };
+        epoll_ctl(ep, EPOLL_CTL_ADD, rx->fds[i], &ev);
+    }
+    while (done < rx->n) {
+        struct epoll_event events[WS_EVENTS];
+        int n = epoll_wait(ep, events, WS_EVENTS, 1000);
+        if (n <= 0)
+            break; // Nothing for a second: frames were lost
+        for (int e = 0; e < n; e++) {
+            int i = (int)events[e].data.u32;
+            ssize_t len = recv(rx->fds[i], buf, sizeof(buf), MSG_DONTWAIT);
+            int64_t now = ws_bench_now();
+            for (ssize_t off = 0; off < len;) {
+                size_t take = WS_SAMPLE_FRAME - partial_len[i];
+                if ((size_t)(len - off) < take)
+                    take = (size_t)(len - off);
+                memcpy(partial[i] + partial_len[i], buf + off, take);
+                partial_len[i] += take;
+                off += (ssize_t)take;
+                if (partial_len[i] < WS_SAMPLE_FRAME)
+                    break;
+                partial_len[i] = 0;
+
+                uint64_t seq = 0;
+                for (int b = 0; b < 8; b++)
+                    seq |= (uint64_t)partial[i][2 + b] << (8 * b);
+                int64_t lat = now - rx->sent_ns[seq];
+                rx->frames++;
+                rx->latency_ns += (uint64_t)lat;
+                if (lat > rx->max_ns)
+                    rx->max_ns = lat;
+                rx->hist[lat / 1000 < WS_BENCH_LATENCY_BUCKETS ? lat / 1000 : WS_BENCH_LATENCY_BUCKETS - 1]++;
+                if (seq == rx->last_seq && !finished[i]) {
+                    finished[i] = 1;
+                    done++;
+                }
+            }
+        }
+    }
+out:
+    if (ep >= 0)
+        close(ep);
+    free(partial);
+    free(partial_len);
+    free(finished);
+    return NULL;
+}
+
+/**
+ * @brief Runs one benchmark pass: `messages` frames to every subscriber.
+ *
+ * @param subscribers Subscribers that read everything.
+ * @param messages Frames pushed.
+ * @param gap_ns Pause between frames (0: as fast as possible).
+ * @return 0 on success, -1 on error.
+ */
+static int ws_bench_run(int subscribers, int messages, long gap_ns) {
+    struct ws_bench_rx *rx = calloc(1, sizeof(*rx));
+    int64_t *sent_ns = calloc((size_t)messages + 1, sizeof(int64_t));
+    int *fds = calloc((size_t)subscribers + 1, sizeof(int));
+    unsigned long dropped = ws_dropped();
+    uint8_t frame[WS_SAMPLE_FRAME];
+    struct sensor_sample s = { 0 };
+    pthread_t reader;
+    int64_t begin, end;
+    int ret = -1, i;
+
+    if (rx == NULL || sent_ns == NULL || fds == NULL)
+        goto out;
+    for (i = 0; i <= subscribers; i++) { // The last one never reads: it stands for a stalled client
+        int pair[2];
+        struct ws_client *c = calloc(1, sizeof(*c));
+        if (c == NULL || socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) {
+            free(c);
+            goto out;
+        }
+        fcntl(pair[0], F_SETFL, O_NONBLOCK);
+        c->fd = pair[0];
+        c->next = clients;
+        clients = c;
+        fds[i] = pair[1];
+        atomic_fetch_add_explicit(&client_count, 1, memory_order_relaxed);
+    }
+
+    rx->fds = fds;
+    rx->n = subscribers;
+    rx->sent_ns = sent_ns;
+    rx->last_seq = (uint64_t)messages;
+    if (pthread_create(&reader, NULL, ws_bench_reader, rx) != 0)
+        goto out;
+
+    s.temp_code = 0x6650 | SAMPLE_VALID;
+    s.hum_code = 0x7C80;
+    begin = ws_bench_now();
+    for (int m = 1; m <= messages; m++) {
+        struct timespec gap = { 0, gap_ns };
+        s.seq = (uint64_t)m;
+        s.time_ms = m;
+        ws_encode(frame, &s);
+        sent_ns[m] = ws_bench_now();
+        ws_broadcast(frame, 1);
+        if (gap_ns > 0)
+            nanosleep(&gap, NULL);
+    }
+    while (1) { // Drain what the readers have room for
+        int busy = 0;
+        for (struct ws_client *c = clients->next; c != NULL; c = c->next) // All but the stalled one (added last)
+            busy |= c->out_off < c->out_len || c->count > 0;
+        if (!busy)
+            break;
+        ws_broadcast(frame, 0);
+    }
+    pthread_join(reader, NULL);
+    end = ws_bench_now();
+
+    uint64_t p99 = 0, seen = 0;
+    for (int b = 0; b < WS_BENCH_LATENCY_BUCKETS; b++) {
+        seen += rx->hist[b];
+        if (seen * 100 >= rx->frames * 99) {
+            p99 = (uint64_t)b;
+            break;
+        }
+    }
+    uint64_t lost = (uint64_t)subscribers * (uint64_t)messages - rx->frames; // Dropped for reading subscribers
+    printf("%-6s %6d %8d %14.0f %10.1f %10llu %10.1f %10llu %10llu\n", gap_ns > 0 ? "paced" : "burst",
+           subscribers, messages, rx->frames * 1e9 / (double)(end - begin),
+           rx->frames ? rx->latency_ns / 1000.0 / rx->frames : 0.0, (unsigned long long)p99,
+           rx->max_ns / 1000.0, (unsigned long long)lost, (unsigned long long)(ws_dropped() - dropped - lost));
+    ret = 0;
+out:
+    while (clients != NULL)
+        ws_drop(clients);
+    for (i = 0; fds != NULL && i <= subscribers; i++)
+        if (fds[i] > 0)
+            close(fds[i]);
+    free(fds);
+    free(sent_ns);
+    free(rx);
+    return ret;
+}
+
+/**
+ * @brief Pushes frames to loopback subscribers and reports throughput and latency.
+ *
+ * Each subscriber is a Unix socket pair read by one receiver thread; one more
+ * subscriber never reads, standing for a stalled client: frames dropped for it
+ * are reported apart from those dropped for the reading subscribers. Runs once as fast as possible (throughput, drops under
+ * backpressure) and once paced at 1 frame per 100 us (latency). Must not run
+ * alongside the WebSocket thread.
+ *
+ * @param subscribers Reading subscribers.
+ * @param messages Frames pushed per run.
+ * @return 0 on success, -1 on error.
+ */
+int ws_benchmark(int subscribers, int messages) {
+    printf("\n%-6s %6s %8s %14s %10s %10s %10s %10s %10s\n", "ws", "subs", "frames",
+           "delivered/s", "mean us", "p99 us", "max us", "dropped", "stalled");
+    if (ws_bench_run(subscribers, messages, 0) < 0 ||
+        ws_bench_run(subscribers, messages / 10, 100000) < 0) {
+        perror("WebSocket benchmark error");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file websocket.h
+ * @brief WebSocket push of binary sample frames (/ws).
+ *
+ * After the RFC 6455 handshake every published sample is pushed as one
+ * unmasked binary frame: a 2-byte header and WS_SAMPLE_PAYLOAD bytes,
+ * little-endian like history_bin.h.
+ *
+ *   offset  size  field
+ *        0     8  seq: sample sequence number
+ *        8     8  time: Unix time in ms
+ *       16     2  temperature code, status bits cleared (sample_codec.h)
+ *       18     2  humidity code
+ *       20     2  flags: SAMPLE_VALID, SAMPLE_RETRIED
+ *
+ * One thread owns every upgraded socket, all non-blocking. The sensor thread's
+ * listener only signals an eventfd; the WebSocket thread encodes each new
+ * sample once and appends it to the bounded queue of every client. A client
+ * that does not keep up loses its oldest queued frames (counted by
+ * ws_dropped()), so it can delay neither the sensor thread nor other clients.
+ * Pings are answered, close frames echoed, other client messages ignored.
+ */
+
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <stdint.h>
+#include <microhttpd.h>
+
+#define WS_SAMPLE_PAYLOAD 22                    // Bytes of sample data per frame
+#define WS_SAMPLE_FRAME (2 + WS_SAMPLE_PAYLOAD) // Whole frame, header included
+#define WS_QUEUE_FRAMES 64                      // Frames queued per client before the oldest are dropped
+#define WS_IN_MAX 256                           // Largest client frame accepted (control frames are <= 131)
+
+#define WS_BENCH_SUBSCRIBERS 64  // Loopback benchmark subscribers
+#define WS_BENCH_MESSAGES 20000  // Loopback benchmark samples pushed per run
+
+// Starts the WebSocket thread; returns 0 on success, -1 on error
+int ws_start(void);
+
+// Sample listener (see add_sample_listener()): wakes the WebSocket thread, never blocks
+void ws_notify(void *arg);
+
+// Returns non-zero if the request is a WebSocket version 13 handshake
+int ws_is_handshake(struct MHD_Connection *connection);
+
+// Creates the 101 Switching Protocols response of a valid handshake, NULL on failure
+struct MHD_Response *ws_create_response(struct MHD_Connection *connection);
+
+// Returns the number of connected WebSocket clients
+unsigned long ws_clients(void);
+
+// Returns the number of frames dropped from the queues of slow clients
+unsigned long ws_dropped(void);
+
+// Pushes frames to loopback subscribers and reports throughput and latency; 0 on success, -1 on error
+int ws_benchmark(int subscribers, int messages);
+
+#endif